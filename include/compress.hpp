@@ -0,0 +1,6 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+std::vector<unsigned char> compress_floats(const std::vector<float>& data);
+std::vector<float> decompress_floats(const std::vector<unsigned char>& bytes, size_t count);
\ No newline at end of file
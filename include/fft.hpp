@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+
+// Precomputed tables for complex FFTs of one length, see FFT::plan
+struct FFTPlan {
+    int n; // Length of the transform
+
+    // Stockham stages of a power of two length, radix 8 where possible, then 4 and 2
+    std::vector<int> radices;
+    std::vector<int> twiddle_offsets; // Start of the twiddles of each stage
+    std::vector<float> twiddle_re, twiddle_im; // exp(-2 pi i p j / length of the stage) for every p and 1 <= j < radix
+
+    // Bluestein's algorithm for any other length, a convolution with a chirp computed with power of two FFTs of length m
+    int m; // Padded length of the convolution, 0 for powers of two
+    std::vector<float> chirp_re, chirp_im; // exp(-pi i k^2 / n)
+    std::vector<float> kernel_re, kernel_im; // FFT of the conjugate chirp wrapped around m, for forward transforms
+    std::vector<float> inverse_kernel_re, inverse_kernel_im; // FFT of the chirp, for inverse transforms
+};
+
+// Real-to-complex 2D FFT of a width x height grid of floats, for spectral methods on periodic domains.
+// Columns are transformed in pairs packed into one complex signal, so the spectrum only keeps the height / 2 + 1 non-negative
+// frequencies along y. Every 1D transform runs on a batch of signals interleaved in memory, so the innermost loop of each
+// butterfly steps through the batch without branches and vectorizes, and the batch is split across threads.
+class FFT {
+public:
+    int width, height;
+    int threads; // Number of threads the batches are split across
+
+    // Spectrum of the last forward transform, kx * (height / 2 + 1) + ky for 0 <= kx < width and 0 <= ky <= height / 2
+    std::vector<float> spectrum_re, spectrum_im;
+
+    // Scratch space, kept between transforms
+    std::vector<float> packed_re, packed_im; // Pairs of columns packed into complex signals
+    std::vector<float> work_re, work_im; // Output of every other Stockham stage
+    std::vector<float> pad_re, pad_im; // Signals padded for Bluestein's convolution
+
+    FFT();
+
+    void resize(int width, int height);
+    int frequencies() const;
+    std::vector<float> squared_wavenumbers(float dx) const;
+    void forward(const float* data);
+    void inverse(float* data);
+
+    void transform(float* re, float* im, int n, int batch, bool inverse);
+    static const FFTPlan& plan(int n);
+};
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+#include "shader.hpp"
+#include "texture.hpp"
+
+#include <map>
+#include <vector>
+
+// Tables of a GPU FFT of one length, see GpuFFT::plan
+struct GpuFFTPlan {
+    int n; // Length of the transform
+
+    // Stockham stages, one per factor of the length: radix 4 where possible, then 2, 3, 5 and 7
+    std::vector<int> radices;
+    Texture twiddles; // n x 1 RG32F, exp(-2 pi i k / n) for every k, the twiddles of every stage are a subset
+
+    // Bluestein's algorithm for lengths with a larger prime factor, see FFTPlan
+    int m; // Padded power of two length of the convolution, 0 if the length only has small factors
+    Texture chirp; // n x 1 RG32F, exp(-pi i k^2 / n)
+    Texture kernel; // m x 1 RG32F, FFT of the wrapped conjugate chirp, for forward transforms
+    Texture inverse_kernel; // m x 1 RG32F, FFT of the wrapped chirp, for inverse transforms
+};
+
+// Complex 2D FFT of a width x height grid on the GPU, with the complex values packed into an RG32F texture.
+// Scalar R32F layers are packed in as the real (and optionally imaginary) part, transformed in place with Stockham passes
+// along x and then y, and unpacked again. Used for periodic Poisson solves and for spectra that never leave the GPU.
+class GpuFFT {
+public:
+    int width, height;
+    Texture data; // The complex grid the transforms run on
+    Texture work; // Written by every other pass, then swapped with data
+    std::map<int, GpuFFTPlan> plans; // Cached per length
+    Buffer spectrum; // Energy of every wavenumber shell, written by energy_spectrum
+
+    ComputeShader fftCS;
+
+    GpuFFT();
+    ~GpuFFT();
+
+    void resize(int width, int height);
+    void release();
+    const GpuFFTPlan& plan(int n);
+
+    void load(const Texture& real, const Texture* imaginary = nullptr);
+    void store(const Texture& real);
+    void forward();
+    void inverse();
+    void solve_poisson(float dx, bool wide);
+    std::vector<float> energy_spectrum();
+
+    void transform(int axis, bool inverse);
+    void stages(const GpuFFTPlan& plan, Texture& source, Texture& target, int axis, bool inverse);
+    void dispatch(int pass, const Texture& source, const Texture& target, int x_groups, int y_groups);
+};
\ No newline at end of file
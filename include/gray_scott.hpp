@@ -1,6 +1,10 @@
 #pragma once
 #include "shader.hpp"
 #include "grid.hpp"
+#include "multigrid.hpp"
+#include "fft.hpp"
+#include "runge_kutta.hpp"
+#include "reduction.hpp"
 
 #include <map>
 
@@ -11,18 +15,47 @@ public:
     float D;
 
     std::vector<const char*> layer_strs;
-    int visible_layer;
 
     std::map<std::string, std::pair<float, float>> presets;
     std::vector<const char*> preset_strs;
     int preset;
 
+    // Spectral integrator for periodic grids, the diffusion of every Fourier mode is integrated exactly with an integrating factor
+    FFT fft;
+
+    // Implicit-explicit integrator, the reactions are integrated explicitly and then (I - dt k laplacian) u' = u is solved
+    // for each chemical, with k = 1 for u and D for v
+    Multigrid multigrid;
+    int v_cycles; // Number of V-cycles per chemical and step
+    bool advance; // Whether the next step advances the solution, false while paused
+
+    RungeKutta runge_kutta; // Explicit multi-stage integrators (see Grid::add_runge_kutta_methods) and the RKL2 super time steps
+    Reduction reduction; // Largest concentrations and parameters, for the adaptive time step
+
     ComputeShader gray_scottCS;
 
     GrayScott(int width, int height);
 
+    void add_preset(const std::string& name, float a, float b);
+    bool select_preset(const std::string& name);
+    bool spectral() const;
+    bool imex() const;
+    bool super() const;
+    int reaction_substeps() const;
+    int super_stages() const;
+    void step_spectral();
+    void step_imex();
+    void step_super();
+    void step_reactions();
+    void evaluate_rates(const Texture& rates) override;
+    float stable_time_step() override;
+
     void solve() override;
     void gui() override;
     void reset_settings() override;
     void set_uniforms(std::string cmap_str, bool paused) override;
+    void compile_shaders() override;
+    void copy_from(const Grid& other) override;
+    void evict() override;
+    size_t bytes() const override;
 };
\ No newline at end of file
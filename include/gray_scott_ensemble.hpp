@@ -0,0 +1,56 @@
+#pragma once
+#include "shader.hpp"
+#include "grid.hpp"
+#include "texture.hpp"
+
+// Settings of a single member of the ensemble, laid out to match the std430 Member struct in gray_scott_ensemble.glsl
+struct EnsembleMember {
+    float a;
+    float b;
+    float D;
+    float dt;
+    float dx;
+};
+static_assert(sizeof(EnsembleMember) == 20, "EnsembleMember must match the std430 layout of the shader");
+
+// Many independent Gray-Scott runs advanced by a single dispatch, for parameter studies.
+// The feed rate varies along the columns and the kill rate along the rows of the ensemble.
+// Small runs can instead be advanced on the CPU, with every SIMD lane holding a different run.
+class GrayScottEnsemble : public Grid {
+public:
+    static constexpr int lanes = 8; // Runs advanced together on the CPU, one per lane of a 256-bit register
+
+    // Ranges swept by the ensemble
+    float a_min, a_max; // Feed rate of the first and last column
+    float b_min, b_max; // Kill rate of the first and last row
+    float D;
+
+    std::vector<const char*> layer_strs;
+
+    Buffer member_buffer; // SSBO holding one EnsembleMember per run
+    std::vector<EnsembleMember> uploaded; // Contents of member_buffer, so it is only updated when a setting changes
+
+    // CPU backend
+    bool advance; // Whether the next step advances the runs, false while paused
+    std::vector<float> host_u, host_v; // Layers of every run interleaved by lane: run k of block n at cell i is at (n * cells + i) * lanes + k
+    std::vector<float> next_u, next_v; // Scratch layers the CPU writes each step into
+    unsigned int host_revision; // Grid::revision the host layers were loaded at
+    bool host_dirty; // True while the host layers are ahead of the textures
+
+    ComputeShader ensembleCS;
+
+    GrayScottEnsemble(int width, int height);
+
+    void set_layout(int columns, int rows);
+    void copy_from(const Grid& other) override;
+    std::vector<EnsembleMember> build_members();
+    bool set_backend(bool cpu) override;
+    void load_host();
+    void step_cpu();
+    void sync() override;
+
+    void solve() override;
+    void gui() override;
+    void reset_settings() override;
+    void set_uniforms(std::string cmap_str, bool paused) override;
+};
\ No newline at end of file
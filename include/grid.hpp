@@ -1,8 +1,31 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <map>
+
+#include "texture.hpp"
 
 class Sandbox;
+class AbstractShader;
+class Reduction;
+
+// A parameter that varies from cell to cell instead of being a single uniform value
+struct ParameterField {
+    int axis; // 0 for a linear ramp along x, 1 for a linear ramp along y, 2 for explicit per-cell values
+    float from; // Value of a ramp at the first column or row
+    float to; // Value of a ramp at the last column or row
+    std::vector<float> data; // Explicit per-cell values in row-major order
+    int data_width, data_height; // Size of the explicit values, they are resampled to the size of the grid
+    Texture texture; // The field at the size of the grid, sampled by the shader
+};
+
+// A PDE specific choice between named alternatives, e.g. how Navier-Stokes enforces incompressibility
+struct GridOption {
+    int* value; // Index of the chosen alternative
+    std::vector<const char*> names; // Name of every alternative, shown in the GUI and matched by scenario files
+};
+
+int mip_levels(int width, int height);
 
 class Grid {
 public:
@@ -14,6 +37,12 @@ public:
     int brush_enabled; // 1 if the brush is down and 0 if it is up
     int brush_radius; // The radius of the circle created by the brush
     int x_pos, y_pos; // The coordinates of the mouse when the brush is down
+    int brush_layer; // Index of the layer (or brush mode) the brush paints into
+    int visible_layer; // Index of the layer (or derived quantity) shown in the output image
+
+    // Ensemble layout
+    int columns; // Number of independent runs side by side in the output image, 1 for a grid with a single run
+    int rows; // Number of independent runs stacked vertically in the output image, 1 for a grid with a single run
 
     // Simulation Settings
     int resolution; // The number of pixels per cell
@@ -21,18 +50,89 @@ public:
     float time_step; // The dt in the Finite Difference Approximation
     int boundary_condition; // Specifies the behavior of the solution near the boundaries (Dirichlet, Neumann, or Periodic)
     bool pixelated; // Determines whether the grid's output image looks pixelated or not
+    int resample_filter; // How layers are resampled when the grid is resized (0 = bilinear, 1 = conservative area average)
+    bool render_image; // Whether the next step also writes the color mapped output image
+    std::vector<const char*> integrator_strs; // Time integration schemes supported by the PDE, the first is the explicit shader
+    int integrator; // Index into integrator_strs
+    int first_runge_kutta; // Index of the first Runge-Kutta method in integrator_strs, -1 if the PDE has none, see add_runge_kutta_methods
+    bool cpu_backend; // True while the solver runs on the CPU, for PDEs that support it, see set_backend
+
+    // Adaptive time step, see adapt_time_step
+    bool adaptive_supported; // True if the PDE estimates the largest stable time step of its state, see stable_time_step
+    bool adaptive_time_step; // Whether time_step follows the stability limit instead of the slider
+    float safety; // Fraction of the stability limit the adaptive time step is kept at
+    float max_time_step; // Largest adaptive time step, reached when nothing in the state limits the step
+    int adapt_every; // Number of steps between two estimates, each reads a few values back from the GPU
+    int steps_until_adapt; // Steps left until the next estimate
+    const char* limited_by; // What limited the last estimate, set by stable_time_step and shown in the GUI
+
+    // Steady state, see start_residual
+    bool steady_supported; // True if the PDE settles into a steady state worth stopping at
+    bool steady_state; // Whether the residual is monitored and the run stops once it falls below the tolerance
+    float steady_tolerance; // Residual below which the state counts as converged
+    int steady_norm; // Norm the tolerance applies to, 0 for the root mean square and 1 for the largest change
+    int residual_every; // Number of steps between two residuals, each copies the layers and reads a few values back
+    int steps_until_residual; // Steps left until the next residual
+    bool converged; // True while the last residual was below the tolerance, cleared with the layers
+    std::vector<float> residual_l2; // Root mean square change per unit time of every measured step, the most recent last
+    std::vector<float> residual_max; // Largest change per unit time of every measured step
+    std::vector<Texture> residual_base; // The layers before the measured step, only held for the duration of the step
+
+    // Textures
+    Texture image; // The output image 2D texture (RGBA8, with a mip chain for zoomed out views)
+    std::vector<Texture> layers; // The 2D textures storing the scalar fields associated with each layer, 2D arrays with one slice per run for ensembles
+    bool resident; // False while the layers are evicted to host memory and the grid holds no textures
+    std::vector<std::vector<unsigned char>> evicted_layers; // Compressed contents of each layer while the grid is evicted
+    std::vector<std::vector<float>> initial_state; // Optional per-layer data written after every clear, empty layers start at 0
+    unsigned int revision; // Incremented whenever the layers are rewritten outside of solve, so copies of the state kept elsewhere know to reload
+
+    std::map<std::string, float*> parameters; // PDE specific settings addressable by name, e.g. from scenario files
+    std::map<std::string, GridOption> options; // PDE specific choices addressable by name, e.g. from scenario files
+    std::map<std::string, ParameterField> parameter_fields; // Parameters that vary per cell, the shaders are compiled with FIELD_<name> defined for each
+    bool fields_supported; // True if the shaders have a per-cell variant of every parameter, see compile_shaders
 
-    // Texture IDs
-    unsigned int image; // The ID for the output image 2D texture
-    std::vector<unsigned int> layers; // The IDs for the 2D textures storing the scalar fields associated with each layer
+    // Spatial derivatives
+    bool stencils_supported; // True if the shaders have the wider 4th and 6th order stencils, see set_stencil_order
+    int stencil_order; // Order of accuracy of the laplacians and centered gradients of the explicit stencils: 2, 4 or 6
 
     Grid(int width = 0, int height = 0, int num_layers = 0);
+    virtual ~Grid();
 
+    void allocate(int num_layers);
+    int members() const;
     void resize(int width, int height);
-    void clear();
+    virtual void clear();
+    virtual void copy_from(const Grid& other);
+    void add_runge_kutta_methods();
+    int runge_kutta_method() const;
+    float stability_extent() const;
+    bool adapt_time_step();
+    bool start_residual();
+    bool finish_residual(Reduction& reduction);
+    void set_parameter_ramp(const std::string& name, int axis, float from, float to);
+    void set_parameter_data(const std::string& name, const std::vector<float>& data, int data_width, int data_height);
+    void remove_parameter_field(const std::string& name);
+    float largest_parameter(const std::string& name, float value) const;
+    void upload_parameter_fields();
+    void bind_parameter_fields(AbstractShader& shader);
+    std::string shader_defines() const;
+    void set_stencil_order(int order);
+    std::vector<float> second_difference() const;
+    float laplacian_scale() const;
+    virtual void evict();
+    void restore();
+    virtual size_t bytes() const;
     void set_pixelated();
     void bind();
+    std::vector<float> read_layer(int layer);
+    std::vector<float> read_image();
+    void write_layer(int layer, const std::vector<float>& data);
     virtual void brush(int x_pos, int y_pos);
+    virtual void compile_shaders() {}
+    virtual void sync() {}
+    virtual void evaluate_rates(const Texture&) {} // Writes the time derivative of the current layers into the slices of the given texture, see RungeKutta
+    virtual bool set_backend(bool cpu);
+    virtual float stable_time_step(); // Largest stable time step of the current state, infinite if the integrator has no limit
 
     virtual void solve() = 0;
     virtual void gui() = 0;
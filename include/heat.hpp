@@ -1,17 +1,42 @@
 #pragma once
 #include "shader.hpp"
 #include "grid.hpp"
+#include "multigrid.hpp"
+#include "fft.hpp"
+#include "runge_kutta.hpp"
 
 class Heat : public Grid {
 public:
     float diffusion;
 
+    // Implicit integrators, each step solves (I - theta dt alpha laplacian) u' = (I + (1 - theta) dt alpha laplacian) u
+    Multigrid multigrid; // Solves the linear system of every implicit step
+    int v_cycles; // Number of V-cycles per step
+    bool advance; // Whether the next step advances the solution, false while paused
+
+    // Spectral integrator for periodic grids, each step multiplies every Fourier mode of u by exp(-alpha |k|^2 dt)
+    FFT fft;
+
+    RungeKutta runge_kutta; // Explicit multi-stage integrators (see Grid::add_runge_kutta_methods) and the RKL2 super time steps
+
     ComputeShader heatCS;
 
     Heat(int width, int height);
 
+    bool spectral() const;
+    bool super() const;
+    int super_stages() const;
+    void step_spectral();
+    void evaluate_rates(const Texture& rates) override;
+    float stable_time_step() override;
+
     void solve() override;
     void gui() override;
     void reset_settings() override;
     void set_uniforms(std::string cmap_str, bool paused) override;
+    void compile_shaders() override;
+    bool set_backend(bool cpu) override;
+    void copy_from(const Grid& other) override;
+    void evict() override;
+    size_t bytes() const override;
 };
\ No newline at end of file
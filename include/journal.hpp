@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+
+class Grid;
+
+enum class JournalMode {
+    Off = 0,
+    Record,
+    Replay
+};
+
+enum class BrushEventKind : uint8_t {
+    Release = 0, // The brush was lifted
+    Stroke, // The brush was applied at a position
+    Clear // The grid was cleared
+};
+
+// A single input event, stored in grid coordinates so that it replays independently of the window size
+struct BrushEvent {
+    uint32_t step; // Index of the simulation step this event is applied before
+    int32_t x_pos; // The x coordinate passed to Grid::brush
+    int32_t y_pos; // The y coordinate passed to Grid::brush
+    uint16_t radius; // Brush radius at the time of the event
+    uint8_t layer; // Layer the brush paints into
+    BrushEventKind kind;
+};
+
+class Journal {
+public:
+    int sim; // Index of the simulation the journal was recorded with
+    int width; // Width of the grid the journal was recorded with
+    int height; // Height of the grid the journal was recorded with
+
+    std::vector<BrushEvent> events; // All recorded events, ordered by step
+    size_t cursor; // Index of the next event to replay
+
+    Journal();
+
+    void begin(int sim, int width, int height);
+    void record(uint32_t step, BrushEventKind kind, int x_pos, int y_pos, const Grid& grid);
+    bool replay(uint32_t step, Grid& grid);
+    void rewind();
+    bool finished() const;
+    uint32_t last_step() const;
+
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+};
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <utility>
+
+enum class JsonType {
+    Null = 0,
+    Bool,
+    Number,
+    String,
+    Array,
+    Object
+};
+
+// A parsed JSON document, kept deliberately small since it is only used for scenario files
+class JsonValue {
+public:
+    JsonType type;
+    bool boolean;
+    double number;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object; // Members in the order they appear in the document
+
+    JsonValue();
+
+    bool is_null() const;
+    bool is_number() const;
+    bool is_string() const;
+    bool is_array() const;
+    bool is_object() const;
+
+    const JsonValue* find(const std::string& key) const;
+    double get_number(const std::string& key, double fallback) const;
+    std::string get_string(const std::string& key, const std::string& fallback) const;
+    bool get_bool(const std::string& key, bool fallback) const;
+};
+
+bool parse_json(const std::string& text, JsonValue& value, std::string& error);
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+#include "shader.hpp"
+#include "grid.hpp"
+#include "texture.hpp"
+
+// Fluid flow with the lattice Boltzmann method on a D2Q9 lattice, every step only touches a cell and its neighbours.
+// The populations are streamed in place with the AA pattern: even steps collide and store every population in the slot
+// of its opposite direction at the same cell, odd steps gather from and scatter to the neighbours. Each step therefore reads
+// and writes every population once, without the second copy of the lattice a separate streaming step needs.
+// The layers hold the velocity, density and dye derived every step, the populations are rebuilt from them whenever they are rewritten.
+class LatticeBoltzmann : public Grid {
+public:
+    float viscosity; // Kinematic viscosity in lattice units, sets the relaxation time tau = 3 * viscosity + 0.5
+    float inflow; // Velocity along x of the fluid entering through open boundaries, in lattice units
+    float diffusion; // Diffusivity of the dye in lattice units
+    int prev_x_pos;
+    int prev_y_pos;
+
+    std::vector<const char*> visible_layer_strs;
+    std::vector<const char*> brush_layer_strs;
+
+    Buffer populations; // SSBO of 9 * width * height floats, one plane per lattice direction
+    bool odd; // Parity of the next step of the AA pattern
+    unsigned int populations_revision; // Grid::revision the populations were last initialized at
+    bool advance; // Whether the next step advances the flow, false while paused
+
+    ComputeShader lattice_boltzmannCS;
+
+    LatticeBoltzmann(int width, int height);
+
+    void brush(int x_pos, int y_pos) override;
+    void solve() override;
+    void dispatch(int pass);
+    void gui() override;
+    void reset_settings() override;
+    void set_uniforms(std::string cmap_str, bool paused) override;
+    void evict() override;
+    size_t bytes() const override;
+};
\ No newline at end of file
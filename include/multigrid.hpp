@@ -0,0 +1,53 @@
+#pragma once
+#include "shader.hpp"
+#include "texture.hpp"
+
+#include <vector>
+
+// One level of the multigrid hierarchy, every level halves the resolution of the previous one
+struct MultigridLevel {
+    int width, height;
+    Texture u, f, r, k; // Solution (or correction), right hand side, residual and laplacian coefficient on the GPU
+    std::vector<float> host_u, host_f, host_r, host_k; // The same fields on the CPU
+};
+
+// Geometric multigrid solver for identity * u - scale * k * laplacian(u) = f on a cell-centered grid, with k a per-cell coefficient.
+// Implicit time steps (identity = 1) and pressure Poisson equations (identity = 0) both reduce to this form.
+// Every pass runs either as a compute shader or as a CPU kernel with the same stencils and boundary conditions.
+class Multigrid {
+public:
+    std::vector<MultigridLevel> levels; // Finest level first
+
+    // Operator settings
+    float identity; // Coefficient of u
+    float scale; // Coefficient of the laplacian, e.g. the time step of a backward Euler step
+    float dx; // Cell size of the finest level, every coarser level doubles it
+    int boundary_condition; // Dirichlet, Neumann or Periodic, as for Grid::boundary_condition
+
+    // Cycle settings
+    int pre_smooth; // Red-black Gauss-Seidel sweeps before restricting the residual
+    int post_smooth; // Sweeps after adding the coarse correction
+    int coarse_sweeps; // Sweeps standing in for an exact solve on the coarsest level
+    bool cpu; // True to run every pass on the CPU instead of the GPU
+
+    ComputeShader multigridCS;
+
+    Multigrid();
+    ~Multigrid();
+
+    void resize(int width, int height);
+    void release();
+    size_t bytes() const;
+    void set_coefficient(const Texture* field, float value);
+    void evaluate(const Texture& u, float identity, float scale);
+    void solve(const Texture& u, int cycles);
+    float residual_norm();
+
+    void v_cycle(int level);
+    void smooth(int level, int sweeps);
+    void residual(int level);
+    void restrict_residual(int level);
+    void restrict_coefficient(int level);
+    void prolong(int level);
+    void dispatch(int level, int pass, int parity = 0);
+};
\ No newline at end of file
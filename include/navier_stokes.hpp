@@ -1,6 +1,11 @@
 #pragma once
 #include "shader.hpp"
 #include "grid.hpp"
+#include "multigrid.hpp"
+#include "fft.hpp"
+#include "gpu_fft.hpp"
+#include "runge_kutta.hpp"
+#include "reduction.hpp"
 
 #include <map>
 
@@ -9,19 +14,60 @@ public:
     float viscosity;
     int prev_x_pos;
     int prev_y_pos;
-    int brush_layer;
 
-    int visible_layer;
     std::vector<const char*> visible_layer_strs;
     std::vector<const char*> brush_layer_strs;
 
+    // Pressure
+    int pressure_solver; // 0 for artificial compressibility, 1 for a projection onto divergence free velocities, 2 for a projection solved with FFTs
+    Multigrid multigrid; // Solves the pressure Poisson equation of the projection
+    int v_cycles; // Number of V-cycles per projection
+    GpuFFT gpu_fft; // Solves the pressure Poisson equation of a spectral projection, and computes the energy spectrum
+    FFT fft; // Solves the pressure Poisson equation of a spectral projection on the CPU
+    bool advance; // Whether the next step advances the solution, false while paused
+
+    // Advection
+    int advection; // 0 for centered differences in navier_stokes.glsl, 1 for semi-Lagrangian, 2 for MacCormack
+    unsigned int samplers[4]; // Bilinear samplers of the velocity for each boundary condition, then of the dye
+
+    RungeKutta runge_kutta; // Explicit multi-stage integrators of the collocated layout, see Grid::add_runge_kutta_methods
+    Reduction reduction; // Largest velocities and viscosity, for the adaptive time step
+
+    // Staggered layout
+    int layout; // 0 for every field at the cell centers, 1 for the velocity on the cell faces (MAC grid) with the projection always on
+    Texture u_faces; // Velocity along x on the (width+1) x height vertical faces, the velocity layers then hold its average at the cell centers
+    Texture v_faces; // Velocity along y on the width x (height+1) horizontal faces
+    unsigned int faces_revision; // Grid::revision the faces were last rebuilt at, the faces are rebuilt from the layers when it differs
+
+    // Diagnostics
+    bool show_spectrum; // Whether the GUI plots the kinetic energy spectrum of the velocity
+    std::vector<float> energy; // Kinetic energy of every wavenumber shell, see GpuFFT::energy_spectrum
+
     ComputeShader navier_stokesCS;
+    ComputeShader projectionCS;
+    ComputeShader advectionCS;
+    ComputeShader staggeredCS;
 
     NavierStokes(int width, int height);
+    ~NavierStokes();
 
     void brush(int x_pos, int y_pos) override;
     void solve() override;
+    void project();
+    void project_staggered();
+    bool spectral() const;
+    void solve_pressure();
+    void advect();
+    void evaluate_rates(const Texture& rates) override;
+    float stable_time_step() override;
+    void step_staggered();
+    void dispatch_staggered(int pass, const Texture& u_in, const Texture& v_in, const Texture& u_out, const Texture& v_out);
     void gui() override;
     void reset_settings() override;
     void set_uniforms(std::string cmap_str, bool paused) override;
+    void compile_shaders() override;
+    bool set_backend(bool cpu) override;
+    void copy_from(const Grid& other) override;
+    void evict() override;
+    size_t bytes() const override;
 };
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+#include "shader.hpp"
+#include "texture.hpp"
+
+#include <vector>
+
+// Norms of the difference of two sets of fields over all of their cells, see Reduction::difference_norms
+struct Norms {
+    float l2; // Root mean square of the difference
+    float max; // Largest absolute difference
+};
+
+// Parallel reductions of R32F fields on the GPU, e.g. the largest velocity that bounds a stable time step.
+// Every work group reduces its cells in shared memory and the work groups combine their results with an atomic,
+// so only one value per field is read back, or one sum per work group for the norms of a difference.
+class Reduction {
+public:
+    Buffer maxima; // Largest absolute value of every field of the last reduction
+    Buffer sums; // Sum of squares of every work group of the last difference_norms
+    ComputeShader reductionCS;
+
+    Reduction();
+
+    std::vector<float> max_abs(const std::vector<const Texture*>& fields);
+    Norms difference_norms(const std::vector<const Texture*>& fields, const std::vector<const Texture*>& previous);
+};
\ No newline at end of file
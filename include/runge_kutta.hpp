@@ -0,0 +1,48 @@
+#pragma once
+#include "shader.hpp"
+#include "texture.hpp"
+
+#include <vector>
+
+class Grid;
+
+// Coefficients of an explicit Runge-Kutta method
+struct ButcherTableau {
+    const char* name; // Shown in the GUI and matched by scenario files, see Grid::integrator_strs
+    std::vector<std::vector<float>> a; // Row i weights the rates of the earlier stages in the state stage i is evaluated at
+    std::vector<float> b; // Weights of the rates of every stage in the next state
+    std::vector<float> error; // b minus the weights of the embedded lower order method, empty if the step size is fixed
+    int order; // Order of the embedded method, sets how quickly the step size adapts
+    bool fsal; // Whether the last stage is evaluated at the next state, so its rates are the first rates of the next step
+    float stability; // Extent of the stability region along the negative real axis, see Grid::stability_extent
+};
+
+const std::vector<ButcherTableau>& runge_kutta_methods();
+
+// Advances the layers of a grid with an explicit Runge-Kutta method on the GPU. The PDE writes the time derivative of its
+// current layers (see Grid::evaluate_rates) and runge_kutta.glsl combines the rates into the state of the next stage.
+// The state at the start of a step and the rates of every stage are 2D array textures with one slice per layer, taken from
+// the texture pool only for the duration of a step, so the grids of every tile share them.
+// The same passes run the Runge-Kutta-Legendre super time steps of diffusions, see super_step.
+class RungeKutta {
+public:
+    // Adaptive methods split every step into substeps whose estimated error stays below the tolerance
+    float tolerance; // Largest error of a substep, relative to the magnitude of the solution where it is above 1
+    float substep; // Size of the next substep, carried over between steps
+    int substeps; // Number of substeps of the last step, including rejected ones
+    int rejected; // Number of rejected substeps of the last step
+
+    Buffer reduction; // Largest scaled error of a substep, reduced by PASS_ERROR
+    ComputeShader runge_kuttaCS;
+
+    RungeKutta();
+
+    void step(Grid& grid, const ButcherTableau& method, float dt);
+    void super_step(Grid& grid, float dt, int stages);
+    static int super_stages(float ratio);
+    void gui(const ButcherTableau& method);
+
+    void combine(Grid& grid, const Texture& base, const std::vector<Texture>& rates, const std::vector<float>& weights, float h);
+    float estimate_error(Grid& grid, const Texture& base, const std::vector<Texture>& rates, const std::vector<float>& weights, float h);
+    void dispatch(Grid& grid, int pass, const Texture& base, float base_weight, const std::vector<const Texture*>& rates, const std::vector<float>& weights, float h);
+};
\ No newline at end of file
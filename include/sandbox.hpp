@@ -1,34 +1,106 @@
 #pragma once
+#include <glm/glm.hpp>
+
 #include "grid.hpp"
+#include "shader.hpp"
+#include "journal.hpp"
+#include "scenario.hpp"
+#include "reduction.hpp"
 
 #include <vector>
 #include <memory>
+#include <chrono>
+
+// A simulation shown in its own part of the viewport, every tile advances on every step
+struct Tile {
+    std::shared_ptr<Grid> grid;
+    int sim; // Index of the simulation the grid runs, see Sandbox::sim_strs
+    int cmap; // Index of the color map the grid is drawn with
+};
 
 class Sandbox {
 public:
     int window_width; // Width of the application window
     int window_height; // Height of the application window
     int gui_width; // Width of the sidebar UI
+    int grid_width; // Explicit width of every grid in cells, or 0 to derive it from the window and resolution
+    int grid_height; // Explicit height of every grid in cells, or 0 to derive it from the window and resolution
+    bool resize_pending; // True while the window size has changed but the grids have not been resized yet
+    std::chrono::steady_clock::time_point resize_requested; // When the window size last changed
 
     // Visual Settings
     bool paused; // True if the simulation is paused and false otherwise
-    int cmap; // Index of the currently selected color map
-    int sim; // Index of the currently selected simulation
+    int sim; // Index of the simulation shown in the first tile
+
+    // View
+    float zoom; // Magnification of the view, 1 fits the whole grid inside the viewport
+    glm::vec2 view_center; // Center of the view in texture coordinates of the grid
+    ComputeShader downsampleCS; // Generates the mip levels of the output image that are covered by the view
+    std::unique_ptr<Reduction> reduction; // Measures the residuals of grids that stop at a steady state, see Grid::start_residual
+    unsigned int step; // Number of simulation steps advanced since the start of the session or journal
+    int steps_per_frame; // Number of simulation steps advanced for every rendered frame
+
+    // Input Journal
+    Journal journal; // Brush events being recorded or replayed
+    JournalMode journal_mode; // Whether brush events are currently being recorded, replayed, or neither
+
+    Scenario scenario; // The scenario the sandbox was loaded from, default constructed if there is none
 
     // Dropdown lists for the sidebar UI, see sandbox.cpp for the values in each list
     std::vector<const char*> cmap_strs;
     std::vector<const char*> sim_strs;
+    std::vector<const char*> sim_ids; // Short identifiers for each simulation, accepted by scenario files
     std::vector<const char*> boundary_condition_strs;
+    std::vector<const char*> stencil_strs; // Indexed by Grid::stencil_order / 2 - 1
+    std::vector<const char*> steady_norm_strs;
+    std::vector<const char*> resample_filter_strs;
 
-    std::vector<std::shared_ptr<Grid>> grids; // Stores pointers to grids representing each simulation of a PDE
+    std::vector<std::shared_ptr<Grid>> grids; // Stores pointers to grids representing each simulation of a PDE, null until first selected
+
+    // Tiles
+    std::vector<Tile> tiles; // Simulations shown side by side, the first tile always shows grids[sim]
+    int focus; // Index of the tile edited by the sidebar and painted by the brush
+
+    // Parameter Fields
+    int field_parameter; // Index into the parameters of the focused grid edited by the Parameter Fields section
+    int field_mode; // 0 for a uniform value, 1 for a ramp along x, 2 for a ramp along y
+    float field_range[2]; // Values of the ramp at the first and last column or row
+
+    // Memory
+    int memory_budget; // Video memory in megabytes that grids and pooled textures may use before inactive grids are evicted
+    std::vector<unsigned int> last_selected; // When each grid was last selected, the least recently used grid is evicted first
+    unsigned int selections; // Number of times a simulation has been selected
 
     Sandbox(int window_width, int window_height, int gui_width);
 
     void render_gui();
-    void resize(int window_width, int window_height, int gui_width);
-    void advance_step();
+    void select_sim(int index);
+    std::shared_ptr<Grid> create_grid(int index);
+    void fit_grid(Grid& grid);
+    void add_tile();
+    void remove_tile();
+    glm::vec4 tile_rect(int index);
+    int tile_at(double x_pos, double y_pos);
+    void enforce_memory_budget();
+    size_t gpu_memory();
+    void resize(int window_width, int window_height, int gui_width, bool debounce = false);
+    void apply_pending_resize(bool force = false);
+    void set_grid_size(int width, int height);
+    void advance_step(bool render_image = true);
     void bind_current_grid();
     void brush(double x_pos, double y_pos);
+    void release_brush();
+    void start_recording();
+    bool start_replay(const std::string& path);
+    bool load_scenario(const Scenario& scenario);
     void reset_settings();
     void reset_grid();
+
+    float cells_per_pixel(int tile = 0);
+    glm::vec2 view_extent(int tile = 0);
+    glm::vec2 window_to_uv(double x_pos, double y_pos, int tile = 0);
+    void zoom_view(double x_pos, double y_pos, float factor);
+    void pan_view(double dx, double dy);
+    void reset_view();
+    float prepare_view(int tile = 0);
 };
\ No newline at end of file
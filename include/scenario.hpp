@@ -0,0 +1,79 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <optional>
+#include <utility>
+
+class Grid;
+
+// One step in building the initial state of a layer, applied in the order they appear in the scenario
+struct InitialCondition {
+    int layer; // Index of the layer to write
+    std::string type; // "constant", "disk", "rectangle", "noise" or "file"
+    float value; // Value written by constant, disk and rectangle, or the mean added by noise
+    float x, y; // Center of a disk or top left corner of a rectangle, in cells
+    float radius; // Radius of a disk, in cells
+    float width, height; // Size of a rectangle, in cells
+    float amplitude; // Half-width of the uniform distribution added by noise
+    unsigned int seed; // Seed of the noise generator, so runs stay reproducible
+    std::string path; // Raw row-major 32-bit float file read by "file"
+};
+
+// A parameter that varies across the grid instead of being a single value, see Grid::parameter_fields
+struct FieldSpec {
+    std::string name; // Name of the parameter, see Grid::parameters
+    int axis; // 0 for a ramp along x, 1 for a ramp along y, 2 for values read from a file
+    float from, to; // Values of a ramp at the first and last column or row
+    std::string path; // Raw row-major 32-bit float file with the values of the field
+    int width, height; // Size of the values in the file, they are resampled to the grid
+};
+
+// A declarative description of a full run: which PDE, its settings, initial state, length and outputs
+class Scenario {
+public:
+    std::string path; // The file the scenario was loaded from
+
+    std::string pde; // Name or identifier of the simulation to run
+    int width; // Explicit grid width in cells, or 0 to derive it from the window
+    int height; // Explicit grid height in cells, or 0 to derive it from the window
+
+    std::optional<int> resolution;
+    std::optional<float> space_step;
+    std::optional<float> time_step; // The first step if the time step is adaptive
+    std::optional<bool> adaptive_time_step; // Whether the time step follows the stability limit, see Grid::adapt_time_step
+    std::optional<int> boundary_condition;
+    std::optional<int> stencil_order; // 2, 4 or 6, see Grid::set_stencil_order
+    std::optional<float> steady_tolerance; // Set if the run stops at a steady state, see Grid::start_residual
+    std::string steady_norm; // "l2" or "max", the norm the tolerance applies to
+    int residual_every; // Number of steps between two residuals
+    std::optional<int> brush_radius;
+    std::optional<int> brush_layer;
+    std::optional<int> visible_layer;
+    std::optional<std::string> color_map;
+    std::optional<std::string> preset;
+    std::optional<std::string> backend; // "gpu" or "cpu", see Grid::set_backend
+    std::optional<std::string> integrator; // Name of a time integration scheme, see Grid::integrator_strs
+
+    std::vector<std::pair<std::string, std::pair<float, float>>> presets; // Extra Gray-Scott presets (feed and kill rates)
+    std::vector<std::pair<std::string, float>> parameters; // Values for Grid::parameters, applied after the preset
+    std::vector<std::pair<std::string, std::string>> options; // Names of the alternatives chosen for Grid::options
+    std::vector<FieldSpec> parameter_fields; // Parameters that vary per cell, e.g. the feed rate along x for a Gray-Scott map
+    std::vector<InitialCondition> initial_conditions;
+
+    unsigned int steps; // Number of steps to run, or 0 to run until stopped
+    int steps_per_frame; // Number of steps advanced per rendered frame in the GUI
+    std::string journal; // Optional journal of brush events to replay during the run
+
+    unsigned int output_every; // Write outputs every this many steps, or 0 to only write them at the end of headless runs
+    std::vector<std::string> output_formats; // Any of "raw" (all layers as floats) and "ppm" (the color mapped image)
+    std::string output_path; // Prefix of every output file, the step index and extension are appended
+
+    Scenario();
+
+    bool load(const std::string& path);
+    std::vector<std::vector<float>> build_initial_state(int num_layers, int width, int height) const;
+    void write_outputs(Grid& grid, unsigned int step) const;
+};
+
+void write_raw(Grid& grid, const std::string& path);
+void write_ppm(Grid& grid, const std::string& path);
\ No newline at end of file
@@ -35,5 +35,5 @@ public:
 
 class ComputeShader : public AbstractShader {
 public:
-    ComputeShader(const std::string& source_path);
+    ComputeShader(const std::string& source_path, const std::string& defines = "");
 };
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <tuple>
+#include <cstddef>
+
+// Owning handle for an immutable 2D (or 2D array) OpenGL texture, the texture is deleted when the handle is destroyed
+class Texture {
+public:
+    unsigned int ID; // The OpenGL name of the texture, 0 if the handle is empty
+    unsigned int format; // Sized internal format, e.g. GL_R32F
+    int width;
+    int height;
+    int levels; // Number of mip levels
+    int depth; // Number of array layers, 0 for a plain 2D texture
+
+    Texture();
+    Texture(unsigned int format, int width, int height, int levels = 1, int depth = 0);
+    ~Texture();
+
+    Texture(const Texture&) = delete;
+    Texture& operator=(const Texture&) = delete;
+    Texture(Texture&& other) noexcept;
+    Texture& operator=(Texture&& other) noexcept;
+
+    void clear();
+    size_t bytes() const;
+};
+
+// Owning handle for an immutable OpenGL buffer (e.g. an SSBO), the buffer is deleted when the handle is destroyed
+class Buffer {
+public:
+    unsigned int ID; // The OpenGL name of the buffer, 0 if the handle is empty
+    size_t size; // Size of the buffer in bytes
+
+    Buffer();
+    Buffer(size_t size, const void* data = nullptr, unsigned int flags = 0);
+    ~Buffer();
+
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+    Buffer(Buffer&& other) noexcept;
+    Buffer& operator=(Buffer&& other) noexcept;
+
+    void clear();
+};
+
+// Keeps released textures around so that resizes and simulation switches can reuse them instead of reallocating
+class TexturePool {
+public:
+    std::map<std::tuple<unsigned int, int, int, int, int>, std::vector<Texture>> idle; // Released textures keyed by (format, width, height, levels, depth)
+    size_t idle_bytes; // Total size of all idle textures
+    size_t max_idle_bytes; // Idle textures beyond this total size are freed
+
+    TexturePool();
+
+    Texture acquire(unsigned int format, int width, int height, int levels = 1, int depth = 0);
+    void release(Texture&& texture);
+    void trim(size_t max_bytes);
+};
+
+TexturePool& texture_pool();
\ No newline at end of file
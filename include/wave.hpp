@@ -2,19 +2,43 @@
 #include "shader.hpp"
 #include "grid.hpp"
 
+// The wave equation u_tt = c^2 laplacian(u), advanced with the leapfrog (Stormer-Verlet) scheme
+// u' = 2 u - u_previous + (c dt)^2 laplacian(u). The layers hold the current, previous and next time levels, and every
+// step rotates them instead of copying, so the next level of one step is written over the previous level of the last.
 class Wave : public Grid {
 public:
-    float diffusion;
-    float dx;
-    float dy;
-    float dt;
+    float speed; // Wave speed c, the step is stable while the Courant number c dt / dx stays below courant_limit
+    float last_time_step; // Time step between the previous and current levels, the velocity is rescaled when it changes
+    bool advance; // Whether the next step advances the solution, false while paused
+    bool start_at_rest; // Whether the next step first derives the previous level from the current one, see clear
+    bool show_energy; // Whether the GUI reads the levels back to show the discrete energy
+
+    // Absorbing layer along the edges, the equation becomes u_tt + sigma u_t = c^2 laplacian(u) with a damping sigma that
+    // grows quadratically towards the edges, so outgoing waves fade instead of reflecting back into the domain
+    float absorbing_layer; // Width of the layer in cells, 0 to turn it off
+    float reflection; // Reflection coefficient the largest damping is chosen for, lower values damp harder
+    Texture damping; // ((L - d) / L)^2 at distance d < L from the nearest edge, scaled by the largest damping in the shader
+    int damping_layer; // Layer width the damping texture was built for
 
     ComputeShader waveCS;
 
     Wave(int width, int height);
+    ~Wave();
+
+    float courant_number() const;
+    float courant_limit() const;
+    float energy();
+    float stable_time_step() override;
+    void update_damping();
+    float largest_damping() const;
+    void clear() override;
 
     void solve() override;
     void gui() override;
     void reset_settings() override;
     void set_uniforms(std::string cmap_str, bool paused) override;
+    void compile_shaders() override;
+    void copy_from(const Grid& other) override;
+    void evict() override;
+    size_t bytes() const override;
 };
\ No newline at end of file
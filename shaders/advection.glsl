@@ -0,0 +1,85 @@
+#version 460 core
+
+// Semi-Lagrangian advection of the velocity and dye for Navier-Stokes, optionally corrected with MacCormack's scheme
+layout (local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+layout (r32f, binding = 1) uniform image2D u_out;
+layout (r32f, binding = 2) uniform image2D v_out;
+layout (r32f, binding = 3) uniform image2D s_out;
+
+// The fields at the start of the step, sampled bilinearly with wrap modes matching the boundary conditions
+uniform sampler2D u_field;
+uniform sampler2D v_field;
+uniform sampler2D s_field;
+
+// The semi-Lagrangian estimate written by PASS_ADVECT, read by PASS_CORRECT
+uniform sampler2D u_estimate;
+uniform sampler2D v_estimate;
+uniform sampler2D s_estimate;
+
+// Passes, see NavierStokes::advect
+#define PASS_ADVECT 0
+#define PASS_CORRECT 1
+
+uniform int pass;
+
+// Dimensions of the grids
+uniform int width;
+uniform int height;
+
+// PDE settings
+uniform float dx;
+uniform float dt;
+
+// Converts a position in cells, with cell centers on integers, to texture coordinates
+vec2 texcoord(vec2 position) {
+    return (position + 0.5) / vec2(width, height);
+}
+
+// Follows the velocity through a position for dt, backwards in time for a direction of 1 and forwards for -1, with a midpoint step
+vec2 trace(vec2 position, float direction) {
+    vec2 velocity = vec2(texture(u_field, texcoord(position)).r, texture(v_field, texcoord(position)).r);
+    vec2 midpoint = position - 0.5 * direction * dt * velocity / dx;
+    velocity = vec2(texture(u_field, texcoord(midpoint)).r, texture(v_field, texcoord(midpoint)).r);
+    return position - direction * dt * velocity / dx;
+}
+
+// Samples the dye, which flows in at 1 through the left edge and out at 0 through the right edge as in navier_stokes.glsl
+float sample_dye(sampler2D field, vec2 position) {
+    float value = texture(field, texcoord(position)).r;
+    value = mix(value, 1.0, clamp(-position.x, 0.0, 1.0));
+    return mix(value, 0.0, clamp(position.x - float(width - 1), 0.0, 1.0));
+}
+
+// Clamps a corrected value to the range of the four cells its characteristic started between, which keeps the scheme free of new extrema
+float limit(float value, vec4 around) {
+    return clamp(value, min(min(around.x, around.y), min(around.z, around.w)), max(max(around.x, around.y), max(around.z, around.w)));
+}
+
+void main() {
+    ivec2 location = ivec2(gl_GlobalInvocationID.xy);
+    if (location.x >= width || location.y >= height) return;
+    vec2 position = vec2(location);
+    vec2 back = trace(position, 1.0);
+
+    if (pass == PASS_ADVECT) {
+        imageStore(u_out, location, vec4(texture(u_field, texcoord(back)).r));
+        imageStore(v_out, location, vec4(texture(v_field, texcoord(back)).r));
+        imageStore(s_out, location, vec4(sample_dye(s_field, back)));
+    } else if (pass == PASS_CORRECT) {
+        // Advecting the estimate forwards again should give back the original field, half of the difference is the error of the estimate
+        vec2 forward = trace(position, -1.0);
+        float u = texelFetch(u_estimate, location, 0).r + 0.5 * (texelFetch(u_field, location, 0).r - texture(u_estimate, texcoord(forward)).r);
+        float v = texelFetch(v_estimate, location, 0).r + 0.5 * (texelFetch(v_field, location, 0).r - texture(v_estimate, texcoord(forward)).r);
+        float s = texelFetch(s_estimate, location, 0).r + 0.5 * (texelFetch(s_field, location, 0).r - sample_dye(s_estimate, forward));
+
+        // Gathered cells beyond the left and right edges hold the inflowing and outflowing dye, x and w form the left column
+        vec4 s_around = textureGather(s_field, texcoord(back));
+        if (back.x < 0.0) s_around.xw = vec2(1.0);
+        if (back.x < -1.0) s_around.yz = vec2(1.0);
+        if (back.x >= float(width)) s_around.xw = vec2(0.0);
+        if (back.x >= float(width - 1)) s_around.yz = vec2(0.0);
+        imageStore(u_out, location, vec4(limit(u, textureGather(u_field, texcoord(back)))));
+        imageStore(v_out, location, vec4(limit(v, textureGather(v_field, texcoord(back)))));
+        imageStore(s_out, location, vec4(limit(s, s_around)));
+    }
+}
\ No newline at end of file
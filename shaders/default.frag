@@ -5,6 +5,16 @@ in vec2 TexCoord;
 
 uniform sampler2D tex;
 
+// The region of the grid covered by the viewport, in texture coordinates
+uniform vec2 view_center;
+uniform vec2 view_extent;
+uniform float lod; // Mip level matching the number of cells per screen pixel
+
 void main() {
-    FragColor = vec4(texture(tex, TexCoord).rgb, 1.0);
+    vec2 uv = view_center + (TexCoord - 0.5) * view_extent;
+    if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0)))) {
+        FragColor = vec4(0.1, 0.1, 0.1, 1.0);
+        return;
+    }
+    FragColor = vec4(textureLod(tex, uv, lod).rgb, 1.0);
 }
\ No newline at end of file
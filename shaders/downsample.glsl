@@ -0,0 +1,24 @@
+#version 460 core
+
+layout (local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+layout (rgba8, binding = 0) uniform readonly image2D src; // The finer mip level
+layout (rgba8, binding = 1) uniform writeonly image2D dst; // The coarser mip level being generated
+
+// First texel of the coarser level covered by this dispatch, so only the visible region is generated
+uniform int x_offset;
+uniform int y_offset;
+
+void main() {
+    ivec2 location = ivec2(x_offset, y_offset) + ivec2(gl_GlobalInvocationID.xy);
+    ivec2 dst_size = imageSize(dst);
+    if (location.x >= dst_size.x || location.y >= dst_size.y) return;
+
+    // Box filter over the 2x2 block of finer texels, clamped for odd sized levels
+    ivec2 src_max = imageSize(src) - 1;
+    ivec2 base = location * 2;
+    vec4 sum = imageLoad(src, min(base, src_max))
+             + imageLoad(src, min(base + ivec2(1, 0), src_max))
+             + imageLoad(src, min(base + ivec2(0, 1), src_max))
+             + imageLoad(src, min(base + ivec2(1, 1), src_max));
+    imageStore(dst, location, sum * 0.25);
+}
\ No newline at end of file
@@ -0,0 +1,149 @@
+#version 460 core
+
+// Passes of the GPU FFT, see GpuFFT in gpu_fft.hpp. Complex values are stored as the red and green channels of RG32F textures.
+layout (local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+layout (rg32f, binding = 1) uniform image2D source;
+layout (rg32f, binding = 2) uniform image2D target;
+layout (rg32f, binding = 3) uniform image2D twiddles; // exp(-2 pi i k / length) for the transform being run
+layout (rg32f, binding = 4) uniform image2D chirp; // exp(-pi i k^2 / n) of Bluestein's algorithm
+layout (rg32f, binding = 5) uniform image2D kernel; // Spectrum of the chirp Bluestein's algorithm convolves with
+layout (r32f, binding = 6) uniform image2D real_part;
+layout (r32f, binding = 7) uniform image2D imaginary_part;
+
+// Energy of every wavenumber shell, written by PASS_SPECTRUM
+layout (std430, binding = 0) buffer Spectrum {
+    float energy[];
+};
+
+// Passes
+#define PASS_PACK 0
+#define PASS_STAGE 1
+#define PASS_CHIRP 2
+#define PASS_CONVOLVE 3
+#define PASS_UNCHIRP 4
+#define PASS_UNPACK 5
+#define PASS_POISSON 6
+#define PASS_SPECTRUM 7
+
+uniform int pass;
+
+// Dimensions of the complex grid
+uniform int width;
+uniform int height;
+
+// Transform settings
+uniform int axis; // 0 to transform along x, 1 along y
+uniform int length; // Length of the transform along the axis
+uniform int lines; // Number of transforms, the size of the grid along the other axis
+uniform float sign; // -1 for forward transforms and 1 for inverse transforms
+uniform int stage_length; // Length of the sub-transforms of a Stockham stage
+uniform int stride; // Number of sub-transforms of a Stockham stage
+uniform int radix; // Radix of a Stockham stage, at most 7
+uniform int chirp_length; // Length n of a transform computed with Bluestein's algorithm
+uniform float scale; // Factor applied by PASS_UNCHIRP and PASS_UNPACK
+uniform bool imaginary; // Whether PASS_PACK reads an imaginary part
+
+// Poisson and spectrum settings
+uniform float dx; // Size of a cell
+uniform bool wide; // Whether the laplacian is the composition of two centered differences instead of the 5 point stencil
+uniform int bins; // Number of wavenumber shells
+
+vec2 cmul(vec2 a, vec2 b) {
+    return vec2(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+}
+
+// Position of point i of a transform
+ivec2 point(int i, int line) {
+    return axis == 0 ? ivec2(i, line) : ivec2(line, i);
+}
+
+// exp(sign * 2 pi i k / length), the table holds the forward factors and inverse transforms use their conjugates
+vec2 twiddle(int k) {
+    vec2 w = imageLoad(twiddles, ivec2(k % length, 0)).rg;
+    return vec2(w.x, -sign * w.y);
+}
+
+// The chirp of Bluestein's algorithm, conjugated for inverse transforms
+vec2 chirp_at(int k) {
+    vec2 c = imageLoad(chirp, ivec2(k, 0)).rg;
+    return vec2(c.x, -sign * c.y);
+}
+
+// Squared distance of a frequency from the origin in units of the lowest frequency of the longer side
+float shell(int fx, int fy) {
+    float size = float(max(width, height));
+    return pow(float(fx) * size / float(width), 2.0) + pow(float(fy) * size / float(height), 2.0);
+}
+
+void main() {
+    ivec2 location = ivec2(gl_GlobalInvocationID.xy);
+    int i = location.x, line = location.y;
+
+    if (pass == PASS_PACK) {
+        if (i >= width || line >= height) return;
+        float im = imaginary ? imageLoad(imaginary_part, location).r : 0.0;
+        imageStore(target, location, vec4(imageLoad(real_part, location).r, im, 0.0, 0.0));
+    } else if (pass == PASS_STAGE) {
+        // One butterfly of a Stockham stage: a DFT of radix points a stage_length / radix apart, multiplied by the stage twiddles,
+        // written next to each other so that no reordering pass is needed
+        if (i >= length / radix || line >= lines) return;
+        int m = stage_length / radix;
+        int q = i % stride, p = i / stride;
+        vec2 a[7];
+        for (int k = 0; k < radix; k++) a[k] = imageLoad(source, point(q + stride * (p + k * m), line)).rg;
+        for (int j = 0; j < radix; j++) {
+            vec2 sum = a[0];
+            for (int k = 1; k < radix; k++) sum += cmul(a[k], twiddle((j * k % radix) * (length / radix)));
+            vec2 result = cmul(sum, twiddle(p * j * (length / stage_length)));
+            imageStore(target, point(q + stride * (radix * p + j), line), vec4(result, 0.0, 0.0));
+        }
+    } else if (pass == PASS_CHIRP) {
+        // Multiplies by the chirp and pads with zeros to the power of two length of the convolution
+        if (i >= length || line >= lines) return;
+        vec2 value = i < chirp_length ? cmul(imageLoad(source, point(i, line)).rg, chirp_at(i)) : vec2(0.0);
+        imageStore(target, point(i, line), vec4(value, 0.0, 0.0));
+    } else if (pass == PASS_CONVOLVE) {
+        if (i >= length || line >= lines) return;
+        vec2 value = cmul(imageLoad(source, point(i, line)).rg, imageLoad(kernel, ivec2(i, 0)).rg);
+        imageStore(target, point(i, line), vec4(value, 0.0, 0.0));
+    } else if (pass == PASS_UNCHIRP) {
+        if (i >= chirp_length || line >= lines) return;
+        vec2 value = scale * cmul(imageLoad(source, point(i, line)).rg, chirp_at(i));
+        imageStore(target, point(i, line), vec4(value, 0.0, 0.0));
+    } else if (pass == PASS_UNPACK) {
+        if (i >= width || line >= height) return;
+        imageStore(real_part, location, vec4(scale * imageLoad(source, location).r));
+    } else if (pass == PASS_POISSON) {
+        // Divides every mode by the eigenvalue of the negative laplacian, the mean and the modes it cannot see are set to 0
+        if (i >= width || line >= height) return;
+        float theta_x = 6.28318531 * float(i) / float(width);
+        float theta_y = 6.28318531 * float(line) / float(height);
+        float eigenvalue = wide ? pow(sin(theta_x), 2.0) + pow(sin(theta_y), 2.0) : 4.0 * (pow(sin(0.5 * theta_x), 2.0) + pow(sin(0.5 * theta_y), 2.0));
+        vec2 value = eigenvalue > 1e-6 ? imageLoad(source, location).rg * dx * dx / eigenvalue : vec2(0.0);
+        imageStore(target, location, vec4(value, 0.0, 0.0));
+    } else if (pass == PASS_SPECTRUM) {
+        // Sums the energy of the modes whose wavenumber rounds to this shell. For every frequency along x, only the frequencies
+        // along y within the shell are visited, so all shells together visit every mode about once.
+        int bin = i;
+        if (bin >= bins || line > 0) return;
+        float inner = max(0.0, float(bin) - 0.5), outer = float(bin) + 0.5;
+        float sum = 0.0;
+        for (int fx = -(width - 1) / 2; fx <= width / 2; fx++) {
+            float rest = outer * outer - shell(fx, 0);
+            if (rest < 0.0) continue;
+            float ratio = float(height) / float(max(width, height));
+            int low = int(floor(sqrt(max(0.0, inner * inner - shell(fx, 0))) * ratio));
+            int high = min(int(ceil(sqrt(rest) * ratio)), height / 2);
+            for (int fy = low; fy <= high; fy++) {
+                for (int s = 0; s < 2; s++) {
+                    int f = s == 0 ? fy : -fy;
+                    if ((s == 1 && fy == 0) || f < -(height - 1) / 2) continue;
+                    if (int(round(sqrt(shell(fx, f)))) != bin) continue;
+                    vec2 z = imageLoad(source, ivec2((fx + width) % width, (f + height) % height)).rg;
+                    sum += dot(z, z);
+                }
+            }
+        }
+        energy[bin] = 0.5 * sum * scale;
+    }
+}
\ No newline at end of file
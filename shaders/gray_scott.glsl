@@ -1,9 +1,10 @@
 #version 460 core
 
 layout (local_size_x = 1, local_size_y = 1, local_size_z = 1) in;
-layout (rgba32f, binding = 0) uniform image2D imgOutput;
+layout (rgba8, binding = 0) uniform image2D imgOutput;
 layout (r32f, binding = 1) uniform image2D u;
 layout (r32f, binding = 2) uniform image2D v;
+layout (r32f, binding = 3) uniform image2DArray rates; // Written instead of a step when derivative is set, see RungeKutta
 
 // Dimensions of the grids
 uniform int width;
@@ -11,9 +12,14 @@ uniform int height;
 
 // PDE settings
 uniform bool paused;
+uniform bool render_image;
 uniform int boundary_condition;
 uniform float dx;
 uniform float dt;
+uniform bool derivative; // True to only write the time derivatives of u and v into rates, for the Runge-Kutta integrators
+uniform bool reactions; // True to only advance the reactions over dt, the implicit-explicit integrators solve the diffusion separately
+uniform int reaction_substeps; // Number of forward Euler substeps the reactions are advanced with
+uniform bool diffusion_only; // True to leave the reactions out of the time derivatives, for the Runge-Kutta-Legendre integrator
 
 // Brush settings
 uniform int brush_enabled;
@@ -22,10 +28,30 @@ uniform int y_pos;
 uniform int brush_radius;
 uniform int visible_layer;
 
-// Gray-Scott Reaction Diffusion specific settings
+// Gray-Scott Reaction Diffusion specific settings, either uniform or sampled per cell when compiled with FIELD_<name>
+#ifdef FIELD_a
+uniform sampler2D a_field;
+float a_at(int x, int y) { return texelFetch(a_field, ivec2(x, y), 0).r; }
+#else
 uniform float a;
+float a_at(int x, int y) { return a; }
+#endif
+
+#ifdef FIELD_b
+uniform sampler2D b_field;
+float b_at(int x, int y) { return texelFetch(b_field, ivec2(x, y), 0).r; }
+#else
 uniform float b;
+float b_at(int x, int y) { return b; }
+#endif
+
+#ifdef FIELD_D
+uniform sampler2D D_field;
+float D_at(int x, int y) { return texelFetch(D_field, ivec2(x, y), 0).r; }
+#else
 uniform float D;
+float D_at(int x, int y) { return D; }
+#endif
 
 // Color Map Poly 6 Coefficients
 uniform vec3 c0, c1, c2, c3, c4, c5, c6;
@@ -35,11 +61,48 @@ vec3 cmap(float t) {
     return c0+t*(c1+t*(c2+t*(c3+t*(c4+t*(c5+t*c6)))));
 }
 
-// Performs the remainder operation
+// Performs the remainder operation, % is undefined for negative operands in GLSL
 int fmod(int x, int y) {
-    return (x % y + y) % y;
+    return x - y * int(floor(float(x) / float(y)));
+}
+
+#ifdef STENCIL_ORDER
+// Wider stencils, compiled in with STENCIL_ORDER 4 or 6, see Grid::set_stencil_order. Coefficients of the centered second
+// difference from the center outwards, HALO cells on either side.
+#if STENCIL_ORDER == 6
+const int HALO = 3;
+const float SECOND[4] = float[](-49.0 / 18.0, 3.0 / 2.0, -3.0 / 20.0, 1.0 / 90.0);
+#else
+const int HALO = 2;
+const float SECOND[4] = float[](-5.0 / 2.0, 4.0 / 3.0, -1.0 / 12.0, 0.0);
+#endif
+
+// Index the wide stencils read in place of index i along an axis of n cells, and the sign of the value there. Neumann edges
+// mirror the cells inside, Dirichlet edges mirror them with the opposite sign around the first ghost cell, which stays 0.
+ivec2 mirror(int i, int n) {
+    if (i >= 0 && i < n) return ivec2(i, 1);
+    if (boundary_condition == 2) return ivec2(fmod(i, n), 1);
+    if (boundary_condition == 1) return ivec2(clamp(i < 0 ? -1 - i : 2 * n - 1 - i, 0, n - 1), 1);
+    if (i == -1 || i == n) return ivec2(0, 0);
+    return ivec2(clamp(i < 0 ? -2 - i : 2 * n - i, 0, n - 1), -1);
 }
 
+// Value of layer 0 (u) or 1 (v) for the wide stencils, see mirror
+float wide_value(int layer, int x, int y) {
+    ivec2 column = mirror(x, width), row = mirror(y, height);
+    ivec2 cell = ivec2(column.x, row.x);
+    return float(column.y * row.y) * (layer == 0 ? imageLoad(u, cell).r : imageLoad(v, cell).r);
+}
+
+// Laplacian of a layer with the wide stencil
+float wide_laplacian(int layer, int x, int y) {
+    float sum = 2.0 * SECOND[0] * wide_value(layer, x, y);
+    for (int k = 1; k <= HALO; k++)
+        sum += SECOND[k] * (wide_value(layer, x-k, y) + wide_value(layer, x+k, y) + wide_value(layer, x, y-k) + wide_value(layer, x, y+k));
+    return sum / (dx * dx);
+}
+#endif
+
 // Accesses the value of the U grid at a coordinate while respecting value-based boundary conditions
 float U(int x, int y) {
     if (x < 0 || x >= width || y < 0 || y >= height) {
@@ -83,8 +146,13 @@ float du_dt(int x, int y) {
 
     float d2u_dx2 = (du_dx_1 - du_dx_0) / dx;
     float d2u_dy2 = (du_dy_1 - du_dy_0) / dx;
+    float laplacian = d2u_dx2 + d2u_dy2;
+#ifdef STENCIL_ORDER
+    laplacian = wide_laplacian(0, x, y);
+#endif
 
-    return (d2u_dx2 + d2u_dy2) + (pow(U(x, y), 2) * V(x, y)) - ((a + b) * U(x, y));
+    if (diffusion_only) return laplacian;
+    return laplacian + (pow(U(x, y), 2) * V(x, y)) - ((a_at(x, y) + b_at(x, y)) * U(x, y));
 }
 
 // Computes the temporal derivative at a coordinate points in the V grid
@@ -104,12 +172,38 @@ float dv_dt(int x, int y) {
 
     float d2v_dx2 = (dv_dx_1 - dv_dx_0) / dx;
     float d2v_dy2 = (dv_dy_1 - dv_dy_0) / dx;
+    float laplacian = d2v_dx2 + d2v_dy2;
+#ifdef STENCIL_ORDER
+    laplacian = wide_laplacian(1, x, y);
+#endif
 
-    return D * (d2v_dx2 + d2v_dy2) - (pow(U(x, y), 2) * V(x, y)) + a * (1 - V(x, y));
+    if (diffusion_only) return D_at(x, y) * laplacian;
+    return D_at(x, y) * laplacian - (pow(U(x, y), 2) * V(x, y)) + a_at(x, y) * (1 - V(x, y));
 }
 
 void main() {
     ivec2 location = ivec2(gl_GlobalInvocationID.xy);
+    if (derivative) {
+        imageStore(rates, ivec3(location, 0), vec4(du_dt(location.x, location.y)));
+        imageStore(rates, ivec3(location, 1), vec4(dv_dt(location.x, location.y)));
+        return;
+    }
+    if (reactions) {
+        float u_value = U(location.x, location.y);
+        float v_value = V(location.x, location.y);
+        float feed = a_at(location.x, location.y);
+        float kill = b_at(location.x, location.y);
+        float h = dt / float(reaction_substeps);
+        for (int i = 0; i < reaction_substeps; i++) {
+            float reaction = u_value * u_value * v_value;
+            u_value += h * (reaction - (feed + kill) * u_value);
+            v_value += h * (feed * (1.0 - v_value) - reaction);
+        }
+        imageStore(u, location, vec4(u_value));
+        imageStore(v, location, vec4(v_value));
+        return;
+    }
+
     int pause = paused ? 0 : 1;
     float brush_value = 1.0f;
 
@@ -121,6 +215,8 @@ void main() {
     imageStore(u, location, vec4(luminosity));
     imageStore(v, location, vec4(V(location.x, location.y) + dv_dt * dt * pause));
 
+    if (!render_image) return;
+
     if (visible_layer == 0) {
         imageStore(imgOutput, location, vec4(cmap(min(1.0, abs(imageLoad(u, location).r * 2.0))), 1.0));
     } else if (visible_layer == 1) {
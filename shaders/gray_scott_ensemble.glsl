@@ -0,0 +1,149 @@
+#version 460 core
+
+// Every invocation along z advances a different member of the ensemble
+layout (local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+layout (rgba8, binding = 0) uniform image2D imgOutput;
+layout (r32f, binding = 1) uniform image2DArray u;
+layout (r32f, binding = 2) uniform image2DArray v;
+
+// Settings of a single member, see EnsembleMember in gray_scott_ensemble.hpp
+struct Member {
+    float a;
+    float b;
+    float D;
+    float dt;
+    float dx;
+};
+
+layout (std430, binding = 0) readonly buffer Members {
+    Member members[];
+};
+
+// Dimensions of every member and their layout in the output image
+uniform int width;
+uniform int height;
+uniform int columns;
+
+// PDE settings
+uniform bool paused;
+uniform bool render_image;
+uniform int boundary_condition;
+
+// Brush settings, in coordinates of the output image
+uniform int brush_enabled;
+uniform int x_pos;
+uniform int y_pos;
+uniform int brush_radius;
+uniform int visible_layer;
+
+// Color Map Poly 6 Coefficients
+uniform vec3 c0, c1, c2, c3, c4, c5, c6;
+
+// 6th Order Polynomial Approximation for Matplotlib Color Maps
+vec3 cmap(float t) {
+    return c0+t*(c1+t*(c2+t*(c3+t*(c4+t*(c5+t*c6)))));
+}
+
+// Performs the remainder operation, % is undefined for negative operands in GLSL
+int fmod(int x, int y) {
+    return x - y * int(floor(float(x) / float(y)));
+}
+
+int member;
+
+// Accesses the value of the U grid of the current member while respecting value-based boundary conditions
+float U(int x, int y) {
+    if (x < 0 || x >= width || y < 0 || y >= height) {
+        if (boundary_condition == 2) { // Periodic Boundary Condition
+            return imageLoad(u, ivec3(fmod(x, width), fmod(y, height), member)).r;
+        } else { // Dirichlet Boundary Condition
+            return 0.0;
+        }
+    }
+
+    return imageLoad(u, ivec3(x, y, member)).r;
+}
+
+// Accesses the value of the V grid of the current member while respecting value-based boundary conditions
+float V(int x, int y) {
+    if (x < 0 || x >= width || y < 0 || y >= height) {
+        if (boundary_condition == 2) { // Periodic Boundary Condition
+            return imageLoad(v, ivec3(fmod(x, width), fmod(y, height), member)).r;
+        } else { // Dirichlet Boundary Condition
+            return 0.0;
+        }
+    }
+
+    return imageLoad(v, ivec3(x, y, member)).r;
+}
+
+// Computes the Laplacian of the U grid at a coordinate
+float laplacian_u(int x, int y, float dx) {
+    float du_dx_0 = (U(x, y) - U(x-1, y)) / dx;
+    float du_dx_1 = (U(x+1, y) - U(x, y)) / dx;
+
+    float du_dy_0 = (U(x, y) - U(x, y-1)) / dx;
+    float du_dy_1 = (U(x, y+1) - U(x, y)) / dx;
+
+    if (boundary_condition == 1) { // Neumann Boundary Condition
+        if (x == 0) du_dx_0 = 0.0;
+        if (x == width-1) du_dx_1 = 0.0;
+        if (y == 0) du_dy_0 = 0.0;
+        if (y == height-1) du_dy_1 = 0.0;
+    }
+
+    return (du_dx_1 - du_dx_0) / dx + (du_dy_1 - du_dy_0) / dx;
+}
+
+// Computes the Laplacian of the V grid at a coordinate
+float laplacian_v(int x, int y, float dx) {
+    float dv_dx_0 = (V(x, y) - V(x-1, y)) / dx;
+    float dv_dx_1 = (V(x+1, y) - V(x, y)) / dx;
+
+    float dv_dy_0 = (V(x, y) - V(x, y-1)) / dx;
+    float dv_dy_1 = (V(x, y+1) - V(x, y)) / dx;
+
+    if (boundary_condition == 1) { // Neumann Boundary Condition
+        if (x == 0) dv_dx_0 = 0.0;
+        if (x == width-1) dv_dx_1 = 0.0;
+        if (y == 0) dv_dy_0 = 0.0;
+        if (y == height-1) dv_dy_1 = 0.0;
+    }
+
+    return (dv_dx_1 - dv_dx_0) / dx + (dv_dy_1 - dv_dy_0) / dx;
+}
+
+void main() {
+    ivec2 location = ivec2(gl_GlobalInvocationID.xy);
+    member = int(gl_GlobalInvocationID.z);
+    if (location.x >= width || location.y >= height) return;
+
+    Member m = members[member];
+    ivec2 tile = ivec2(member % columns, member / columns);
+    int pause = paused ? 0 : 1;
+    float brush_value = 1.0f;
+
+    float u0 = U(location.x, location.y);
+    float v0 = V(location.x, location.y);
+    float du_dt = laplacian_u(location.x, location.y, m.dx) + u0 * u0 * v0 - (m.a + m.b) * u0;
+    float dv_dt = m.D * laplacian_v(location.x, location.y, m.dx) - u0 * u0 * v0 + m.a * (1 - v0);
+
+    // The brush only paints the member under the cursor
+    ivec2 brush_tile = ivec2(x_pos / width, y_pos / height);
+    ivec2 brush_location = ivec2(x_pos - brush_tile.x * width, y_pos - brush_tile.y * height);
+    int brushed = brush_enabled * int(brush_tile == tile);
+    int ratio = int(min(1.0, pow(brush_radius, 2) / (pow(location.x - brush_location.x, 2) + pow(location.y - brush_location.y, 2))));
+
+    float luminosity = (1 - brushed * ratio) * (u0 + du_dt * m.dt * pause) + (brushed * ratio * brush_value);
+    imageStore(u, ivec3(location, member), vec4(luminosity));
+    imageStore(v, ivec3(location, member), vec4(v0 + dv_dt * m.dt * pause));
+
+    if (!render_image) return;
+
+    ivec2 pixel = tile * ivec2(width, height) + location;
+    if (visible_layer == 0) {
+        imageStore(imgOutput, pixel, vec4(cmap(min(1.0, abs(luminosity * 2.0))), 1.0));
+    } else if (visible_layer == 1) {
+        imageStore(imgOutput, pixel, vec4(cmap(min(1.0, abs((v0 + dv_dt * m.dt * pause) * 2.0))), 1.0));
+    }
+}
\ No newline at end of file
@@ -1,8 +1,9 @@
 #version 460 core
 
 layout (local_size_x = 1, local_size_y = 1, local_size_z = 1) in;
-layout (rgba32f, binding = 0) uniform image2D imgOutput;
+layout (rgba8, binding = 0) uniform image2D imgOutput;
 layout (r32f, binding = 1) uniform image2D u;
+layout (r32f, binding = 2) uniform image2DArray rates; // Written instead of a step when derivative is set, see RungeKutta
 
 // Dimensions of the grids
 uniform int width;
@@ -10,9 +11,11 @@ uniform int height;
 
 // PDE settings
 uniform bool paused;
+uniform bool render_image;
 uniform int boundary_condition;
 uniform float dx;
 uniform float dt;
+uniform bool derivative; // True to only write the time derivative of u into rates, for the Runge-Kutta integrators
 
 // Brush settings
 uniform int brush_enabled;
@@ -20,8 +23,14 @@ uniform int x_pos;
 uniform int y_pos;
 uniform int brush_radius;
 
-// Heat Equation specific settings
+// Heat Equation specific settings, either uniform or sampled per cell when compiled with FIELD_diffusion
+#ifdef FIELD_diffusion
+uniform sampler2D diffusion_field;
+float alpha_at(int x, int y) { return texelFetch(diffusion_field, ivec2(x, y), 0).r; }
+#else
 uniform float alpha;
+float alpha_at(int x, int y) { return alpha; }
+#endif
 
 // Color Map Poly 6 Coefficients
 uniform vec3 c0, c1, c2, c3, c4, c5, c6;
@@ -31,11 +40,48 @@ vec3 cmap(float t) {
     return c0+t*(c1+t*(c2+t*(c3+t*(c4+t*(c5+t*c6)))));
 }
 
-// Performs the remainder operation
+// Performs the remainder operation, % is undefined for negative operands in GLSL
 int fmod(int x, int y) {
-    return (x % y + y) % y;
+    return x - y * int(floor(float(x) / float(y)));
 }
 
+#ifdef STENCIL_ORDER
+// Wider stencils, compiled in with STENCIL_ORDER 4 or 6, see Grid::set_stencil_order. Coefficients of the centered second
+// difference from the center outwards, HALO cells on either side.
+#if STENCIL_ORDER == 6
+const int HALO = 3;
+const float SECOND[4] = float[](-49.0 / 18.0, 3.0 / 2.0, -3.0 / 20.0, 1.0 / 90.0);
+#else
+const int HALO = 2;
+const float SECOND[4] = float[](-5.0 / 2.0, 4.0 / 3.0, -1.0 / 12.0, 0.0);
+#endif
+
+// Index the wide stencils read in place of index i along an axis of n cells, and the sign of the value there. Neumann edges
+// mirror the cells inside, Dirichlet edges mirror them with the opposite sign around the first ghost cell, which stays 0.
+ivec2 mirror(int i, int n) {
+    if (i >= 0 && i < n) return ivec2(i, 1);
+    if (boundary_condition == 2) return ivec2(fmod(i, n), 1);
+    if (boundary_condition == 1) return ivec2(clamp(i < 0 ? -1 - i : 2 * n - 1 - i, 0, n - 1), 1);
+    if (i == -1 || i == n) return ivec2(0, 0);
+    return ivec2(clamp(i < 0 ? -2 - i : 2 * n - i, 0, n - 1), -1);
+}
+
+// Value of u for the wide stencils, see mirror
+float wide_value(int x, int y) {
+    ivec2 column = mirror(x, width), row = mirror(y, height);
+    ivec2 cell = ivec2(column.x, row.x);
+    return float(column.y * row.y) * imageLoad(u, cell).r;
+}
+
+// Laplacian of u with the wide stencil
+float wide_laplacian(int x, int y) {
+    float sum = 2.0 * SECOND[0] * wide_value(x, y);
+    for (int k = 1; k <= HALO; k++)
+        sum += SECOND[k] * (wide_value(x-k, y) + wide_value(x+k, y) + wide_value(x, y-k) + wide_value(x, y+k));
+    return sum / (dx * dx);
+}
+#endif
+
 // Accesses the value of the grid at a coordinate while respecting value-based boundary conditions
 float U(int x, int y) {
     if (x < 0 || x >= width || y < 0 || y >= height) {
@@ -51,6 +97,9 @@ float U(int x, int y) {
 
 // Computes the temporal derivative at a coordinate points in the grid
 float du_dt(int x, int y) {
+#ifdef STENCIL_ORDER
+    return alpha_at(x, y) * wide_laplacian(x, y);
+#else
     float du_dx_0 = (U(x, y) - U(x-1, y)) / dx;
     float du_dx_1 = (U(x+1, y) - U(x, y)) / dx;
 
@@ -67,11 +116,16 @@ float du_dt(int x, int y) {
     float d2u_dx2 = (du_dx_1 - du_dx_0) / dx;
     float d2u_dy2 = (du_dy_1 - du_dy_0) / dx;
 
-    return alpha * (d2u_dx2 + d2u_dy2);
+    return alpha_at(x, y) * (d2u_dx2 + d2u_dy2);
+#endif
 }
 
 void main() {
     ivec2 location = ivec2(gl_GlobalInvocationID.xy);
+    if (derivative) {
+        imageStore(rates, ivec3(location, 0), vec4(du_dt(location.x, location.y)));
+        return;
+    }
 
     int ratio = int(min(1.0, pow(brush_radius, 2) / (pow(location.x - x_pos, 2) + pow(location.y - y_pos, 2))));
     float du_dt = du_dt(location.x, location.y);
@@ -81,5 +135,5 @@ void main() {
     // Avoid branching by using some clever mathematical manipulation
     float luminosity = (1 - brush_enabled * ratio) * (U(location.x, location.y) + du_dt * dt * pause) + (brush_enabled * ratio * brush_value);
     imageStore(u, location, vec4(luminosity, 0.0, 0.0, 0.0));
-    imageStore(imgOutput, location, vec4(cmap(min(1.0, abs(luminosity))), 1.0));
+    if (render_image) imageStore(imgOutput, location, vec4(cmap(min(1.0, abs(luminosity))), 1.0));
 }
\ No newline at end of file
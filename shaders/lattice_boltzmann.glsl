@@ -0,0 +1,197 @@
+#version 460 core
+
+// Lattice Boltzmann fluid on a D2Q9 lattice with BGK collisions, in lattice units (dx = dt = 1).
+// The populations are streamed in place with the AA pattern, see LatticeBoltzmann in lattice_boltzmann.hpp.
+layout (local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+layout (rgba8, binding = 0) uniform image2D imgOutput;
+layout (r32f, binding = 1) uniform image2D u; // Velocity along x, derived from the populations every step
+layout (r32f, binding = 2) uniform image2D v; // Velocity along y
+layout (r32f, binding = 3) uniform image2D rho; // Density minus the rest density of 1
+layout (r32f, binding = 4) uniform image2D s; // Dye carried by the flow
+layout (r32f, binding = 5) uniform image2D s_next; // Dye after this step, written by PASS_DYE
+
+// Nine planes of width * height populations, one per lattice direction, so that neighbouring cells read neighbouring memory.
+// Each population is stored minus its weight (its value in fluid at rest), which keeps the small deviations that carry the flow
+// from being rounded away next to values close to 1.
+layout (std430, binding = 0) buffer Populations {
+    float f[];
+};
+
+// Passes, see LatticeBoltzmann::solve
+#define PASS_INITIALIZE 0
+#define PASS_STREAM_COLLIDE 1
+#define PASS_DYE 2
+
+uniform int pass;
+uniform bool odd; // Parity of the step, even steps collide in place and odd steps stream to and from the neighbours
+
+// Dimensions of the grids
+uniform int width;
+uniform int height;
+
+// PDE settings
+uniform bool paused;
+uniform bool render_image;
+uniform int boundary_condition; // Bounce-back walls, open boundaries fed by the inflow, or periodic
+uniform float tau; // Relaxation time, 3 * viscosity + 0.5
+uniform float inflow; // Velocity along x of the fluid entering through open boundaries
+uniform float diffusion; // Diffusivity of the dye
+
+// Brush settings
+uniform int brush_layer;
+uniform int brush_enabled;
+uniform int x_pos;
+uniform int y_pos;
+uniform int prev_x_pos;
+uniform int prev_y_pos;
+uniform int brush_radius;
+uniform int visible_layer;
+
+// Color Map Poly 6 Coefficients
+uniform vec3 c0, c1, c2, c3, c4, c5, c6;
+
+// 6th Order Polynomial Approximation for Matplotlib Color Maps
+vec3 cmap(float t) {
+    return c0+t*(c1+t*(c2+t*(c3+t*(c4+t*(c5+t*c6)))));
+}
+
+// Lattice directions, their weights and the index of the opposite direction
+const ivec2 c[9] = ivec2[](ivec2(0, 0), ivec2(1, 0), ivec2(0, 1), ivec2(-1, 0), ivec2(0, -1), ivec2(1, 1), ivec2(-1, 1), ivec2(-1, -1), ivec2(1, -1));
+const float weight[9] = float[](4.0/9.0, 1.0/9.0, 1.0/9.0, 1.0/9.0, 1.0/9.0, 1.0/36.0, 1.0/36.0, 1.0/36.0, 1.0/36.0);
+const int opposite[9] = int[](0, 3, 4, 1, 2, 7, 8, 5, 6);
+
+// Lattice velocities stay well below the speed of sound (about 0.58), a speed of 0.1 is shown at the top of the color map
+const float speed_scale = 10.0;
+
+// Wraps an index at most one period outside the grid, % is undefined for negative operands in GLSL
+int wrap(int x, int y) {
+    return (x + y) % y;
+}
+
+// Index of the population of a direction at a cell
+int slot(ivec2 cell, int i) {
+    return i * width * height + cell.y * width + cell.x;
+}
+
+// Neighbour of a cell, wrapped around periodic grids
+ivec2 neighbour(ivec2 cell, ivec2 offset) {
+    ivec2 n = cell + offset;
+    if (boundary_condition == 2) n = ivec2(wrap(n.x, width), wrap(n.y, height));
+    return n;
+}
+
+bool outside(ivec2 cell) {
+    return cell.x < 0 || cell.x >= width || cell.y < 0 || cell.y >= height;
+}
+
+// Second order equilibrium population of a direction minus its weight, for a density of 1 + excess
+float equilibrium(int i, float excess, vec2 velocity) {
+    float cu = 3.0 * dot(vec2(c[i]), velocity);
+    return weight[i] * (excess + (1.0 + excess) * (cu + 0.5 * cu * cu - 1.5 * dot(velocity, velocity)));
+}
+
+// Accesses the dye while respecting value-based boundary conditions, walls and open boundaries let no dye diffuse through
+float S(int x, int y) {
+    if (boundary_condition == 2) return imageLoad(s, ivec2(wrap(x, width), wrap(y, height))).r;
+    return imageLoad(s, ivec2(clamp(x, 0, width-1), clamp(y, 0, height-1))).r;
+}
+
+// Fraction of the brush covering a cell, 1 inside the radius around a point and 0 outside
+float brush_ratio(ivec2 location, int x, int y) {
+    return float(int(min(1.0, pow(brush_radius, 2) / (pow(location.x - x, 2) + pow(location.y - y, 2)))));
+}
+
+void main() {
+    ivec2 location = ivec2(gl_GlobalInvocationID.xy);
+    if (location.x >= width || location.y >= height) return;
+    vec2 reservoir = vec2(inflow, 0.0);
+
+    if (pass == PASS_INITIALIZE) {
+        // Every cell starts at the equilibrium of its layers, in the layout an even step reads
+        vec2 velocity = vec2(imageLoad(u, location).r, imageLoad(v, location).r);
+        for (int i = 0; i < 9; i++) f[slot(location, i)] = equilibrium(i, imageLoad(rho, location).r, velocity);
+    } else if (pass == PASS_STREAM_COLLIDE) {
+        // Even steps read the populations that arrived at the cell from its own slots.
+        // Odd steps gather them from the neighbours, where the previous even step left them in the opposite slots.
+        float populations[9];
+        for (int i = 0; i < 9; i++) {
+            if (!odd) {
+                populations[i] = f[slot(location, i)];
+                continue;
+            }
+            ivec2 from = neighbour(location, -c[i]);
+            if (!outside(from)) populations[i] = f[slot(from, opposite[i])];
+            else if (boundary_condition == 0) populations[i] = f[slot(location, i)]; // Bounced back from the wall during the even step
+            else populations[i] = equilibrium(i, 0.0, reservoir);
+        }
+
+        float excess = 0.0;
+        vec2 momentum = vec2(0.0);
+        for (int i = 0; i < 9; i++) {
+            excess += populations[i];
+            momentum += populations[i] * vec2(c[i]);
+        }
+        float density = 1.0 + excess;
+        vec2 velocity = momentum / density;
+
+        // The velocity brush imposes a velocity, the force brush shifts the velocity the populations relax towards
+        vec2 relaxed = velocity;
+        float omega = 1.0 / tau;
+        if (brush_enabled == 1 && brush_layer < 2 && prev_x_pos >= 0 && prev_y_pos >= 0 && !(prev_x_pos == x_pos || prev_y_pos == y_pos)) {
+            float ratio = brush_ratio(location, prev_x_pos, prev_y_pos);
+            vec2 direction = normalize(vec2(float(x_pos - prev_x_pos), float(y_pos - prev_y_pos)));
+            if (brush_layer == 0 && ratio > 0.0) {
+                velocity = relaxed = 0.1 * direction;
+                omega = 1.0;
+            } else {
+                relaxed += ratio * 0.001 * tau * direction / density;
+            }
+        }
+
+        imageStore(u, location, vec4(velocity.x));
+        imageStore(v, location, vec4(velocity.y));
+        imageStore(rho, location, vec4(excess));
+
+        // Collides, then stores every population where the next step expects it: even steps in the opposite slot of the cell,
+        // odd steps in the neighbour it streams to. Populations leaving through a wall bounce back into the cell.
+        for (int i = 0; i < 9; i++) {
+            float collided = populations[i] + omega * (equilibrium(i, excess, relaxed) - populations[i]);
+            if (!odd) {
+                f[slot(location, opposite[i])] = collided;
+                continue;
+            }
+            ivec2 to = neighbour(location, c[i]);
+            if (!outside(to)) f[slot(to, i)] = collided;
+            else if (boundary_condition == 0) f[slot(location, opposite[i])] = collided;
+            else f[slot(location, opposite[i])] = equilibrium(opposite[i], 0.0, reservoir);
+        }
+    } else if (pass == PASS_DYE) {
+        // Upwind advection and diffusion of the dye, the lattice velocity is below one cell per step
+        int x = location.x, y = location.y;
+        vec2 velocity = vec2(imageLoad(u, location).r, imageLoad(v, location).r);
+        float dye = S(x, y);
+        float ds_dx = velocity.x > 0.0 ? dye - S(x-1, y) : S(x+1, y) - dye;
+        float ds_dy = velocity.y > 0.0 ? dye - S(x, y-1) : S(x, y+1) - dye;
+        float laplacian = S(x-1, y) + S(x+1, y) + S(x, y-1) + S(x, y+1) - 4.0 * dye;
+        if (!paused) dye += diffusion * laplacian - velocity.x * ds_dx - velocity.y * ds_dy;
+        if (brush_layer == 2) {
+            float ratio = brush_enabled * brush_ratio(location, x_pos, y_pos);
+            dye = (1.0 - ratio) * dye + ratio;
+        }
+        imageStore(s_next, location, vec4(dye));
+
+        if (!render_image) return;
+
+        if (visible_layer == 0) {
+            imageStore(imgOutput, location, vec4(cmap(min(1.0, abs(velocity.x) * speed_scale)), 1.0));
+        } else if (visible_layer == 1) {
+            imageStore(imgOutput, location, vec4(cmap(min(1.0, abs(velocity.y) * speed_scale)), 1.0));
+        } else if (visible_layer == 2) {
+            imageStore(imgOutput, location, vec4(cmap(min(1.0, length(velocity) * speed_scale)), 1.0));
+        } else if (visible_layer == 3) {
+            imageStore(imgOutput, location, vec4(cmap(min(1.0, abs(dye))), 1.0));
+        } else if (visible_layer == 4) {
+            imageStore(imgOutput, location, vec4(cmap(clamp(0.5 + 50.0 * imageLoad(rho, location).r, 0.0, 1.0)), 1.0));
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,123 @@
+#version 460 core
+
+// Passes of a geometric multigrid solver for identity * u - scale * k * laplacian(u) = f on cell-centered grids
+layout (local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+layout (r32f, binding = 1) uniform image2D u; // Solution (or correction on coarse levels) of the current level
+layout (r32f, binding = 2) uniform image2D f; // Right hand side of the current level
+layout (r32f, binding = 3) uniform image2D r; // Residual of the current level
+layout (r32f, binding = 4) uniform image2D k; // Per-cell coefficient of the laplacian on the current level
+layout (r32f, binding = 5) uniform image2D coarse; // The next coarser level, written by restriction and read by prolongation
+
+// Passes, see Multigrid in multigrid.cpp
+#define PASS_SMOOTH 0
+#define PASS_RESIDUAL 1
+#define PASS_RESTRICT_RESIDUAL 2
+#define PASS_RESTRICT_COEFFICIENT 3
+#define PASS_PROLONG 4
+#define PASS_EVALUATE 5
+
+uniform int pass;
+uniform int parity; // Color of the cells updated by a red-black smoothing sweep
+
+// Dimensions of the current level and the next coarser one
+uniform int width;
+uniform int height;
+uniform int coarse_width;
+uniform int coarse_height;
+
+// Operator settings
+uniform int boundary_condition;
+uniform float dx;
+uniform float identity;
+uniform float scale;
+
+// Wraps an index at most one period outside the grid, % is undefined for negative operands in GLSL
+int wrap(int x, int y) {
+    return (x + y) % y;
+}
+
+// Accesses the current level while respecting value-based boundary conditions
+float U(int x, int y) {
+    if (x < 0 || x >= width || y < 0 || y >= height) {
+        if (boundary_condition == 2) { // Periodic Boundary Condition
+            return imageLoad(u, ivec2(wrap(x, width), wrap(y, height))).r;
+        } else if (boundary_condition == 1) { // Neumann Boundary Condition, the ghost cell mirrors its neighbour
+            return imageLoad(u, ivec2(clamp(x, 0, width-1), clamp(y, 0, height-1))).r;
+        } else { // Dirichlet Boundary Condition
+            return 0.0;
+        }
+    }
+
+    return imageLoad(u, ivec2(x, y)).r;
+}
+
+// Accesses the next coarser level with the same boundary conditions
+float C(int x, int y) {
+    if (x < 0 || x >= coarse_width || y < 0 || y >= coarse_height) {
+        if (boundary_condition == 2) {
+            return imageLoad(coarse, ivec2(wrap(x, coarse_width), wrap(y, coarse_height))).r;
+        } else if (boundary_condition == 1) {
+            return imageLoad(coarse, ivec2(clamp(x, 0, coarse_width-1), clamp(y, 0, coarse_height-1))).r;
+        } else {
+            return 0.0;
+        }
+    }
+
+    return imageLoad(coarse, ivec2(x, y)).r;
+}
+
+// Applies the operator at a cell
+float apply(int x, int y) {
+    float laplacian = (U(x-1, y) + U(x+1, y) + U(x, y-1) + U(x, y+1) - 4.0 * U(x, y)) / (dx * dx);
+    return identity * U(x, y) - scale * imageLoad(k, ivec2(x, y)).r * laplacian;
+}
+
+void main() {
+    ivec2 location = ivec2(gl_GlobalInvocationID.xy);
+    int x = location.x, y = location.y;
+
+    if (pass == PASS_RESTRICT_RESIDUAL || pass == PASS_RESTRICT_COEFFICIENT) {
+        // Every coarse cell averages the (up to) four fine cells it covers
+        if (x >= coarse_width || y >= coarse_height) return;
+        float sum = 0.0;
+        int count = 0;
+        for (int fy = 2*y; fy < min(2*y + 2, height); fy++) {
+            for (int fx = 2*x; fx < min(2*x + 2, width); fx++) {
+                sum += pass == PASS_RESTRICT_RESIDUAL ? imageLoad(r, ivec2(fx, fy)).r : imageLoad(k, ivec2(fx, fy)).r;
+                count++;
+            }
+        }
+        imageStore(coarse, location, vec4(sum / float(count)));
+        return;
+    }
+
+    if (x >= width || y >= height) return;
+
+    if (pass == PASS_SMOOTH) {
+        // Gauss-Seidel update of one color, Neumann ghost cells equal the cell itself and move to the diagonal
+        if ((x + y) % 2 != parity) return;
+        float coefficient = scale * imageLoad(k, location).r / (dx * dx);
+        float sum = 0.0;
+        float diagonal = identity + 4.0 * coefficient;
+        ivec2 offsets[4] = ivec2[](ivec2(-1, 0), ivec2(1, 0), ivec2(0, -1), ivec2(0, 1));
+        for (int i = 0; i < 4; i++) {
+            ivec2 n = location + offsets[i];
+            bool outside = n.x < 0 || n.x >= width || n.y < 0 || n.y >= height;
+            if (outside && boundary_condition == 1) diagonal -= coefficient;
+            else sum += U(n.x, n.y);
+        }
+        if (diagonal != 0.0) imageStore(u, location, vec4((imageLoad(f, location).r + coefficient * sum) / diagonal));
+    } else if (pass == PASS_RESIDUAL) {
+        imageStore(r, location, vec4(imageLoad(f, location).r - apply(x, y)));
+    } else if (pass == PASS_PROLONG) {
+        // Bilinear interpolation between the four nearest coarse cell centers
+        int cx = (x + 1) / 2 - 1, cy = (y + 1) / 2 - 1;
+        float wx = x % 2 == 0 ? 0.75 : 0.25, wy = y % 2 == 0 ? 0.75 : 0.25;
+        float correction = mix(mix(C(cx, cy), C(cx+1, cy), wx), mix(C(cx, cy+1), C(cx+1, cy+1), wx), wy);
+        imageStore(u, location, vec4(imageLoad(u, location).r + correction));
+    } else if (pass == PASS_EVALUATE) {
+        // Writes identity * u + scale * k * laplacian(u) into f, e.g. the explicit half of a Crank-Nicolson step
+        float laplacian = (U(x-1, y) + U(x+1, y) + U(x, y-1) + U(x, y+1) - 4.0 * U(x, y)) / (dx * dx);
+        imageStore(f, location, vec4(identity * U(x, y) + scale * imageLoad(k, location).r * laplacian));
+    }
+}
\ No newline at end of file
@@ -1,11 +1,12 @@
 #version 460 core
 
 layout (local_size_x = 1, local_size_y = 1, local_size_z = 1) in;
-layout (rgba32f, binding = 0) uniform image2D imgOutput;
+layout (rgba8, binding = 0) uniform image2D imgOutput;
 layout (r32f, binding = 1) uniform image2D u;
 layout (r32f, binding = 2) uniform image2D v;
 layout (r32f, binding = 3) uniform image2D p;
 layout (r32f, binding = 4) uniform image2D s;
+layout (r32f, binding = 5) uniform image2DArray rates; // Written instead of a step when derivative is set, see RungeKutta
 
 // Dimensions of the grids
 uniform int width;
@@ -13,9 +14,15 @@ uniform int height;
 
 // PDE settings
 uniform bool paused;
+uniform bool render_image;
 uniform int boundary_condition;
 uniform float dx;
 uniform float dt;
+uniform bool projection; // True if the pressure is instead found by a projection after this pass, see projection.glsl
+uniform bool advected; // True if the velocity and dye were already advected before this pass, see advection.glsl
+uniform bool staggered; // True if the velocity and pressure were already advanced on the cell faces, see navier_stokes_mac.glsl
+uniform bool derivative; // True to only write the time derivative of every layer into rates, for the Runge-Kutta integrators
+uniform bool integrated; // True if every layer was already advanced by a Runge-Kutta integrator, this pass then only applies the brush
 
 // Brush settings
 uniform int brush_layer;
@@ -27,8 +34,14 @@ uniform int prev_y_pos;
 uniform int brush_radius;
 uniform int visible_layer;
 
-// Navier-Stokes Reaction Diffusion specific settings
+// Navier-Stokes Reaction Diffusion specific settings, either uniform or sampled per cell when compiled with FIELD_viscosity
+#ifdef FIELD_viscosity
+uniform sampler2D viscosity_field;
+float viscosity_at(int x, int y) { return texelFetch(viscosity_field, ivec2(x, y), 0).r; }
+#else
 uniform float viscosity;
+float viscosity_at(int x, int y) { return viscosity; }
+#endif
 
 // Color Map Poly 6 Coefficients
 uniform vec3 c0, c1, c2, c3, c4, c5, c6;
@@ -38,11 +51,58 @@ vec3 cmap(float t) {
     return c0+t*(c1+t*(c2+t*(c3+t*(c4+t*(c5+t*c6)))));
 }
 
-// Performs the remainder operation
+// Performs the remainder operation, % is undefined for negative operands in GLSL
 int fmod(int x, int y) {
-    return (x % y + y) % y;
+    return x - y * int(floor(float(x) / float(y)));
 }
 
+#ifdef STENCIL_ORDER
+// Wider stencils, compiled in with STENCIL_ORDER 4 or 6, see Grid::set_stencil_order. Coefficients of the centered second and
+// first differences from the center outwards, HALO cells on either side.
+#if STENCIL_ORDER == 6
+const int HALO = 3;
+const float SECOND[4] = float[](-49.0 / 18.0, 3.0 / 2.0, -3.0 / 20.0, 1.0 / 90.0);
+const float FIRST[4] = float[](0.0, 3.0 / 4.0, -3.0 / 20.0, 1.0 / 60.0);
+#else
+const int HALO = 2;
+const float SECOND[4] = float[](-5.0 / 2.0, 4.0 / 3.0, -1.0 / 12.0, 0.0);
+const float FIRST[4] = float[](0.0, 2.0 / 3.0, -1.0 / 12.0, 0.0);
+#endif
+
+// Index the wide stencils read in place of index i along an axis of n cells, and the sign of the value there. Neumann edges
+// mirror the cells inside, Dirichlet edges mirror them with the opposite sign around the first ghost cell, which stays 0.
+ivec2 mirror(int i, int n) {
+    if (i >= 0 && i < n) return ivec2(i, 1);
+    if (boundary_condition == 2) return ivec2(fmod(i, n), 1);
+    if (boundary_condition == 1) return ivec2(clamp(i < 0 ? -1 - i : 2 * n - 1 - i, 0, n - 1), 1);
+    if (i == -1 || i == n) return ivec2(0, 0);
+    return ivec2(clamp(i < 0 ? -2 - i : 2 * n - i, 0, n - 1), -1);
+}
+
+// Value of layer 0 (u) or 1 (v) for the wide stencils, see mirror
+float wide_value(int layer, int x, int y) {
+    ivec2 column = mirror(x, width), row = mirror(y, height);
+    ivec2 cell = ivec2(column.x, row.x);
+    return float(column.y * row.y) * (layer == 0 ? imageLoad(u, cell).r : imageLoad(v, cell).r);
+}
+
+// Laplacian of a layer with the wide stencil
+float wide_laplacian(int layer, int x, int y) {
+    float sum = 2.0 * SECOND[0] * wide_value(layer, x, y);
+    for (int k = 1; k <= HALO; k++)
+        sum += SECOND[k] * (wide_value(layer, x-k, y) + wide_value(layer, x+k, y) + wide_value(layer, x, y-k) + wide_value(layer, x, y+k));
+    return sum / (dx * dx);
+}
+
+// Centered gradient of a layer with the wide stencil
+vec2 wide_gradient(int layer, int x, int y) {
+    vec2 sum = vec2(0.0);
+    for (int k = 1; k <= HALO; k++)
+        sum += FIRST[k] * vec2(wide_value(layer, x+k, y) - wide_value(layer, x-k, y), wide_value(layer, x, y+k) - wide_value(layer, x, y-k));
+    return sum / dx;
+}
+#endif
+
 // Accesses the value of the U grid at a coordinate while respecting value-based boundary conditions
 float U(int x, int y) {
     if (x < 0 || x >= width || y < 0 || y >= height) {
@@ -123,7 +183,19 @@ float du_dt(int x, int y) {
     float d2u_dx2 = (du_dx_1 - du_dx_0) / dx;
     float d2u_dy2 = (du_dy_1 - du_dy_0) / dx;
 
-    return viscosity * (d2u_dx2 + d2u_dy2) - (U(x, y) * (du_dx_0 + du_dx_1) * 0.5 + V(x, y) * (du_dy_0 + du_dy_1) * 0.5) - dp_dx;
+    if (projection) dp_dx = 0.0;
+
+    float laplacian = d2u_dx2 + d2u_dy2;
+    float advection = advected ? 0.0 : U(x, y) * (du_dx_0 + du_dx_1) * 0.5 + V(x, y) * (du_dy_0 + du_dy_1) * 0.5;
+#ifdef STENCIL_ORDER
+    // The wide stencils only replace the derivatives of the velocity, the pressure keeps the compact differences the
+    // projections are built on
+    vec2 gradient = wide_gradient(0, x, y);
+    laplacian = wide_laplacian(0, x, y);
+    if (!advected) advection = U(x, y) * gradient.x + V(x, y) * gradient.y;
+#endif
+
+    return viscosity_at(x, y) * laplacian - advection - dp_dx;
 }
 
 // Computes the temporal derivative at a coordinate point in the V grid
@@ -154,7 +226,17 @@ float dv_dt(int x, int y) {
     float d2v_dx2 = (dv_dx_1 - dv_dx_0) / dx;
     float d2v_dy2 = (dv_dy_1 - dv_dy_0) / dx;
 
-    return viscosity * (d2v_dx2 + d2v_dy2) - (U(x, y) * (dv_dx_0 + dv_dx_1) * 0.5 + V(x, y) * (dv_dx_0 + dv_dy_1) * 0.5) - dp_dy;
+    if (projection) dp_dy = 0.0;
+
+    float laplacian = d2v_dx2 + d2v_dy2;
+    float advection = advected ? 0.0 : U(x, y) * (dv_dx_0 + dv_dx_1) * 0.5 + V(x, y) * (dv_dx_0 + dv_dy_1) * 0.5;
+#ifdef STENCIL_ORDER
+    vec2 gradient = wide_gradient(1, x, y);
+    laplacian = wide_laplacian(1, x, y);
+    if (!advected) advection = U(x, y) * gradient.x + V(x, y) * gradient.y;
+#endif
+
+    return viscosity_at(x, y) * laplacian - advection - dp_dy;
 }
 
 // Computes the temporal derivative at a coordinate point in the P grid
@@ -190,7 +272,7 @@ float dp_dt(int x, int y) {
     float d2p_dy2 = (dp_dy_1 - dp_dy_0) / dx;
     float M = 0.5;
 
-    return viscosity * (d2p_dx2 + d2p_dy2) - (1.0 / (M * M)) * (du_dx + dv_dy);
+    return viscosity_at(x, y) * (d2p_dx2 + d2p_dy2) - (1.0 / (M * M)) * (du_dx + dv_dy);
 }
 
 // Computes the temporal derivative at a coordinate point in the S grid
@@ -207,21 +289,35 @@ float ds_dt(int x, int y) {
     float d2s_dx2 = (ds_dx_1 - ds_dx_0) / dx;
     float d2s_dy2 = (ds_dy_1 - ds_dy_0) / dx;
 
-    return 0.2 * (d2s_dx2 + d2s_dy2) - (U(x, y) * ds_dx + V(x, y) * ds_dy);
+    float advection = advected ? 0.0 : U(x, y) * ds_dx + V(x, y) * ds_dy;
+
+    return 0.2 * (d2s_dx2 + d2s_dy2) - advection;
 }
 
 void main() {
     ivec2 location = ivec2(gl_GlobalInvocationID.xy);
+    if (derivative) {
+        imageStore(rates, ivec3(location, 0), vec4(du_dt(location.x, location.y)));
+        imageStore(rates, ivec3(location, 1), vec4(dv_dt(location.x, location.y)));
+        imageStore(rates, ivec3(location, 2), vec4(projection ? 0.0 : dp_dt(location.x, location.y)));
+        imageStore(rates, ivec3(location, 3), vec4(ds_dt(location.x, location.y)));
+        return;
+    }
+
     int ratio = int(min(1.0, pow(brush_radius, 2) / (pow(location.x - x_pos, 2) + pow(location.y - y_pos, 2))));
     int pause = paused ? 0 : 1;
     float brush_value = 1.0f;
 
-    float du_dt = du_dt(location.x, location.y);
-    float dv_dt = dv_dt(location.x, location.y);
-    float dp_dt = dp_dt(location.x, location.y);
-    float ds_dt = ds_dt(location.x, location.y);
+    float du_dt = integrated ? 0.0 : du_dt(location.x, location.y);
+    float dv_dt = integrated ? 0.0 : dv_dt(location.x, location.y);
+    float dp_dt = projection || integrated ? 0.0 : dp_dt(location.x, location.y);
+    float ds_dt = integrated ? 0.0 : ds_dt(location.x, location.y);
 
-    if (brush_layer == 0) {
+    if (staggered) {
+        float dye = S(location.x, location.y) + ds_dt * dt * pause;
+        if (brush_layer == 2) dye = (1 - brush_enabled * ratio) * dye + brush_enabled * ratio * brush_value;
+        imageStore(s, location, vec4(dye));
+    } else if (brush_layer == 0) {
         if (brush_enabled == 1 && prev_x_pos >= 0 && prev_y_pos >= 0 && !(prev_x_pos == x_pos || prev_y_pos == y_pos)) {
             int ratio = int(min(1.0, pow(brush_radius, 2) / (pow(location.x - prev_x_pos, 2) + pow(location.y - prev_y_pos, 2))));
             vec2 normal = 2.0 * normalize(vec2(float(x_pos - prev_x_pos), float(y_pos - prev_y_pos))); // Double it to give it some more strength
@@ -259,6 +355,8 @@ void main() {
     }
 
 
+    if (!render_image) return;
+
     if (visible_layer == 0) {
         imageStore(imgOutput, location, vec4(cmap(min(1.0, abs(U(location.x, location.y)))), 1.0));
     } else if (visible_layer == 1) {
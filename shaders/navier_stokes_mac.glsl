@@ -0,0 +1,193 @@
+#version 460 core
+
+// Navier-Stokes on a staggered (MAC) grid: the velocity along x lives on the vertical cell faces and the velocity along y on the horizontal ones.
+// Divergence and pressure gradient then couple neighbouring cells directly, so the projection leaves no checkerboard modes behind.
+layout (local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+layout (r32f, binding = 1) uniform image2D u_out; // (width+1) x height faces, or the cell centered layer for PASS_TO_CENTERS
+layout (r32f, binding = 2) uniform image2D v_out; // width x (height+1) faces, or the cell centered layer for PASS_TO_CENTERS
+layout (r32f, binding = 5) uniform image2D rhs; // Right hand side of the pressure equation, the finest level of the multigrid solver
+
+// Inputs of the pass, read with texelFetch
+uniform sampler2D u_in; // Faces, or the cell centered layer for PASS_TO_FACES
+uniform sampler2D v_in; // Faces, or the cell centered layer for PASS_TO_FACES
+uniform sampler2D p_in; // Pressure at the cell centers
+
+// Passes, see NavierStokes::step_staggered
+#define PASS_TO_FACES 0
+#define PASS_MOMENTUM 1
+#define PASS_DIVERGENCE 2
+#define PASS_PROJECT 3
+#define PASS_TO_CENTERS 4
+
+uniform int pass;
+
+// Dimensions of the grids, in cells
+uniform int width;
+uniform int height;
+
+// PDE settings
+uniform bool paused;
+uniform int boundary_condition;
+uniform float dx;
+uniform float dt;
+uniform bool semi_lagrangian; // True to advect the velocity along its characteristics instead of with centered differences
+
+// Brush settings
+uniform int brush_layer;
+uniform int brush_enabled;
+uniform int x_pos;
+uniform int y_pos;
+uniform int prev_x_pos;
+uniform int prev_y_pos;
+uniform int brush_radius;
+
+// Navier-Stokes specific settings, either uniform or sampled per cell when compiled with FIELD_viscosity
+#ifdef FIELD_viscosity
+uniform sampler2D viscosity_field;
+float viscosity_at(int x, int y) { return texelFetch(viscosity_field, ivec2(x, y), 0).r; }
+#else
+uniform float viscosity;
+float viscosity_at(int x, int y) { return viscosity; }
+#endif
+
+// Wraps an index at most one period outside the grid, % is undefined for negative operands in GLSL
+int wrap(int x, int y) {
+    return (x + y) % y;
+}
+
+// Accesses a cell centered input while respecting value-based boundary conditions
+float center(sampler2D field, int x, int y) {
+    if (boundary_condition == 2) return texelFetch(field, ivec2(wrap(x, width), wrap(y, height)), 0).r;
+    return texelFetch(field, ivec2(clamp(x, 0, width-1), clamp(y, 0, height-1)), 0).r;
+}
+
+// Accesses the velocity along x on face i of row j, between cells i-1 and i.
+// Ghost rows mirror it along walls (no slip) and copy it at open boundaries, periodic faces repeat every width faces.
+float U(int i, int j) {
+    if (boundary_condition == 2) return texelFetch(u_in, ivec2(wrap(i, width), wrap(j, height)), 0).r;
+    float value = texelFetch(u_in, ivec2(clamp(i, 0, width), clamp(j, 0, height-1)), 0).r;
+    if ((j < 0 || j >= height) && boundary_condition == 0) return -value;
+    return value;
+}
+
+// Accesses the velocity along y on face j of column i, between cells j-1 and j, like U
+float V(int i, int j) {
+    if (boundary_condition == 2) return texelFetch(v_in, ivec2(wrap(i, width), wrap(j, height)), 0).r;
+    float value = texelFetch(v_in, ivec2(clamp(i, 0, width-1), clamp(j, 0, height)), 0).r;
+    if ((i < 0 || i >= width) && boundary_condition == 0) return -value;
+    return value;
+}
+
+// Accesses the pressure with the boundary conditions of the multigrid solve: zero gradient at walls, zero at open boundaries
+float P(int x, int y) {
+    if (x < 0 || x >= width || y < 0 || y >= height) {
+        if (boundary_condition == 2) return texelFetch(p_in, ivec2(wrap(x, width), wrap(y, height)), 0).r;
+        if (boundary_condition == 1) return 0.0;
+        return texelFetch(p_in, ivec2(clamp(x, 0, width-1), clamp(y, 0, height-1)), 0).r;
+    }
+    return texelFetch(p_in, ivec2(x, y), 0).r;
+}
+
+// Whether a boundary face has its velocity fixed at 0, walls let no fluid through
+bool fixed_face(int i, int faces) {
+    return boundary_condition == 0 && (i == 0 || i == faces);
+}
+
+// Keeps a position in cells, with cell centers on integers, inside the domain or wraps it around a periodic one
+vec2 inside(vec2 position) {
+    if (boundary_condition == 2) return mod(position + 0.5, vec2(width, height)) - 0.5;
+    return clamp(position, vec2(-0.5), vec2(width, height) - 0.5);
+}
+
+// Bilinearly interpolates the velocity along x at a position in cells
+float sample_u(vec2 position) {
+    vec2 face = inside(position) + vec2(0.5, 0.0);
+    ivec2 i = ivec2(floor(face));
+    vec2 t = face - vec2(i);
+    return mix(mix(U(i.x, i.y), U(i.x+1, i.y), t.x), mix(U(i.x, i.y+1), U(i.x+1, i.y+1), t.x), t.y);
+}
+
+// Bilinearly interpolates the velocity along y at a position in cells
+float sample_v(vec2 position) {
+    vec2 face = inside(position) + vec2(0.0, 0.5);
+    ivec2 i = ivec2(floor(face));
+    vec2 t = face - vec2(i);
+    return mix(mix(V(i.x, i.y), V(i.x+1, i.y), t.x), mix(V(i.x, i.y+1), V(i.x+1, i.y+1), t.x), t.y);
+}
+
+// Follows the velocity back through a position for dt with a midpoint step
+vec2 trace(vec2 position) {
+    vec2 velocity = vec2(sample_u(position), sample_v(position));
+    vec2 midpoint = position - 0.5 * dt * velocity / dx;
+    velocity = vec2(sample_u(midpoint), sample_v(midpoint));
+    return position - dt * velocity / dx;
+}
+
+// Advances the velocity on a face by one step, component 0 for a face of U and 1 for a face of V, including the brush
+float momentum(int x, int y, int component) {
+    ivec2 along = component == 0 ? ivec2(1, 0) : ivec2(0, 1);
+    vec2 position = vec2(x, y) - 0.5 * vec2(along);
+    float pause = paused ? 0.0 : 1.0;
+
+    float value, laplacian, advection;
+    if (component == 0) {
+        value = U(x, y);
+        laplacian = (U(x-1, y) + U(x+1, y) + U(x, y-1) + U(x, y+1) - 4.0 * value) / (dx * dx);
+        float v = 0.25 * (V(x-1, y) + V(x, y) + V(x-1, y+1) + V(x, y+1));
+        advection = value * (U(x+1, y) - U(x-1, y)) / (2.0 * dx) + v * (U(x, y+1) - U(x, y-1)) / (2.0 * dx);
+    } else {
+        value = V(x, y);
+        laplacian = (V(x-1, y) + V(x+1, y) + V(x, y-1) + V(x, y+1) - 4.0 * value) / (dx * dx);
+        float u = 0.25 * (U(x, y-1) + U(x+1, y-1) + U(x, y) + U(x+1, y));
+        advection = u * (V(x+1, y) - V(x-1, y)) / (2.0 * dx) + value * (V(x, y+1) - V(x, y-1)) / (2.0 * dx);
+    }
+
+    // Semi-Lagrangian advection starts from the velocity where the characteristic through the face began
+    float start = value;
+    if (semi_lagrangian && !paused) {
+        vec2 back = trace(position);
+        start = component == 0 ? sample_u(back) : sample_v(back);
+        advection = 0.0;
+    }
+    float result = start + (viscosity_at(min(x, width-1), min(y, height-1)) * laplacian - advection) * dt * pause;
+
+    if (brush_enabled == 1 && brush_layer < 2 && prev_x_pos >= 0 && prev_y_pos >= 0 && !(prev_x_pos == x_pos || prev_y_pos == y_pos)) {
+        float ratio = float(int(min(1.0, pow(brush_radius, 2) / (pow(position.x - prev_x_pos, 2) + pow(position.y - prev_y_pos, 2)))));
+        vec2 direction = normalize(vec2(float(x_pos - prev_x_pos), float(y_pos - prev_y_pos)));
+        float stroke = component == 0 ? direction.x : direction.y;
+        if (brush_layer == 0) result = (1.0 - ratio) * result + ratio * 2.0 * stroke;
+        else result += ratio * 6.0 * stroke * dt * pause;
+    }
+    return result;
+}
+
+void main() {
+    ivec2 location = ivec2(gl_GlobalInvocationID.xy);
+    int x = location.x, y = location.y;
+    bool u_face = x <= width && y < height;
+    bool v_face = x < width && y <= height;
+    bool cell = x < width && y < height;
+
+    if (pass == PASS_TO_FACES) {
+        // Every face averages the two cells it separates
+        if (u_face) imageStore(u_out, location, vec4(fixed_face(x, width) ? 0.0 : 0.5 * (center(u_in, x-1, y) + center(u_in, x, y))));
+        if (v_face) imageStore(v_out, location, vec4(fixed_face(y, height) ? 0.0 : 0.5 * (center(v_in, x, y-1) + center(v_in, x, y))));
+    } else if (pass == PASS_MOMENTUM) {
+        if (u_face) imageStore(u_out, location, vec4(fixed_face(x, width) ? 0.0 : momentum(x, y, 0)));
+        if (v_face) imageStore(v_out, location, vec4(fixed_face(y, height) ? 0.0 : momentum(x, y, 1)));
+    } else if (pass == PASS_DIVERGENCE) {
+        if (!cell) return;
+        float divergence = (U(x+1, y) - U(x, y) + V(x, y+1) - V(x, y)) / dx;
+        imageStore(rhs, location, vec4(-divergence / dt));
+    } else if (pass == PASS_PROJECT) {
+        // Each face only sees the pressure difference of the two cells it separates
+        if (u_face && !fixed_face(x, width))
+            imageStore(u_out, location, vec4(imageLoad(u_out, location).r - dt * (P(x, y) - P(x-1, y)) / dx));
+        if (v_face && !fixed_face(y, height))
+            imageStore(v_out, location, vec4(imageLoad(v_out, location).r - dt * (P(x, y) - P(x, y-1)) / dx));
+    } else if (pass == PASS_TO_CENTERS) {
+        if (!cell) return;
+        imageStore(u_out, location, vec4(0.5 * (U(x, y) + U(x+1, y))));
+        imageStore(v_out, location, vec4(0.5 * (V(x, y) + V(x, y+1))));
+    }
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#version 460 core
+
+// Passes of the pressure projection for Navier-Stokes, the pressure itself is solved for with multigrid.glsl
+layout (local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+layout (r32f, binding = 1) uniform image2D u;
+layout (r32f, binding = 2) uniform image2D v;
+layout (r32f, binding = 3) uniform image2D p;
+layout (r32f, binding = 5) uniform image2D rhs; // Right hand side of the pressure equation, the finest level of the multigrid solver
+
+// Passes, see NavierStokes::project
+#define PASS_DIVERGENCE 0
+#define PASS_PROJECT 1
+
+uniform int pass;
+
+// Dimensions of the grids
+uniform int width;
+uniform int height;
+
+// PDE settings
+uniform int boundary_condition; // Of the velocity, walls (Dirichlet) and open boundaries (Neumann) set the pressure boundary
+uniform float dx;
+uniform float dt;
+
+// Wraps an index at most one period outside the grid, % is undefined for negative operands in GLSL
+int wrap(int x, int y) {
+    return (x + y) % y;
+}
+
+// Accesses the U grid, ghost cells of walls mirror the velocity so the normal velocity through the wall is 0
+float U(int x, int y, int inside_x, int inside_y) {
+    if (x < 0 || x >= width || y < 0 || y >= height) {
+        if (boundary_condition == 2) return imageLoad(u, ivec2(wrap(x, width), wrap(y, height))).r;
+        float inside = imageLoad(u, ivec2(inside_x, inside_y)).r;
+        return boundary_condition == 1 ? inside : -inside;
+    }
+    return imageLoad(u, ivec2(x, y)).r;
+}
+
+// Accesses the V grid like U
+float V(int x, int y, int inside_x, int inside_y) {
+    if (x < 0 || x >= width || y < 0 || y >= height) {
+        if (boundary_condition == 2) return imageLoad(v, ivec2(wrap(x, width), wrap(y, height))).r;
+        float inside = imageLoad(v, ivec2(inside_x, inside_y)).r;
+        return boundary_condition == 1 ? inside : -inside;
+    }
+    return imageLoad(v, ivec2(x, y)).r;
+}
+
+// Accesses the pressure with the boundary conditions of the multigrid solve: zero gradient at walls, zero at open boundaries
+float P(int x, int y) {
+    if (x < 0 || x >= width || y < 0 || y >= height) {
+        if (boundary_condition == 2) return imageLoad(p, ivec2(wrap(x, width), wrap(y, height))).r;
+        if (boundary_condition == 1) return 0.0;
+        return imageLoad(p, ivec2(clamp(x, 0, width-1), clamp(y, 0, height-1))).r;
+    }
+    return imageLoad(p, ivec2(x, y)).r;
+}
+
+void main() {
+    ivec2 location = ivec2(gl_GlobalInvocationID.xy);
+    int x = location.x, y = location.y;
+    if (x >= width || y >= height) return;
+
+    if (pass == PASS_DIVERGENCE) {
+        // Divergence from the velocities on the faces around the cell, so that it sums to 0 over a closed or periodic domain
+        float flux_x = (U(x+1, y, x, y) - U(x-1, y, x, y)) * 0.5;
+        float flux_y = (V(x, y+1, x, y) - V(x, y-1, x, y)) * 0.5;
+        float divergence = (flux_x + flux_y) / dx;
+        imageStore(rhs, location, vec4(-divergence / dt));
+    } else if (pass == PASS_PROJECT) {
+        // Subtracts the pressure gradient, which removes the divergent part of the velocity
+        float dp_dx = (P(x+1, y) - P(x-1, y)) / (2.0 * dx);
+        float dp_dy = (P(x, y+1) - P(x, y-1)) / (2.0 * dx);
+        imageStore(u, location, vec4(imageLoad(u, location).r - dt * dp_dx));
+        imageStore(v, location, vec4(imageLoad(v, location).r - dt * dp_dy));
+    }
+}
\ No newline at end of file
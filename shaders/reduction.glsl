@@ -0,0 +1,56 @@
+#version 460 core
+
+// Largest absolute value of a field, or the norms of its difference to a previous field, see Reduction in reduction.hpp
+layout (local_size_x = 16, local_size_y = 16, local_size_z = 1) in;
+layout (r32f, binding = 1) uniform image2D field;
+layout (r32f, binding = 2) uniform image2D previous; // Subtracted from the field when difference is set
+
+// Largest absolute value of every field reduced since the buffer was cleared
+layout (std430, binding = 0) buffer Maxima {
+    uint maxima[]; // Bits of the values, non-negative floats order like their bits
+};
+
+// Sum of the squared differences of every work group, written when difference is set
+layout (std430, binding = 1) buffer Sums {
+    float sums[];
+};
+
+// Dimensions of the field
+uniform int width;
+uniform int height;
+
+uniform int index; // Entry of maxima the field is reduced into
+uniform bool difference; // Whether to reduce the field minus previous and also sum its squares
+uniform int first_group; // Entry of sums written by the first work group
+
+shared float largest[256];
+shared float squares[256];
+
+void main() {
+    ivec2 location = ivec2(gl_GlobalInvocationID.xy);
+
+    float value = 0.0;
+    if (location.x < width && location.y < height) {
+        value = imageLoad(field, location).r;
+        if (difference) value -= imageLoad(previous, location).r;
+        value = abs(value);
+        if (isnan(value) || isinf(value)) value = 1e30;
+    }
+
+    // The largest value of the work group is found in shared memory and the largest of all work groups with an atomic,
+    // the squares are summed alongside and every work group writes its own sum
+    uint local = gl_LocalInvocationIndex;
+    largest[local] = value;
+    squares[local] = value * value;
+    for (uint half_size = 128; half_size > 0; half_size /= 2) {
+        barrier();
+        if (local < half_size) {
+            largest[local] = max(largest[local], largest[local + half_size]);
+            squares[local] += squares[local + half_size];
+        }
+    }
+    if (local == 0) {
+        atomicMax(maxima[index], floatBitsToUint(largest[0]));
+        if (difference) sums[first_group + gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x] = squares[0];
+    }
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#version 460 core
+
+layout (local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+layout (r32f, binding = 1) uniform writeonly image2D dst; // The layer at its new resolution
+
+uniform sampler2D src; // The layer at its old resolution, sampled with bilinear filtering
+uniform int filter_mode; // 0 for bilinear interpolation, 1 for a conservative area average
+
+void main() {
+    ivec2 location = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 dst_size = imageSize(dst);
+    if (location.x >= dst_size.x || location.y >= dst_size.y) return;
+
+    if (filter_mode == 0) {
+        vec2 uv = (vec2(location) + 0.5) / vec2(dst_size);
+        imageStore(dst, location, vec4(texture(src, uv).r));
+        return;
+    }
+
+    // Average every old cell weighted by how much of it overlaps the new cell, which preserves the integral of the field
+    ivec2 src_size = textureSize(src, 0);
+    vec2 scale = vec2(src_size) / vec2(dst_size);
+    vec2 start = vec2(location) * scale;
+    vec2 end = start + scale;
+
+    float sum = 0.0;
+    float area = 0.0;
+    for (int y = int(floor(start.y)); y < int(ceil(end.y)); y++) {
+        float wy = min(end.y, float(y + 1)) - max(start.y, float(y));
+        for (int x = int(floor(start.x)); x < int(ceil(end.x)); x++) {
+            float wx = min(end.x, float(x + 1)) - max(start.x, float(x));
+            sum += texelFetch(src, min(ivec2(x, y), src_size - 1), 0).r * wx * wy;
+            area += wx * wy;
+        }
+    }
+    imageStore(dst, location, vec4(sum / area));
+}
\ No newline at end of file
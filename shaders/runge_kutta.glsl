@@ -0,0 +1,62 @@
+#version 460 core
+
+// Passes of the explicit Runge-Kutta integrators, see RungeKutta in runge_kutta.hpp. Every dispatch works on one layer.
+// The rates may also be earlier stages, which the Runge-Kutta-Legendre recursion combines.
+layout (local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+layout (r32f, binding = 1) uniform image2D state; // The layer, written with the state of a stage or read as the next state
+layout (r32f, binding = 2) uniform image2DArray base; // Every layer at the start of the substep
+layout (binding = 0) uniform sampler2DArray rates[7]; // Time derivative of every layer at each stage
+
+// Largest scaled error of a substep, written by PASS_ERROR
+layout (std430, binding = 0) buffer Reduction {
+    uint largest_error; // Bits of the error, non-negative floats order like their bits
+};
+
+// Passes
+#define PASS_COMBINE 0
+#define PASS_ERROR 1
+
+uniform int pass;
+
+// Dimensions of the grids
+uniform int width;
+uniform int height;
+
+uniform int layer; // Slice of base and of the rates that belongs to the layer
+uniform int stages; // Number of rates to combine
+uniform float base_weight; // Coefficient of base in the combined state, 1 for Runge-Kutta stages
+uniform float weights[7]; // Size of the substep times the coefficient of each rate
+uniform float tolerance; // Largest error of a substep, see RungeKutta::tolerance
+
+shared float largest[64];
+
+void main() {
+    ivec2 location = ivec2(gl_GlobalInvocationID.xy);
+    bool inside = location.x < width && location.y < height;
+
+    float sum = 0.0;
+    if (inside) {
+        for (int j = 0; j < stages; j++) sum += weights[j] * texelFetch(rates[j], ivec3(location, layer), 0).r;
+    }
+
+    if (pass == PASS_COMBINE) {
+        if (inside) imageStore(state, location, vec4(base_weight * imageLoad(base, ivec3(location, layer)).r + sum));
+        return;
+    }
+
+    // PASS_ERROR: the sum is the difference to the embedded method, the largest scaled error of the work group is found in
+    // shared memory and the largest of all work groups with an atomic
+    float scaled = 0.0;
+    if (inside) {
+        float magnitude = max(abs(imageLoad(base, ivec3(location, layer)).r), abs(imageLoad(state, location).r));
+        scaled = abs(sum) / (tolerance * max(1.0, magnitude));
+        if (isnan(scaled) || isinf(scaled)) scaled = 1e30;
+    }
+    uint index = gl_LocalInvocationIndex;
+    largest[index] = scaled;
+    for (uint half_size = 32; half_size > 0; half_size /= 2) {
+        barrier();
+        if (index < half_size) largest[index] = max(largest[index], largest[index + half_size]);
+    }
+    if (index == 0) atomicMax(largest_error, floatBitsToUint(largest[0]));
+}
\ No newline at end of file
@@ -1,19 +1,32 @@
 #version 460 core
 
 layout (local_size_x = 1, local_size_y = 1, local_size_z = 1) in;
-layout (rgba32f, binding = 0) uniform image2D imgOutput;
-layout (r32f, binding = 1) uniform image2D u;
-layout (r32f, binding = 2) uniform image2D v;
+layout (rgba8, binding = 0) uniform image2D imgOutput;
+layout (r32f, binding = 1) uniform image2D u; // Current time level
+layout (r32f, binding = 2) uniform image2D u_previous; // Previous time level
+layout (r32f, binding = 3) uniform image2D u_next; // Next time level, written by PASS_STEP
+layout (binding = 0) uniform sampler2D damping; // Profile of the absorbing layer, 0 outside of it
 
 // Dimensions of the grids
 uniform int width;
 uniform int height;
 
+// Passes
+#define PASS_BRUSH 0
+#define PASS_STEP 1
+#define PASS_RENDER 2
+#define PASS_REST 3
+
+uniform int pass;
+
 // PDE settings
-uniform bool paused;
+uniform bool render_image;
 uniform int boundary_condition;
 uniform float dx;
 uniform float dt;
+uniform float speed; // Wave speed c
+uniform float step_ratio; // Time step over the step between the previous and current levels, rescales their velocity
+uniform float largest_damping; // Damping of the absorbing layer at the edges, the profile scales it
 
 // Brush settings
 uniform int brush_enabled;
@@ -29,11 +42,48 @@ vec3 cmap(float t) {
     return c0+t*(c1+t*(c2+t*(c3+t*(c4+t*(c5+t*c6)))));
 }
 
-// Performs the remainder operation
+// Performs the remainder operation, % is undefined for negative operands in GLSL
 int fmod(int x, int y) {
-    return (x % y + y) % y;
+    return x - y * int(floor(float(x) / float(y)));
+}
+
+#ifdef STENCIL_ORDER
+// Wider stencils, compiled in with STENCIL_ORDER 4 or 6, see Grid::set_stencil_order. Coefficients of the centered second
+// difference from the center outwards, HALO cells on either side.
+#if STENCIL_ORDER == 6
+const int HALO = 3;
+const float SECOND[4] = float[](-49.0 / 18.0, 3.0 / 2.0, -3.0 / 20.0, 1.0 / 90.0);
+#else
+const int HALO = 2;
+const float SECOND[4] = float[](-5.0 / 2.0, 4.0 / 3.0, -1.0 / 12.0, 0.0);
+#endif
+
+// Index the wide stencils read in place of index i along an axis of n cells, and the sign of the value there. Neumann edges
+// mirror the cells inside, Dirichlet edges mirror them with the opposite sign around the first ghost cell, which stays 0.
+ivec2 mirror(int i, int n) {
+    if (i >= 0 && i < n) return ivec2(i, 1);
+    if (boundary_condition == 2) return ivec2(fmod(i, n), 1);
+    if (boundary_condition == 1) return ivec2(clamp(i < 0 ? -1 - i : 2 * n - 1 - i, 0, n - 1), 1);
+    if (i == -1 || i == n) return ivec2(0, 0);
+    return ivec2(clamp(i < 0 ? -2 - i : 2 * n - i, 0, n - 1), -1);
+}
+
+// Value of the current level for the wide stencils, see mirror
+float wide_value(int x, int y) {
+    ivec2 column = mirror(x, width), row = mirror(y, height);
+    ivec2 cell = ivec2(column.x, row.x);
+    return float(column.y * row.y) * imageLoad(u, cell).r;
 }
 
+// Laplacian of the current level with the wide stencil
+float wide_laplacian(int x, int y) {
+    float sum = 2.0 * SECOND[0] * wide_value(x, y);
+    for (int k = 1; k <= HALO; k++)
+        sum += SECOND[k] * (wide_value(x-k, y) + wide_value(x+k, y) + wide_value(x, y-k) + wide_value(x, y+k));
+    return sum / (dx * dx);
+}
+#endif
+
 // Accesses the value of the U grid at a coordinate while respecting value-based boundary conditions
 float U(int x, int y) {
     if (x < 0 || x >= width || y < 0 || y >= height) {
@@ -47,21 +97,11 @@ float U(int x, int y) {
     return imageLoad(u, ivec2(x, y)).r;
 }
 
-// Accesses the value of the V grid at a coordinate while respecting value-based boundary conditions
-float V(int x, int y) {
-    if (x < 0 || x >= width || y < 0 || y >= height) {
-        if (boundary_condition == 2) { // Periodic Boundary Condition
-            return imageLoad(v, ivec2(fmod(x, width), fmod(y, height))).r;
-        } else { // Dirichlet Boundary Condition
-            return 0.0;
-        }
-    }
-
-    return imageLoad(v, ivec2(x, y)).r;
-}
-
-// Computes the temporal second order derivative at a coordinate points in the grid
+// Computes the temporal second order derivative c^2 laplacian(u) at a coordinate point in the grid
 float du_dt(int x, int y) {
+#ifdef STENCIL_ORDER
+    return pow(speed, 2) * wide_laplacian(x, y);
+#else
     float du_dx_0 = (U(x, y) - U(x-1, y)) / dx;
     float du_dx_1 = (U(x+1, y) - U(x, y)) / dx;
 
@@ -78,20 +118,37 @@ float du_dt(int x, int y) {
     float d2u_dx2 = (du_dx_1 - du_dx_0) / dx;
     float d2u_dy2 = (du_dy_1 - du_dy_0) / dx;
 
-    float c = dt / dx; // Follow CFL
-    return pow(c, 2) * (d2u_dx2 + d2u_dy2);
+    return pow(speed, 2) * (d2u_dx2 + d2u_dy2);
+#endif
 }
 
 void main() {
     ivec2 location = ivec2(gl_GlobalInvocationID.xy);
-    int pause = paused ? 0 : 1;
-
-    float dv_dt = du_dt(location.x, location.y);
     int ratio = int(min(1.0, pow(brush_radius, 2) / (pow(location.x - x_pos, 2) + pow(location.y - y_pos, 2))));
     float brush_value = 1.0f;
 
-    imageStore(v, location, vec4(V(location.x, location.y) + dv_dt * dt * pause));
-    float luminosity = (1 - brush_enabled * ratio) * (U(location.x, location.y) + V(location.x, location.y) * dt * pause) + (brush_enabled * ratio * brush_value);
-    imageStore(u, location, vec4(luminosity));
-    imageStore(imgOutput, location, vec4(cmap(min(1.0, abs(luminosity))), 1.0));
+    if (pass == PASS_BRUSH) {
+        // Both levels are set so that the displacement starts at rest
+        if (ratio == 1) {
+            imageStore(u, location, vec4(brush_value));
+            imageStore(u_previous, location, vec4(brush_value));
+        }
+        return;
+    }
+
+    if (pass == PASS_REST) {
+        // The previous level of a displacement at rest, u(-dt) = u(0) + dt^2 / 2 u_tt(0) to second order
+        imageStore(u_previous, location, vec4(U(location.x, location.y) + 0.5 * dt * dt * du_dt(location.x, location.y)));
+        return;
+    }
+
+    float luminosity = U(location.x, location.y);
+    if (pass == PASS_STEP) {
+        // The damping is centered in time, so the velocity is damped by (1 - sigma dt / 2) / (1 + sigma dt / 2)
+        float sigma_dt = 0.5 * dt * largest_damping * texelFetch(damping, location, 0).r;
+        float velocity = step_ratio * (U(location.x, location.y) - imageLoad(u_previous, location).r);
+        luminosity = U(location.x, location.y) + ((1.0 - sigma_dt) * velocity + du_dt(location.x, location.y) * dt * dt) / (1.0 + sigma_dt);
+        imageStore(u_next, location, vec4(luminosity));
+    }
+    if (render_image) imageStore(imgOutput, location, vec4(cmap(min(1.0, abs(luminosity))), 1.0));
 }
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "compress.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+/**
+ * Losslessly compresses a scalar field for storage in host memory.
+ * Each value is XORed with its predecessor and the result is split into byte planes, so smooth or constant
+ * regions turn into long runs of zero bytes that are then run-length encoded (PackBits).
+ * 
+ * @param data The values to compress
+ * @return The compressed bytes, decode them with decompress_floats
+ */
+std::vector<unsigned char> compress_floats(const std::vector<float>& data) {
+    size_t count = data.size();
+    std::vector<unsigned char> planes(count * 4);
+    uint32_t previous = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t bits;
+        std::memcpy(&bits, &data[i], sizeof(bits));
+        uint32_t delta = bits ^ previous;
+        previous = bits;
+        for (int b = 0; b < 4; b++) planes[b * count + i] = (delta >> (b * 8)) & 0xFF;
+    }
+
+    // A control byte below 128 is followed by that many plus one literal bytes, otherwise the next byte repeats 257 - control times
+    std::vector<unsigned char> out;
+    size_t i = 0;
+    while (i < planes.size()) {
+        size_t run = 1;
+        while (i + run < planes.size() && run < 128 && planes[i + run] == planes[i]) run++;
+        if (run >= 3) {
+            out.push_back((unsigned char)(257 - run));
+            out.push_back(planes[i]);
+            i += run;
+            continue;
+        }
+
+        size_t start = i;
+        size_t length = 0;
+        while (i < planes.size() && length < 128) {
+            if (i + 2 < planes.size() && planes[i] == planes[i + 1] && planes[i] == planes[i + 2]) break;
+            i++;
+            length++;
+        }
+        out.push_back((unsigned char)(length - 1));
+        out.insert(out.end(), planes.begin() + start, planes.begin() + start + length);
+    }
+    return out;
+}
+
+/**
+ * Restores a scalar field written by compress_floats
+ * 
+ * @param bytes The compressed bytes
+ * @param count Number of values that were compressed
+ * @return The original values
+ */
+std::vector<float> decompress_floats(const std::vector<unsigned char>& bytes, size_t count) {
+    std::vector<unsigned char> planes;
+    planes.reserve(count * 4);
+    size_t i = 0;
+    while (i < bytes.size() && planes.size() < count * 4) {
+        unsigned char control = bytes[i++];
+        if (control < 128) {
+            size_t length = std::min<size_t>(control + 1, bytes.size() - i);
+            planes.insert(planes.end(), bytes.begin() + i, bytes.begin() + i + length);
+            i += length;
+        } else if (i < bytes.size()) {
+            planes.insert(planes.end(), 257 - control, bytes[i++]);
+        }
+    }
+    planes.resize(count * 4, 0);
+
+    std::vector<float> data(count);
+    uint32_t previous = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t delta = 0;
+        for (int b = 0; b < 4; b++) delta |= (uint32_t)planes[b * count + i] << (b * 8);
+        previous ^= delta;
+        std::memcpy(&data[i], &previous, sizeof(previous));
+    }
+    return data;
+}
\ No newline at end of file
@@ -0,0 +1,417 @@
+#include "fft.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <thread>
+
+// Side of the tiles the spectrum is transposed in
+static constexpr int tile = 32;
+
+/**
+ * Replaces four points with their DFT. Multiplying by sign * i rotates by a quarter turn, with sign -1 for forward transforms.
+ */
+static inline void dft4(float* r, float* i, float sign) {
+    float t0r = r[0] + r[2], t0i = i[0] + i[2];
+    float t1r = r[0] - r[2], t1i = i[0] - i[2];
+    float t2r = r[1] + r[3], t2i = i[1] + i[3];
+    float t3r = -sign * (i[1] - i[3]), t3i = sign * (r[1] - r[3]);
+    r[0] = t0r + t2r; i[0] = t0i + t2i;
+    r[1] = t1r + t3r; i[1] = t1i + t3i;
+    r[2] = t0r - t2r; i[2] = t0i - t2i;
+    r[3] = t1r - t3r; i[3] = t1i - t3i;
+}
+
+/**
+ * Replaces R points with their DFT
+ */
+template <int R>
+static inline void butterfly(float* re, float* im, float sign) {
+    if constexpr (R == 2) {
+        float r = re[0] - re[1], i = im[0] - im[1];
+        re[0] += re[1]; im[0] += im[1];
+        re[1] = r; im[1] = i;
+    } else if constexpr (R == 4) {
+        dft4(re, im, sign);
+    } else {
+        // Splits into the even outputs, a DFT of a[k] + a[k+4], and the odd outputs, a DFT of (a[k] - a[k+4]) * w8^k
+        const float h = 0.70710678f;
+        float br[4], bi[4], cr[4], ci[4];
+        for (int k = 0; k < 4; k++) {
+            br[k] = re[k] + re[k+4]; bi[k] = im[k] + im[k+4];
+            cr[k] = re[k] - re[k+4]; ci[k] = im[k] - im[k+4];
+        }
+        float r1 = cr[1], i1 = ci[1], r3 = cr[3], i3 = ci[3];
+        cr[1] = h * (r1 - sign * i1); ci[1] = h * (sign * r1 + i1);
+        float r2 = cr[2];
+        cr[2] = -sign * ci[2]; ci[2] = sign * r2;
+        cr[3] = -h * (r3 + sign * i3); ci[3] = h * (sign * r3 - i3);
+        dft4(br, bi, sign);
+        dft4(cr, ci, sign);
+        for (int j = 0; j < 4; j++) {
+            re[2*j] = br[j]; im[2*j] = bi[j];
+            re[2*j+1] = cr[j]; im[2*j+1] = ci[j];
+        }
+    }
+}
+
+/**
+ * One radix-R stage of a Stockham FFT on a batch of signals, where point k of signal b is at k * batch + b.
+ * The signals share every twiddle factor, so they are processed in blocks of lanes: the butterflies of a block go through
+ * local arrays, which keeps the lane loop free of aliasing between the output rows and lets it vectorize.
+ *
+ * @param n Length of the sub-transforms of this stage
+ * @param s Number of sub-transforms, the product of the radices of the previous stages
+ */
+template <int R>
+static void stage(int n, int s, int batch, int begin, int end, const float* twiddle_re, const float* twiddle_im,
+                  const float* x_re, const float* x_im, float* y_re, float* y_im, float sign) {
+    constexpr int lanes = 16;
+    int m = n / R;
+    size_t in_step = (size_t)s * m * batch, out_step = (size_t)s * batch;
+    for (int p = 0; p < m; p++) {
+        float wr[R], wi[R];
+        wr[0] = 1.0f;
+        wi[0] = 0.0f;
+        for (int j = 1; j < R; j++) {
+            wr[j] = twiddle_re[p * (R-1) + j-1];
+            wi[j] = -sign * twiddle_im[p * (R-1) + j-1];
+        }
+        for (int q = 0; q < s; q++) {
+            size_t in = (size_t)(q + s * p) * batch, out = (size_t)(q + s * R * p) * batch;
+            for (int b = begin; b < end; b += lanes) {
+                int count = std::min(lanes, end - b);
+                float ar[R][lanes], ai[R][lanes];
+                for (int k = 0; k < R; k++) {
+                    for (int l = 0; l < count; l++) {
+                        ar[k][l] = x_re[in + k * in_step + b + l];
+                        ai[k][l] = x_im[in + k * in_step + b + l];
+                    }
+                    for (int l = count; l < lanes; l++) ar[k][l] = ai[k][l] = 0.0f;
+                }
+                for (int l = 0; l < lanes; l++) {
+                    float r[R], i[R];
+                    for (int k = 0; k < R; k++) {
+                        r[k] = ar[k][l];
+                        i[k] = ai[k][l];
+                    }
+                    butterfly<R>(r, i, sign);
+                    for (int j = 0; j < R; j++) {
+                        ar[j][l] = r[j] * wr[j] - i[j] * wi[j];
+                        ai[j][l] = r[j] * wi[j] + i[j] * wr[j];
+                    }
+                }
+                for (int j = 0; j < R; j++) {
+                    for (int l = 0; l < count; l++) {
+                        y_re[out + j * out_step + b + l] = ar[j][l];
+                        y_im[out + j * out_step + b + l] = ai[j][l];
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Transforms the signals begin to end of a batch in place with the stages of a power of two plan
+ */
+static void stockham(const FFTPlan& plan, float* re, float* im, float* work_re, float* work_im, int batch, int begin, int end, bool inverse) {
+    float sign = inverse ? 1.0f : -1.0f;
+    float* x_re = re;
+    float* x_im = im;
+    float* y_re = work_re;
+    float* y_im = work_im;
+    int n = plan.n, s = 1;
+
+    for (int i = 0; i < (int)plan.radices.size(); i++) {
+        const float* twiddle_re = plan.twiddle_re.data() + plan.twiddle_offsets[i];
+        const float* twiddle_im = plan.twiddle_im.data() + plan.twiddle_offsets[i];
+        if (plan.radices[i] == 8) stage<8>(n, s, batch, begin, end, twiddle_re, twiddle_im, x_re, x_im, y_re, y_im, sign);
+        else if (plan.radices[i] == 4) stage<4>(n, s, batch, begin, end, twiddle_re, twiddle_im, x_re, x_im, y_re, y_im, sign);
+        else stage<2>(n, s, batch, begin, end, twiddle_re, twiddle_im, x_re, x_im, y_re, y_im, sign);
+        n /= plan.radices[i];
+        s *= plan.radices[i];
+        std::swap(x_re, y_re);
+        std::swap(x_im, y_im);
+    }
+
+    // An odd number of stages leaves the result in the work arrays
+    if (x_re == re) return;
+    for (int k = 0; k < plan.n; k++) {
+        size_t row = (size_t)k * batch;
+        std::copy(x_re + row + begin, x_re + row + end, re + row + begin);
+        std::copy(x_im + row + begin, x_im + row + end, im + row + begin);
+    }
+}
+
+/**
+ * Transforms the signals begin to end of a batch in place with Bluestein's algorithm. With jk = (j^2 + k^2 - (j - k)^2) / 2,
+ * the DFT becomes a convolution with a chirp, which is evaluated with power of two FFTs of the padded length.
+ */
+static void bluestein(const FFTPlan& plan, const FFTPlan& padded, float* re, float* im, float* pad_re, float* pad_im,
+                      float* work_re, float* work_im, int batch, int begin, int end, bool inverse) {
+    float conjugate = inverse ? -1.0f : 1.0f;
+    for (int k = 0; k < padded.n; k++) {
+        size_t row = (size_t)k * batch;
+        for (int b = begin; b < end; b++) {
+            if (k >= plan.n) {
+                pad_re[row + b] = pad_im[row + b] = 0.0f;
+                continue;
+            }
+            float cr = plan.chirp_re[k], ci = conjugate * plan.chirp_im[k];
+            float xr = re[row + b], xi = im[row + b];
+            pad_re[row + b] = xr * cr - xi * ci;
+            pad_im[row + b] = xr * ci + xi * cr;
+        }
+    }
+
+    stockham(padded, pad_re, pad_im, work_re, work_im, batch, begin, end, false);
+    const std::vector<float>& kernel_re = inverse ? plan.inverse_kernel_re : plan.kernel_re;
+    const std::vector<float>& kernel_im = inverse ? plan.inverse_kernel_im : plan.kernel_im;
+    for (int k = 0; k < padded.n; k++) {
+        size_t row = (size_t)k * batch;
+        float kr = kernel_re[k], ki = kernel_im[k];
+        for (int b = begin; b < end; b++) {
+            float xr = pad_re[row + b], xi = pad_im[row + b];
+            pad_re[row + b] = xr * kr - xi * ki;
+            pad_im[row + b] = xr * ki + xi * kr;
+        }
+    }
+    stockham(padded, pad_re, pad_im, work_re, work_im, batch, begin, end, true);
+
+    float scale = 1.0f / padded.n;
+    for (int k = 0; k < plan.n; k++) {
+        size_t row = (size_t)k * batch;
+        float cr = scale * plan.chirp_re[k], ci = scale * conjugate * plan.chirp_im[k];
+        for (int b = begin; b < end; b++) {
+            float xr = pad_re[row + b], xi = pad_im[row + b];
+            re[row + b] = xr * cr - xi * ci;
+            im[row + b] = xr * ci + xi * cr;
+        }
+    }
+}
+
+/**
+ * Returns the cached plan for a length, building it on first use
+ *
+ * @param n Length of the transform
+ */
+const FFTPlan& FFT::plan(int n) {
+    static std::map<int, FFTPlan> plans;
+    static std::recursive_mutex mutex;
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    auto found = plans.find(n);
+    if (found != plans.end()) return found->second;
+    FFTPlan& plan = plans[n];
+    plan.n = n;
+    plan.m = 0;
+
+    if ((n & (n - 1)) == 0) {
+        for (int length = n; length > 1;) {
+            int radix = length % 8 == 0 ? 8 : length % 4 == 0 ? 4 : 2;
+            plan.radices.push_back(radix);
+            plan.twiddle_offsets.push_back(plan.twiddle_re.size());
+            for (int p = 0; p < length / radix; p++) {
+                for (int j = 1; j < radix; j++) {
+                    double angle = -2.0 * M_PI * p * j / length;
+                    plan.twiddle_re.push_back(std::cos(angle));
+                    plan.twiddle_im.push_back(std::sin(angle));
+                }
+            }
+            length /= radix;
+        }
+        return plan;
+    }
+
+    plan.m = 1;
+    while (plan.m < 2 * n - 1) plan.m *= 2;
+    plan.chirp_re.resize(n);
+    plan.chirp_im.resize(n);
+    for (long long k = 0; k < n; k++) {
+        // k^2 modulo 2n keeps the angle accurate for long transforms
+        double angle = -M_PI * (double)(k * k % (2 * n)) / n;
+        plan.chirp_re[k] = std::cos(angle);
+        plan.chirp_im[k] = std::sin(angle);
+    }
+
+    // The kernel holds the conjugate chirp at offsets -n < k < n, wrapped around the padded length
+    const FFTPlan& padded = FFT::plan(plan.m);
+    std::vector<float> work_re(plan.m), work_im(plan.m);
+    std::vector<float>* kernels[2][2] = {{&plan.kernel_re, &plan.kernel_im}, {&plan.inverse_kernel_re, &plan.inverse_kernel_im}};
+    for (int i = 0; i < 2; i++) {
+        std::vector<float>& kernel_re = *kernels[i][0];
+        std::vector<float>& kernel_im = *kernels[i][1];
+        float conjugate = i == 0 ? -1.0f : 1.0f;
+        kernel_re.assign(plan.m, 0.0f);
+        kernel_im.assign(plan.m, 0.0f);
+        for (int k = 0; k < n; k++) {
+            kernel_re[k] = kernel_re[(plan.m - k) % plan.m] = plan.chirp_re[k];
+            kernel_im[k] = kernel_im[(plan.m - k) % plan.m] = conjugate * plan.chirp_im[k];
+        }
+        stockham(padded, kernel_re.data(), kernel_im.data(), work_re.data(), work_im.data(), 1, 0, 1, false);
+    }
+    return plan;
+}
+
+FFT::FFT() {
+    width = height = 0;
+    threads = std::max(1u, std::thread::hardware_concurrency());
+}
+
+/**
+ * Sets the size of the grids to transform, plans are cached so resizing back and forth is cheap
+ *
+ * @param width Number of cells along the x-axis
+ * @param height Number of cells along the y-axis
+ */
+void FFT::resize(int width, int height) {
+    if (this->width == width && this->height == height) return;
+    this->width = width;
+    this->height = height;
+    spectrum_re.assign((size_t)width * frequencies(), 0.0f);
+    spectrum_im.assign((size_t)width * frequencies(), 0.0f);
+}
+
+/**
+ * @return Number of frequencies kept along y
+ */
+int FFT::frequencies() const {
+    return height / 2 + 1;
+}
+
+/**
+ * Computes |k|^2 for every entry of the spectrum, where the laplacian of a mode is -|k|^2 times the mode
+ *
+ * @param dx Size of a cell
+ */
+std::vector<float> FFT::squared_wavenumbers(float dx) const {
+    int ny = frequencies();
+    std::vector<float> result((size_t)width * ny);
+    for (int kx = 0; kx < width; kx++) {
+        double wx = 2.0 * M_PI * (kx <= width / 2 ? kx : kx - width) / (width * dx);
+        for (int ky = 0; ky < ny; ky++) {
+            double wy = 2.0 * M_PI * ky / (height * dx);
+            result[(size_t)kx * ny + ky] = wx * wx + wy * wy;
+        }
+    }
+    return result;
+}
+
+/**
+ * Transforms a batch of complex signals in place, point k of signal b is at k * batch + b. Inverse transforms are not scaled.
+ *
+ * @param n Length of every signal
+ * @param batch Number of signals
+ * @param inverse True for exp(2 pi i jk / n), false for exp(-2 pi i jk / n)
+ */
+void FFT::transform(float* re, float* im, int n, int batch, bool inverse) {
+    const FFTPlan& p = plan(n);
+    const FFTPlan* padded = p.m > 0 ? &plan(p.m) : nullptr;
+
+    size_t length = (size_t)(padded ? padded->n : n) * batch;
+    if (work_re.size() < length) {
+        work_re.resize(length);
+        work_im.resize(length);
+    }
+    if (padded && pad_re.size() < length) {
+        pad_re.resize(length);
+        pad_im.resize(length);
+    }
+    auto run = [&](int begin, int end) {
+        if (padded) bluestein(p, *padded, re, im, pad_re.data(), pad_im.data(), work_re.data(), work_im.data(), batch, begin, end, inverse);
+        else stockham(p, re, im, work_re.data(), work_im.data(), batch, begin, end, inverse);
+    };
+
+    // Small transforms are not worth starting threads for. Every thread gets whole cache lines of the batch.
+    int count = std::min(threads, (batch + 15) / 16);
+    if (count <= 1 || length < (1 << 15)) {
+        run(0, batch);
+        return;
+    }
+    int chunk = ((batch + count - 1) / count + 15) / 16 * 16;
+    std::vector<std::thread> pool;
+    for (int begin = 0; begin < batch; begin += chunk) pool.emplace_back(run, begin, std::min(batch, begin + chunk));
+    for (std::thread& thread : pool) thread.join();
+}
+
+/**
+ * Transforms a grid into spectrum_re and spectrum_im
+ *
+ * @param data width x height values in row-major order
+ */
+void FFT::forward(const float* data) {
+    int pairs = (width + 1) / 2, ny = frequencies();
+    packed_re.resize((size_t)height * pairs);
+    packed_im.resize((size_t)height * pairs);
+
+    // Columns 2j and 2j + 1 become the real and imaginary parts of signal j, so every row is already a batch
+    for (int y = 0; y < height; y++) {
+        for (int j = 0; j < pairs; j++) {
+            packed_re[(size_t)y * pairs + j] = data[(size_t)y * width + 2*j];
+            packed_im[(size_t)y * pairs + j] = 2*j + 1 < width ? data[(size_t)y * width + 2*j + 1] : 0.0f;
+        }
+    }
+    transform(packed_re.data(), packed_im.data(), height, pairs, false);
+
+    // The spectra of two real signals packed as a + ib are A = (Z[k] + conj Z[-k]) / 2 and B = (Z[k] - conj Z[-k]) / 2i.
+    // This also transposes the batch, so it runs in tiles that stay in cache.
+    for (int j0 = 0; j0 < pairs; j0 += tile) {
+        for (int k0 = 0; k0 < ny; k0 += tile) {
+            for (int j = j0; j < std::min(j0 + tile, pairs); j++) {
+                for (int ky = k0; ky < std::min(k0 + tile, ny); ky++) {
+                    size_t k = (size_t)ky * pairs + j, mirror = (size_t)((height - ky) % height) * pairs + j;
+                    float zr = packed_re[k], zi = packed_im[k], mr = packed_re[mirror], mi = -packed_im[mirror];
+                    spectrum_re[(size_t)(2*j) * ny + ky] = 0.5f * (zr + mr);
+                    spectrum_im[(size_t)(2*j) * ny + ky] = 0.5f * (zi + mi);
+                    if (2*j + 1 >= width) continue;
+                    spectrum_re[(size_t)(2*j + 1) * ny + ky] = 0.5f * (zi - mi);
+                    spectrum_im[(size_t)(2*j + 1) * ny + ky] = -0.5f * (zr - mr);
+                }
+            }
+        }
+    }
+    transform(spectrum_re.data(), spectrum_im.data(), width, ny, false);
+}
+
+/**
+ * Transforms spectrum_re and spectrum_im back into a grid, the spectrum is overwritten
+ *
+ * @param data width x height values in row-major order
+ */
+void FFT::inverse(float* data) {
+    int pairs = (width + 1) / 2, ny = frequencies();
+    transform(spectrum_re.data(), spectrum_im.data(), width, ny, true);
+
+    // Rebuilds the full spectrum of every column from its non-negative frequencies, and packs the pairs as A + iB
+    packed_re.resize((size_t)height * pairs);
+    packed_im.resize((size_t)height * pairs);
+    for (int j0 = 0; j0 < pairs; j0 += tile) {
+        for (int k0 = 0; k0 < height; k0 += tile) {
+            for (int j = j0; j < std::min(j0 + tile, pairs); j++) {
+                for (int ky = k0; ky < std::min(k0 + tile, height); ky++) {
+                    int source = ky < ny ? ky : height - ky;
+                    float conjugate = ky < ny ? 1.0f : -1.0f;
+                    float ar = spectrum_re[(size_t)(2*j) * ny + source], ai = conjugate * spectrum_im[(size_t)(2*j) * ny + source];
+                    float br = 0.0f, bi = 0.0f;
+                    if (2*j + 1 < width) {
+                        br = spectrum_re[(size_t)(2*j + 1) * ny + source];
+                        bi = conjugate * spectrum_im[(size_t)(2*j + 1) * ny + source];
+                    }
+                    packed_re[(size_t)ky * pairs + j] = ar - bi;
+                    packed_im[(size_t)ky * pairs + j] = ai + br;
+                }
+            }
+        }
+    }
+    transform(packed_re.data(), packed_im.data(), height, pairs, true);
+
+    float scale = 1.0f / ((float)width * height);
+    for (int y = 0; y < height; y++) {
+        for (int j = 0; j < pairs; j++) {
+            data[(size_t)y * width + 2*j] = scale * packed_re[(size_t)y * pairs + j];
+            if (2*j + 1 < width) data[(size_t)y * width + 2*j + 1] = scale * packed_im[(size_t)y * pairs + j];
+        }
+    }
+}
\ No newline at end of file
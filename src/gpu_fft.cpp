@@ -0,0 +1,295 @@
+#include <glad/glad.h>
+
+#include "gpu_fft.hpp"
+#include "fft.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Passes of fft.glsl
+enum FFTPass {
+    PASS_PACK = 0,
+    PASS_STAGE,
+    PASS_CHIRP,
+    PASS_CONVOLVE,
+    PASS_UNCHIRP,
+    PASS_UNPACK,
+    PASS_POISSON,
+    PASS_SPECTRUM
+};
+
+/**
+ * Uploads a table of complex numbers as an n x 1 RG32F texture
+ */
+static Texture upload(const std::vector<float>& re, const std::vector<float>& im) {
+    std::vector<float> texels(2 * re.size());
+    for (int k = 0; k < re.size(); k++) {
+        texels[2 * k] = re[k];
+        texels[2 * k + 1] = im[k];
+    }
+    Texture table(GL_RG32F, (int)re.size(), 1);
+    glTextureSubImage2D(table.ID, 0, 0, 0, (int)re.size(), 1, GL_RG, GL_FLOAT, texels.data());
+    return table;
+}
+
+GpuFFT::GpuFFT()
+    : fftCS("shaders/fft.glsl")
+{
+    width = 0;
+    height = 0;
+}
+
+GpuFFT::~GpuFFT() {
+    release();
+}
+
+/**
+ * Allocates the complex grid for a new size, a no-op if the size did not change
+ *
+ * @param width Number of cells along the x-axis
+ * @param height Number of cells along the y-axis
+ */
+void GpuFFT::resize(int width, int height) {
+    if (data.ID != 0 && this->width == width && this->height == height) return;
+    release();
+    this->width = width;
+    this->height = height;
+    if (width <= 0 || height <= 0) return;
+
+    data = texture_pool().acquire(GL_RG32F, width, height);
+    work = texture_pool().acquire(GL_RG32F, width, height);
+}
+
+/**
+ * Gives the complex grid back to the pool, the plans are kept since they only depend on the lengths
+ */
+void GpuFFT::release() {
+    if (data.ID != 0) texture_pool().release(std::move(data));
+    if (work.ID != 0) texture_pool().release(std::move(work));
+}
+
+/**
+ * Builds the tables of a transform of the given length the first time it is needed.
+ * Lengths whose prime factors are all at most 7 are computed with one Stockham stage per factor, any other length with
+ * Bluestein's algorithm, whose chirp and kernels are shared with the CPU FFT.
+ *
+ * @param n Length of the transform
+ * @return The cached plan
+ */
+const GpuFFTPlan& GpuFFT::plan(int n) {
+    auto found = plans.find(n);
+    if (found != plans.end()) return found->second;
+
+    GpuFFTPlan& plan = plans[n];
+    plan.n = n;
+    plan.m = 0;
+
+    int rest = n;
+    for (int radix : {4, 2, 3, 5, 7})
+        while (rest % radix == 0 && rest > 1) {
+            plan.radices.push_back(radix);
+            rest /= radix;
+        }
+
+    if (rest == 1) {
+        std::vector<float> re(n), im(n);
+        for (int k = 0; k < n; k++) {
+            double angle = -2.0 * M_PI * k / n;
+            re[k] = (float)std::cos(angle);
+            im[k] = (float)std::sin(angle);
+        }
+        plan.twiddles = upload(re, im);
+        return plan;
+    }
+
+    plan.radices.clear();
+    const FFTPlan& tables = FFT::plan(n);
+    plan.m = tables.m;
+    plan.chirp = upload(tables.chirp_re, tables.chirp_im);
+    plan.kernel = upload(tables.kernel_re, tables.kernel_im);
+    plan.inverse_kernel = upload(tables.inverse_kernel_re, tables.inverse_kernel_im);
+    this->plan(plan.m);
+    return plan;
+}
+
+/**
+ * Packs scalar layers into the complex grid
+ *
+ * @param real The real part, at the size of the grid
+ * @param imaginary The imaginary part, or nullptr for a real signal
+ */
+void GpuFFT::load(const Texture& real, const Texture* imaginary) {
+    fftCS.bind();
+    fftCS.set_int("width", width);
+    fftCS.set_int("height", height);
+    fftCS.set_bool("imaginary", imaginary != nullptr);
+    glBindImageTexture(6, real.ID, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(7, (imaginary ? imaginary : &real)->ID, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    dispatch(PASS_PACK, work, data, (width + 7) / 8, (height + 7) / 8);
+}
+
+/**
+ * Unpacks the real part of the complex grid into a scalar layer, dividing by width * height to complete an inverse transform
+ *
+ * @param real The layer to write, at the size of the grid
+ */
+void GpuFFT::store(const Texture& real) {
+    fftCS.bind();
+    fftCS.set_int("width", width);
+    fftCS.set_int("height", height);
+    fftCS.set_float("scale", 1.0f / ((float)width * height));
+    glBindImageTexture(6, real.ID, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    dispatch(PASS_UNPACK, data, work, (width + 7) / 8, (height + 7) / 8);
+}
+
+/**
+ * Transforms the complex grid into its spectrum, frequency (kx, ky) at texel (kx, ky)
+ */
+void GpuFFT::forward() {
+    transform(0, false);
+    transform(1, false);
+}
+
+/**
+ * Transforms a spectrum back without normalizing it, see store
+ */
+void GpuFFT::inverse() {
+    transform(0, true);
+    transform(1, true);
+}
+
+/**
+ * Turns the spectrum of the right hand side f into the spectrum of the periodic solution of -laplacian(u) = f with zero mean
+ *
+ * @param dx Size of a cell
+ * @param wide Whether the laplacian is the composition of two centered first differences, which the collocated
+ *             Navier-Stokes projection uses, instead of the 5 point stencil
+ */
+void GpuFFT::solve_poisson(float dx, bool wide) {
+    fftCS.bind();
+    fftCS.set_int("width", width);
+    fftCS.set_int("height", height);
+    fftCS.set_float("dx", dx);
+    fftCS.set_bool("wide", wide);
+    dispatch(PASS_POISSON, data, work, (width + 7) / 8, (height + 7) / 8);
+    std::swap(data, work);
+}
+
+/**
+ * Sums the energy 0.5 * |z|^2 / (width * height)^2 of the spectrum over shells of integer wavenumber, measured in units of the
+ * lowest frequency of the longer side. For a velocity loaded as u + iv, the shells add up to the mean kinetic energy.
+ * Only the shells are read back.
+ *
+ * @return The energy of every shell, from the mean flow up to the corners of the spectrum
+ */
+std::vector<float> GpuFFT::energy_spectrum() {
+    // The corners of the spectrum reach sqrt(2) times the Nyquist frequency
+    int bins = (int)std::round(std::max(width, height) / 2 * std::sqrt(2.0)) + 1;
+    if (spectrum.size < bins * sizeof(float)) spectrum = Buffer(bins * sizeof(float), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+    fftCS.bind();
+    fftCS.set_int("width", width);
+    fftCS.set_int("height", height);
+    fftCS.set_int("bins", bins);
+    fftCS.set_float("scale", 1.0f / ((float)width * height * (float)width * height));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, spectrum.ID);
+    dispatch(PASS_SPECTRUM, data, work, (bins + 7) / 8, 1);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    std::vector<float> energy(bins);
+    glGetNamedBufferSubData(spectrum.ID, 0, bins * sizeof(float), energy.data());
+    return energy;
+}
+
+/**
+ * Transforms every row (or column) of the complex grid
+ *
+ * @param axis 0 to transform along x, 1 along y
+ * @param inverse Whether to run an unnormalized inverse transform
+ */
+void GpuFFT::transform(int axis, bool inverse) {
+    int n = axis == 0 ? width : height, lines = axis == 0 ? height : width;
+    const GpuFFTPlan& p = plan(n);
+    if (p.m == 0) {
+        stages(p, data, work, axis, inverse);
+        return;
+    }
+
+    // Bluestein's algorithm: multiply by the chirp, convolve with its conjugate through FFTs of the padded length m and
+    // multiply by the chirp again
+    const GpuFFTPlan& padded = plan(p.m);
+    Texture a = texture_pool().acquire(GL_RG32F, axis == 0 ? p.m : width, axis == 0 ? height : p.m);
+    Texture b = texture_pool().acquire(GL_RG32F, axis == 0 ? p.m : width, axis == 0 ? height : p.m);
+
+    fftCS.bind();
+    fftCS.set_int("axis", axis);
+    fftCS.set_int("lines", lines);
+    fftCS.set_int("length", p.m);
+    fftCS.set_int("chirp_length", n);
+    fftCS.set_float("sign", inverse ? 1.0f : -1.0f);
+    glBindImageTexture(4, p.chirp.ID, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
+    dispatch(PASS_CHIRP, data, a, (p.m + 7) / 8, (lines + 7) / 8);
+
+    stages(padded, a, b, axis, false);
+    glBindImageTexture(5, (inverse ? p.inverse_kernel : p.kernel).ID, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
+    fftCS.set_int("length", p.m);
+    dispatch(PASS_CONVOLVE, a, b, (p.m + 7) / 8, (lines + 7) / 8);
+    std::swap(a, b);
+    stages(padded, a, b, axis, true);
+
+    fftCS.set_float("sign", inverse ? 1.0f : -1.0f);
+    fftCS.set_float("scale", 1.0f / p.m);
+    glBindImageTexture(4, p.chirp.ID, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
+    dispatch(PASS_UNCHIRP, a, data, (n + 7) / 8, (lines + 7) / 8);
+
+    texture_pool().release(std::move(a));
+    texture_pool().release(std::move(b));
+}
+
+/**
+ * Runs the Stockham stages of a transform, one dispatch per factor of the length, leaving the result in source
+ *
+ * @param plan The plan of the transform length
+ * @param source The signals to transform, overwritten with their transforms
+ * @param target Scratch space of the same size, swapped with source after every stage
+ * @param axis 0 to transform along x, 1 along y
+ * @param inverse Whether to use the conjugate twiddles
+ */
+void GpuFFT::stages(const GpuFFTPlan& plan, Texture& source, Texture& target, int axis, bool inverse) {
+    int lines = axis == 0 ? source.height : source.width;
+
+    fftCS.bind();
+    fftCS.set_int("axis", axis);
+    fftCS.set_int("lines", lines);
+    fftCS.set_int("length", plan.n);
+    fftCS.set_float("sign", inverse ? 1.0f : -1.0f);
+    glBindImageTexture(3, plan.twiddles.ID, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
+
+    int stage_length = plan.n, stride = 1;
+    for (int radix : plan.radices) {
+        fftCS.set_int("stage_length", stage_length);
+        fftCS.set_int("stride", stride);
+        fftCS.set_int("radix", radix);
+        dispatch(PASS_STAGE, source, target, (plan.n / radix + 7) / 8, (lines + 7) / 8);
+        std::swap(source, target);
+        stage_length /= radix;
+        stride *= radix;
+    }
+}
+
+/**
+ * Runs one pass of fft.glsl, the shader must be bound and its uniforms set
+ *
+ * @param pass One of FFTPass
+ * @param source Bound to image unit 1
+ * @param target Bound to image unit 2
+ * @param x_groups Number of work groups along x
+ * @param y_groups Number of work groups along y
+ */
+void GpuFFT::dispatch(int pass, const Texture& source, const Texture& target, int x_groups, int y_groups) {
+    fftCS.set_int("pass", pass);
+    glBindImageTexture(1, source.ID, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RG32F);
+    glBindImageTexture(2, target.ID, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RG32F);
+    glDispatchCompute(x_groups, y_groups, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+}
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include "gray_scott.hpp"
 #include "sandbox.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 GrayScott::GrayScott(int width, int height) 
@@ -27,6 +29,14 @@ GrayScott::GrayScott(int width, int height)
 
     for (const auto& kp : presets) preset_strs.push_back(kp.first.c_str());
 
+    parameters = {{"a", &a}, {"b", &b}, {"D", &D}};
+    fields_supported = true;
+    stencils_supported = true;
+    integrator_strs = {"Forward Euler", "Spectral", "IMEX Euler", "RKL2"};
+    add_runge_kutta_methods();
+    adaptive_supported = true;
+    advance = true;
+
     layer_strs.resize(2);
     layer_strs = {"Chemical A", "Chemical B"};
 
@@ -34,9 +44,234 @@ GrayScott::GrayScott(int width, int height)
 }
 
 /**
- * Dispatch the compute shader which solves the equation
+ * Adds a preset to the list shown in the GUI, or replaces the values of an existing one
+ * 
+ * @param name Name of the preset
+ * @param a Feed rate of the preset
+ * @param b Kill rate of the preset
+ */
+void GrayScott::add_preset(const std::string& name, float a, float b) {
+    std::string selected = preset_strs[preset];
+    presets[name] = {a, b};
+
+    // The map may have reordered its keys, so rebuild the list and keep the same preset highlighted
+    preset_strs.clear();
+    for (const auto& kp : presets) {
+        if (kp.first == selected) preset = preset_strs.size();
+        preset_strs.push_back(kp.first.c_str());
+    }
+}
+
+/**
+ * Selects a preset by name and applies its feed and kill rates
+ * 
+ * @param name Name of the preset
+ * @return True if a preset with that name exists
+ */
+bool GrayScott::select_preset(const std::string& name) {
+    for (int i = 0; i < preset_strs.size(); i++) {
+        if (name == preset_strs[i]) {
+            preset = i;
+            a = presets[name].first;
+            b = presets[name].second;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @return True if the spectral integrator can advance the grid, which needs periodic boundaries and uniform parameters.
+ * Otherwise it falls back to the implicit-explicit integrator.
+ */
+bool GrayScott::spectral() const {
+    return integrator == 1 && boundary_condition == 2 && parameter_fields.empty();
+}
+
+/**
+ * @return True if the implicit-explicit integrator advances the grid, either selected or as the fallback of the spectral one
+ */
+bool GrayScott::imex() const {
+    return integrator == 2 || (integrator == 1 && !spectral());
+}
+
+/**
+ * @return True if the Runge-Kutta-Legendre super time steps advance the diffusion
+ */
+bool GrayScott::super() const {
+    return integrator == 3;
+}
+
+/**
+ * Splits the reactions of a step into forward Euler substeps of at most 1 / (3 + a + b), a bound on the rates of the
+ * reactions while both concentrations stay within [0, 1]. Small steps keep a single substep.
+ *
+ * @return Number of substeps of the reactions
+ */
+int GrayScott::reaction_substeps() const {
+    return std::max(1, (int)std::ceil(time_step * (3.0f + largest_parameter("a", a) + largest_parameter("b", b))));
+}
+
+/**
+ * @return Number of stages of the Runge-Kutta-Legendre integrator, enough for the diffusion of the faster chemical
+ */
+int GrayScott::super_stages() const {
+    float euler = space_step * space_step / (4.0f * laplacian_scale() * std::max(1.0f, largest_parameter("D", D)));
+    return RungeKutta::super_stages(time_step / euler);
+}
+
+/**
+ * Advances both chemicals on the CPU with an integrating factor Euler step: the reactions are integrated explicitly,
+ * then every Fourier mode decays by exp(-D |k|^2 dt), the exact solution of its diffusion over the step.
+ * Diffusion then no longer limits the time step, only the reactions do.
+ */
+void GrayScott::step_spectral() {
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+    std::vector<float> u = read_layer(0);
+    std::vector<float> v = read_layer(1);
+    int substeps = reaction_substeps();
+    float h = time_step / substeps;
+    for (size_t i = 0; i < u.size(); i++) {
+        for (int j = 0; j < substeps; j++) {
+            float reaction = u[i] * u[i] * v[i];
+            u[i] += h * (reaction - (a + b) * u[i]);
+            v[i] += h * (a * (1.0f - v[i]) - reaction);
+        }
+    }
+
+    fft.resize(width, height);
+    std::vector<float> wavenumbers = fft.squared_wavenumbers(space_step);
+    float diffusion[2] = {1.0f, D};
+    std::vector<float>* fields[2] = {&u, &v};
+    for (int i = 0; i < 2; i++) {
+        fft.forward(fields[i]->data());
+        for (size_t k = 0; k < wavenumbers.size(); k++) {
+            float decay = std::exp(-diffusion[i] * time_step * wavenumbers[k]);
+            fft.spectrum_re[k] *= decay;
+            fft.spectrum_im[k] *= decay;
+        }
+        fft.inverse(fields[i]->data());
+        glTextureSubImage2D(layers[i].ID, 0, 0, 0, width, height, GL_RED, GL_FLOAT, fields[i]->data());
+    }
+}
+
+/**
+ * Advances both chemicals with an implicit-explicit Euler step split into its two parts: the shader integrates the reactions
+ * of every cell with as many substeps as they need, then multigrid solves the diffusion of each chemical implicitly.
+ * Neither part limits the time step through the cell size, unlike the explicit stencil.
+ */
+void GrayScott::step_imex() {
+    step_reactions();
+    multigrid.resize(width, height);
+    multigrid.boundary_condition = boundary_condition;
+    multigrid.dx = space_step;
+    multigrid.identity = 1.0f;
+    multigrid.scale = time_step;
+    auto field = parameter_fields.find("D");
+    for (int i = 0; i < 2; i++) {
+        if (i == 0) multigrid.set_coefficient(nullptr, 1.0f);
+        else multigrid.set_coefficient(field != parameter_fields.end() ? &field->second.texture : nullptr, D);
+        multigrid.evaluate(layers[i], 1.0f, 0.0f);
+        multigrid.solve(layers[i], v_cycles);
+    }
+
+    // The multigrid passes use their own image bindings
+    bind();
+    gray_scottCS.bind();
+    bind_parameter_fields(gray_scottCS);
+}
+
+/**
+ * Advances the diffusion of both chemicals with a Runge-Kutta-Legendre super time step after the reactions,
+ * a fully explicit alternative to step_imex whose number of stencil passes grows with the square root of the time step
+ */
+void GrayScott::step_super() {
+    step_reactions();
+    gray_scottCS.bind();
+    gray_scottCS.set_bool("diffusion_only", true);
+    runge_kutta.super_step(*this, time_step, super_stages());
+    gray_scottCS.bind();
+    gray_scottCS.set_bool("diffusion_only", false);
+    bind();
+    bind_parameter_fields(gray_scottCS);
+}
+
+/**
+ * Advances only the reactions of every cell over the time step, see reaction_substeps
+ */
+void GrayScott::step_reactions() {
+    gray_scottCS.bind();
+    gray_scottCS.set_bool("reactions", true);
+    gray_scottCS.set_int("reaction_substeps", reaction_substeps());
+    glDispatchCompute(width, height, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    gray_scottCS.set_bool("reactions", false);
+}
+
+/**
+ * Writes the time derivatives of both chemicals into the first two slices of rates
+ * 
+ * @param rates 2D array texture with a slice per layer
+ */
+void GrayScott::evaluate_rates(const Texture& rates) {
+    bind();
+    gray_scottCS.bind();
+    bind_parameter_fields(gray_scottCS);
+    gray_scottCS.set_bool("derivative", true);
+    glBindImageTexture(3, rates.ID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R32F);
+    glDispatchCompute(width, height, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    gray_scottCS.set_bool("derivative", false);
+}
+
+/**
+ * Bounds the decay rates of the discretized equations by the diffusion of the faster chemical, 8 max(1, D) / dx^2, plus the
+ * rows of the reaction Jacobian, which sum to at most 2 |u| |v| + u^2 + a + b. The largest concentrations and parameter
+ * fields are reduced on the GPU. The spectral, implicit-explicit and Runge-Kutta-Legendre integrators have no limit, their
+ * reactions are split into substeps and their diffusion is implicit or takes as many stages as it needs.
+ *
+ * @return The largest stable time step
+ */
+float GrayScott::stable_time_step() {
+    if (spectral() || imex() || super()) {
+        limited_by = "nothing, the reactions take substeps and the diffusion is implicit or takes more stages";
+        return INFINITY;
+    }
+    std::vector<const Texture*> fields = {&layers[0], &layers[1]};
+    std::map<std::string, float> largest = {{"a", std::abs(a)}, {"b", std::abs(b)}, {"D", std::abs(D)}};
+    std::vector<std::string> names;
+    for (const auto& kp : parameter_fields) {
+        fields.push_back(&kp.second.texture);
+        names.push_back(kp.first);
+    }
+    std::vector<float> maxima = reduction.max_abs(fields);
+    for (int i = 0; i < names.size(); i++) largest[names[i]] = maxima[i + 2];
+
+    float u = maxima[0], v = maxima[1];
+    float reaction = 2.0f * u * v + u * u + largest["a"] + largest["b"];
+    float diffusion = 8.0f * laplacian_scale() * std::max(1.0f, largest["D"]) / (space_step * space_step);
+    limited_by = diffusion > reaction ? "diffusion" : "reactions";
+    return stability_extent() / (diffusion + reaction);
+}
+
+/**
+ * Dispatch the compute shader which solves the equation. The spectral integrator advances the solution on the CPU first,
+ * the implicit-explicit integrator with multigrid and the Runge-Kutta(-Legendre) integrators with their stages on the GPU, the shader
+ * then only applies the brush and the color map.
  */
 void GrayScott::solve() {
+    if (spectral() && advance) {
+        step_spectral();
+    } else if (imex() && advance) {
+        step_imex();
+    } else if (super() && advance) {
+        step_super();
+    } else if (runge_kutta_method() >= 0 && advance) {
+        runge_kutta.step(*this, runge_kutta_methods()[runge_kutta_method()], time_step);
+        bind();
+        gray_scottCS.bind();
+        bind_parameter_fields(gray_scottCS);
+    }
     glDispatchCompute(width, height, 1);
     glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 }
@@ -51,13 +286,21 @@ void GrayScott::gui() {
     ImGui::SliderFloat("##b", &b, 0.0, 1.0);
     ImGui::Text("Diffusion (D)");
     ImGui::SliderFloat("##D", &D, 0.0, 2.0);
+    if (integrator == 1) {
+        ImGui::TextWrapped(spectral() ? "Diffusion solved exactly with FFTs on the CPU" : "Needs periodic boundaries and uniform parameters, using IMEX Euler");
+    }
+    if (spectral() || imex() || super()) ImGui::Text("Reaction Substeps: %d", reaction_substeps());
+    if (super()) ImGui::Text("Diffusion Stages: %d", super_stages());
+    if (imex()) {
+        ImGui::Text("V-Cycles per Step");
+        ImGui::SliderInt("##V-Cycles", &v_cycles, 1, 8);
+    }
+    if (runge_kutta_method() >= 0) runge_kutta.gui(runge_kutta_methods()[runge_kutta_method()]);
     ImGui::Text("Visible Layer");
     ImGui::Combo("##Visible Layer", &visible_layer, layer_strs.data(), layer_strs.size());
     ImGui::Text("Presets");
-    if (ImGui::ListBox("##Preset", &preset, preset_strs.data(), preset_strs.size())) {
-        a = presets[std::string(preset_strs[preset])].first;
-        b = presets[std::string(preset_strs[preset])].second;
-    }
+    if (ImGui::ListBox("##Preset", &preset, preset_strs.data(), preset_strs.size()))
+        select_preset(preset_strs[preset]);
 }
 
 /**
@@ -72,6 +315,8 @@ void GrayScott::reset_settings() {
     space_step = 5.0f;
     time_step = 0.5f;
     boundary_condition = 0;
+    integrator = 0;
+    v_cycles = 2;
 }
 
 /**
@@ -81,8 +326,10 @@ void GrayScott::reset_settings() {
  * @param paused Is the simulation paused?
  */
 void GrayScott::set_uniforms(std::string cmap_str, bool paused) {
+    advance = !paused;
     gray_scottCS.bind();
-    gray_scottCS.set_bool("paused", paused);
+    gray_scottCS.set_bool("paused", paused || integrator > 0);
+    gray_scottCS.set_bool("render_image", render_image);
     gray_scottCS.set_int("width", width);
     gray_scottCS.set_int("height", height);
     gray_scottCS.set_int("boundary_condition", boundary_condition);
@@ -97,5 +344,43 @@ void GrayScott::set_uniforms(std::string cmap_str, bool paused) {
     gray_scottCS.set_int("x_pos", x_pos);
     gray_scottCS.set_int("y_pos", y_pos);
     gray_scottCS.set_int("brush_radius", brush_radius);
+    bind_parameter_fields(gray_scottCS);
     apply_cmap(gray_scottCS, cmap_str);
+}
+
+/**
+ * Recompiles the compute shader so that every parameter with a field is sampled per cell, with the selected stencils
+ */
+void GrayScott::compile_shaders() {
+    glDeleteProgram(gray_scottCS.ID);
+    gray_scottCS = ComputeShader("shaders/gray_scott.glsl", shader_defines());
+}
+
+/**
+ * Copies another Gray-Scott grid, along with the preset and the solver settings that are not parameters
+ * 
+ * @param other The grid to copy, must be resident
+ */
+void GrayScott::copy_from(const Grid& other) {
+    Grid::copy_from(other);
+    const GrayScott& gray_scott = static_cast<const GrayScott&>(other);
+    preset = gray_scott.preset;
+    v_cycles = gray_scott.v_cycles;
+    runge_kutta.tolerance = gray_scott.runge_kutta.tolerance;
+    runge_kutta.substep = gray_scott.runge_kutta.substep;
+}
+
+/**
+ * Evicts the layers and gives the multigrid hierarchy back to the pool, the next IMEX step rebuilds it
+ */
+void GrayScott::evict() {
+    Grid::evict();
+    multigrid.release();
+}
+
+/**
+ * @return The amount of video memory held by the grid's textures and the multigrid hierarchy
+ */
+size_t GrayScott::bytes() const {
+    return Grid::bytes() + multigrid.bytes();
 }
\ No newline at end of file
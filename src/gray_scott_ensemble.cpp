@@ -0,0 +1,300 @@
+#include <glad/glad.h>
+#include <imgui/imgui.h>
+
+#include "color_maps.hpp"
+#include "gray_scott_ensemble.hpp"
+
+#include <algorithm>
+
+GrayScottEnsemble::GrayScottEnsemble(int width, int height)
+    : ensembleCS("shaders/gray_scott_ensemble.glsl"), Grid(width, height, 2)
+{
+    parameters = {{"a_min", &a_min}, {"a_max", &a_max}, {"b_min", &b_min}, {"b_max", &b_max}, {"D", &D}};
+
+    layer_strs = {"Chemical A", "Chemical B"};
+    advance = true;
+    host_revision = 0;
+    host_dirty = false;
+
+    reset_settings();
+    set_layout(8, 8);
+}
+
+/**
+ * Changes the number of runs in the ensemble. Every run starts over from a cleared state.
+ * 
+ * @param columns Number of runs along the x-axis, each with a different feed rate
+ * @param rows Number of runs along the y-axis, each with a different kill rate
+ */
+void GrayScottEnsemble::set_layout(int columns, int rows) {
+    sync();
+    this->columns = std::max(1, columns);
+    this->rows = std::max(1, rows);
+    member_buffer = Buffer(members() * sizeof(EnsembleMember), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    uploaded.clear();
+
+    if (width == 0 || height == 0) return;
+    int old_width = width, old_height = height;
+    width = height = 0;
+    resize(old_width, old_height);
+}
+
+/**
+ * Copies another ensemble, with its member buffer sized for the layout of the copy before the layers are copied
+ * 
+ * @param other The grid to copy, must be resident
+ */
+void GrayScottEnsemble::copy_from(const Grid& other) {
+    set_layout(other.columns, other.rows);
+    Grid::copy_from(other);
+}
+
+/**
+ * @return The settings of every run, interpolating the feed and kill rates across the columns and rows
+ */
+std::vector<EnsembleMember> GrayScottEnsemble::build_members() {
+    std::vector<EnsembleMember> result(members());
+    for (int row = 0; row < rows; row++) {
+        for (int column = 0; column < columns; column++) {
+            float s = columns > 1 ? (float)column / (columns - 1) : 0.0f;
+            float t = rows > 1 ? (float)row / (rows - 1) : 0.0f;
+            result[row * columns + column] = {a_min + s * (a_max - a_min), b_min + t * (b_max - b_min), D, time_step, space_step};
+        }
+    }
+    return result;
+}
+
+/**
+ * Switches between advancing the runs on the GPU and on the CPU, the runs carry on from their current state.
+ * On the CPU the shader only applies the color map.
+ * 
+ * @param cpu True to advance the runs on the CPU
+ * @return True, both backends are supported
+ */
+bool GrayScottEnsemble::set_backend(bool cpu) {
+    if (cpu == cpu_backend) return true;
+    sync();
+    cpu_backend = cpu;
+    if (!cpu) {
+        std::vector<float>().swap(host_u);
+        std::vector<float>().swap(host_v);
+        std::vector<float>().swap(next_u);
+        std::vector<float>().swap(next_v);
+    }
+    return true;
+}
+
+/**
+ * Reads both layers back from the GPU and interleaves the runs into blocks of lanes
+ */
+void GrayScottEnsemble::load_host() {
+    int cells = layers[0].width * layers[0].height;
+    int runs = std::max(1, layers[0].depth);
+    int blocks = (runs + lanes - 1) / lanes;
+    std::vector<float>* host[2] = {&host_u, &host_v};
+
+    host_dirty = false;
+    for (int i = 0; i < 2; i++) {
+        std::vector<float> data = read_layer(i);
+        host[i]->assign((size_t)blocks * cells * lanes, 0.0f);
+        for (int run = 0; run < runs; run++) {
+            float* lane = host[i]->data() + ((size_t)(run / lanes) * cells * lanes + run % lanes);
+            for (int cell = 0; cell < cells; cell++) lane[(size_t)cell * lanes] = data[(size_t)run * cells + cell];
+        }
+    }
+    host_revision = revision;
+}
+
+/**
+ * Uploads the host layers to the textures if the CPU has advanced them since the last upload.
+ * Layers rewritten since the host loaded them (e.g. cleared by a reset) take precedence.
+ */
+void GrayScottEnsemble::sync() {
+    if (!host_dirty || host_revision != revision) return;
+    host_dirty = false;
+
+    int cells = layers[0].width * layers[0].height;
+    int runs = std::max(1, layers[0].depth);
+    const std::vector<float>* host[2] = {&host_u, &host_v};
+    std::vector<float> data((size_t)runs * cells);
+    for (int i = 0; i < 2; i++) {
+        for (int run = 0; run < runs; run++) {
+            const float* lane = host[i]->data() + ((size_t)(run / lanes) * cells * lanes + run % lanes);
+            for (int cell = 0; cell < cells; cell++) data[(size_t)run * cells + cell] = lane[(size_t)cell * lanes];
+        }
+        const Texture& texture = layers[i];
+        if (texture.depth > 0) glTextureSubImage3D(texture.ID, 0, 0, 0, 0, texture.width, texture.height, texture.depth, GL_RED, GL_FLOAT, data.data());
+        else glTextureSubImage2D(texture.ID, 0, 0, 0, texture.width, texture.height, GL_RED, GL_FLOAT, data.data());
+    }
+}
+
+/**
+ * Advances every run by one step on the CPU. Runs are processed in blocks of lanes, and the innermost loop
+ * applies the same stencil to a different run in every lane, so it has no branches and vectorizes cleanly
+ * even for grids too small to fill the SIMD registers along a row.
+ */
+void GrayScottEnsemble::step_cpu() {
+    if (host_revision != revision || host_u.empty()) load_host();
+
+    int w = layers[0].width, h = layers[0].height, cells = w * h;
+    std::vector<EnsembleMember> settings = build_members();
+    int blocks = (settings.size() + lanes - 1) / lanes;
+    next_u.resize(host_u.size());
+    next_v.resize(host_v.size());
+    static const float zeros[lanes] = {};
+
+    // The brush paints a disk into the run under the cursor
+    int brush_run = -1, brush_x = 0, brush_y = 0;
+    if (brush_enabled && x_pos >= 0 && y_pos >= 0 && x_pos / w < columns && y_pos / h < rows) {
+        brush_run = (y_pos / h) * columns + x_pos / w;
+        brush_x = x_pos % w;
+        brush_y = y_pos % h;
+    }
+
+    // Index of a neighbouring cell, -1 for a Dirichlet boundary which reads 0. Neumann boundaries reuse the cell itself.
+    auto neighbour = [&](int x, int y, int dx, int dy) {
+        int nx = x + dx, ny = y + dy;
+        if (nx >= 0 && nx < w && ny >= 0 && ny < h) return ny * w + nx;
+        if (boundary_condition == 2) return ((ny + h) % h) * w + (nx + w) % w;
+        if (boundary_condition == 1) return y * w + x;
+        return -1;
+    };
+
+    for (int block = 0; block < blocks; block++) {
+        // Settings of every lane, lanes past the last run repeat it and are never shown
+        float a[lanes], b[lanes], D[lanes], dt[lanes], inv_dx2[lanes];
+        for (int k = 0; k < lanes; k++) {
+            const EnsembleMember& m = settings[std::min(block * lanes + k, (int)settings.size() - 1)];
+            a[k] = m.a;
+            b[k] = m.b;
+            D[k] = m.D;
+            dt[k] = advance ? m.dt : 0.0f;
+            inv_dx2[k] = 1.0f / (m.dx * m.dx);
+        }
+
+        size_t offset = (size_t)block * cells * lanes;
+        const float* u = host_u.data() + offset;
+        const float* v = host_v.data() + offset;
+        float* out_u = next_u.data() + offset;
+        float* out_v = next_v.data() + offset;
+        int brush_lane = brush_run / lanes == block ? brush_run % lanes : -1;
+
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                int cell = y * w + x;
+                int n[4] = {neighbour(x, y, -1, 0), neighbour(x, y, 1, 0), neighbour(x, y, 0, -1), neighbour(x, y, 0, 1)};
+                const float* nu[4];
+                const float* nv[4];
+                for (int i = 0; i < 4; i++) {
+                    nu[i] = n[i] < 0 ? zeros : u + (size_t)n[i] * lanes;
+                    nv[i] = n[i] < 0 ? zeros : v + (size_t)n[i] * lanes;
+                }
+                const float* u0 = u + (size_t)cell * lanes;
+                const float* v0 = v + (size_t)cell * lanes;
+                float* u1 = out_u + (size_t)cell * lanes;
+                float* v1 = out_v + (size_t)cell * lanes;
+
+                for (int k = 0; k < lanes; k++) {
+                    float laplacian_u = (nu[0][k] + nu[1][k] + nu[2][k] + nu[3][k] - 4.0f * u0[k]) * inv_dx2[k];
+                    float laplacian_v = (nv[0][k] + nv[1][k] + nv[2][k] + nv[3][k] - 4.0f * v0[k]) * inv_dx2[k];
+                    float reaction = u0[k] * u0[k] * v0[k];
+                    u1[k] = u0[k] + dt[k] * (laplacian_u + reaction - (a[k] + b[k]) * u0[k]);
+                    v1[k] = v0[k] + dt[k] * (D[k] * laplacian_v - reaction + a[k] * (1.0f - v0[k]));
+                }
+
+                if (brush_lane >= 0 && (x - brush_x) * (x - brush_x) + (y - brush_y) * (y - brush_y) <= brush_radius * brush_radius)
+                    u1[brush_lane] = 1.0f;
+            }
+        }
+    }
+
+    host_u.swap(next_u);
+    host_v.swap(next_v);
+    host_dirty = true;
+}
+
+/**
+ * Dispatch the compute shader which advances every run of the ensemble at once. On the CPU backend the runs
+ * are advanced on the host instead, and the shader only draws them when the output image is needed.
+ */
+void GrayScottEnsemble::solve() {
+    if (cpu_backend) {
+        step_cpu();
+        if (!render_image) return;
+        sync();
+    }
+    glDispatchCompute((width / columns + 7) / 8, (height / rows + 7) / 8, members());
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+/**
+ * Render the GUI for this specific equation
+ */
+void GrayScottEnsemble::gui() {
+    ImGui::Text("Runs: %d (%d x %d cells each)", members(), width / columns, height / rows);
+    int layout[2] = {columns, rows};
+    ImGui::Text("Columns x Rows (Enter to Apply)");
+    if (ImGui::InputInt2("##Layout", layout, ImGuiInputTextFlags_EnterReturnsTrue))
+        set_layout(std::clamp(layout[0], 1, 32), std::clamp(layout[1], 1, 32));
+    bool cpu = cpu_backend;
+    if (ImGui::Checkbox("Advance on CPU (One Run per SIMD Lane)", &cpu)) set_backend(cpu);
+    ImGui::Text("Feed Rate (a) of First and Last Column");
+    ImGui::SliderFloat("##a_min", &a_min, 0.0, 0.1);
+    ImGui::SliderFloat("##a_max", &a_max, 0.0, 0.1);
+    ImGui::Text("Kill Rate (b) of First and Last Row");
+    ImGui::SliderFloat("##b_min", &b_min, 0.0, 0.1);
+    ImGui::SliderFloat("##b_max", &b_max, 0.0, 0.1);
+    ImGui::Text("Diffusion (D)");
+    ImGui::SliderFloat("##D", &D, 0.0, 2.0);
+    ImGui::Text("Visible Layer");
+    ImGui::Combo("##Visible Layer", &visible_layer, layer_strs.data(), layer_strs.size());
+}
+
+/**
+ * Reset all simulation specific settings to default
+ */
+void GrayScottEnsemble::reset_settings() {
+    a_min = 0.01f;
+    a_max = 0.07f;
+    b_min = 0.045f;
+    b_max = 0.07f;
+    D = 2.0f;
+    visible_layer = 0;
+    space_step = 5.0f;
+    time_step = 0.5f;
+    boundary_condition = 0;
+}
+
+/**
+ * Send the uniforms for this simulation to the compute shader, and the settings of every run to the SSBO
+ * 
+ * @param cmap_str String representing a color map to use
+ * @param paused Is the simulation paused?
+ */
+void GrayScottEnsemble::set_uniforms(std::string cmap_str, bool paused) {
+    std::vector<EnsembleMember> current = build_members();
+    if (current.size() != uploaded.size() || !std::equal(current.begin(), current.end(), uploaded.begin(), [](const EnsembleMember& x, const EnsembleMember& y) {
+            return x.a == y.a && x.b == y.b && x.D == y.D && x.dt == y.dt && x.dx == y.dx;
+        })) {
+        glNamedBufferSubData(member_buffer.ID, 0, current.size() * sizeof(EnsembleMember), current.data());
+        uploaded = current;
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, member_buffer.ID);
+
+    // The CPU backend advances the runs and applies the brush itself, the shader then only draws them
+    advance = !paused;
+    ensembleCS.bind();
+    ensembleCS.set_bool("paused", paused || cpu_backend);
+    ensembleCS.set_bool("render_image", render_image);
+    ensembleCS.set_int("width", width / columns);
+    ensembleCS.set_int("height", height / rows);
+    ensembleCS.set_int("columns", columns);
+    ensembleCS.set_int("boundary_condition", boundary_condition);
+
+    ensembleCS.set_int("visible_layer", visible_layer);
+    ensembleCS.set_int("brush_enabled", cpu_backend ? 0 : brush_enabled);
+    ensembleCS.set_int("x_pos", x_pos);
+    ensembleCS.set_int("y_pos", y_pos);
+    ensembleCS.set_int("brush_radius", brush_radius);
+    apply_cmap(ensembleCS, cmap_str);
+}
\ No newline at end of file
@@ -1,12 +1,29 @@
 #include <glad/glad.h>
 
 #include "grid.hpp"
+#include "shader.hpp"
+#include "compress.hpp"
+#include "runge_kutta.hpp"
+#include "reduction.hpp"
 
 #include <algorithm>
 #include <iostream>
 #include <cmath>
 #include <algorithm>
 
+/**
+ * Computes the length of a full mip chain for a texture
+ * 
+ * @param width Width of the base level
+ * @param height Height of the base level
+ * @return Number of levels down to and including 1x1
+ */
+int mip_levels(int width, int height) {
+    int levels = 1;
+    while ((std::max(width, height) >> levels) > 0) levels++;
+    return levels;
+}
+
 /**
  * Constructs a new 2D grid with a given width and height and number of layers. Each layer corresponds to a 2D R32F texture.
  * 
@@ -22,86 +39,612 @@ Grid::Grid(int width, int height, int num_layers) {
     brush_enabled = 0;
     x_pos = 0;
     y_pos = 0;
+    brush_layer = 0;
+    visible_layer = 0;
     space_step = 3.0f;
     time_step = 0.1f;
     brush_radius = 10;
     resolution = 8;
     pixelated = false;
+    resample_filter = 0;
+    fields_supported = false;
+    stencils_supported = false;
+    stencil_order = 2;
+    integrator_strs = {"Forward Euler"};
+    integrator = 0;
+    first_runge_kutta = -1;
+    cpu_backend = false;
+    adaptive_supported = false;
+    adaptive_time_step = false;
+    safety = 0.8f;
+    max_time_step = 10.0f;
+    adapt_every = 4;
+    steps_until_adapt = 0;
+    limited_by = "";
+    steady_supported = false;
+    steady_state = false;
+    steady_tolerance = 1e-4f;
+    steady_norm = 1;
+    residual_every = 10;
+    steps_until_residual = 0;
+    converged = false;
 
-    // Initialize the output image texture
-	glGenTextures(1, &image);
-	glBindTexture(GL_TEXTURE_2D, image);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, pixelated ? GL_NEAREST : GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, width, height);
-	glBindImageTexture(0, image, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
-
-    // Initialize the texture for each layer
-    std::vector<float> initial_data = std::vector<float>(width * height, 0.0);
-    layers = std::vector<unsigned int>(num_layers);
-    for (int i = 0; i < layers.size(); i++) {
-        glGenTextures(1, &layers[i]);
-        glBindTexture(GL_TEXTURE_2D, layers[i]);
-        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, width, height);
-        glBindImageTexture(i+1, layers[i], 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+    render_image = true;
+    resident = true;
+    revision = 0;
+    columns = 1;
+    rows = 1;
+
+    allocate(num_layers);
+    clear();
+}
+
+/**
+ * Returns all textures to the pool so that other grids can reuse them
+ */
+Grid::~Grid() {
+    texture_pool().release(std::move(image));
+    for (Texture& layer : layers) texture_pool().release(std::move(layer));
+    for (auto& kp : parameter_fields) texture_pool().release(std::move(kp.second.texture));
+}
+
+/**
+ * Hands the current textures back to the pool and acquires ones matching the current dimensions.
+ * The contents of the new textures are undefined until the grid is cleared. A grid without a size holds no textures.
+ * 
+ * @param num_layers Number of layer textures to acquire
+ */
+void Grid::allocate(int num_layers) {
+    TexturePool& pool = texture_pool();
+
+    pool.release(std::move(image));
+    for (Texture& layer : layers) pool.release(std::move(layer));
+    layers.resize(num_layers);
+    if (width <= 0 || height <= 0) return;
+
+    // The output image has a mip chain that is filled in when the view is zoomed out
+    image = pool.acquire(GL_RGBA8, width, height, mip_levels(width, height));
+    glTextureParameteri(image.ID, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(image.ID, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    set_pixelated();
+
+    // Ensembles store every layer as an array with one slice per run, each slice covering one tile of the output image
+    for (int i = 0; i < layers.size(); i++)
+        layers[i] = pool.acquire(GL_R32F, width / columns, height / rows, 1, members() > 1 ? members() : 0);
+    bind();
+}
+
+/**
+ * @return The number of independent runs advanced together by the grid
+ */
+int Grid::members() const {
+    return columns * rows;
+}
+
+/**
+ * Resamples a layer texture into another texture of a different size on the GPU
+ * 
+ * @param src ID of the layer texture at its old size
+ * @param dst ID of the layer texture at its new size
+ * @param width Width of the destination texture
+ * @param height Height of the destination texture
+ * @param filter 0 for bilinear interpolation, 1 for a conservative area average
+ */
+void resample_layer(unsigned int src, unsigned int dst, int width, int height, int filter) {
+    // Shared by every grid, created on first use since it needs a current OpenGL context
+    static ComputeShader resampleCS("shaders/resample.glsl");
+    static unsigned int sampler = 0;
+    if (sampler == 0) {
+        glCreateSamplers(1, &sampler);
+        glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     }
+
+    resampleCS.bind();
+    resampleCS.set_int("src", 0);
+    resampleCS.set_int("filter_mode", filter);
+    glBindTextureUnit(0, src);
+    glBindSampler(0, sampler);
+    glBindImageTexture(1, dst, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    glBindSampler(0, 0);
 }
 
 /**
- * Resizes all textures to the specified dimensions
+ * Resizes all textures to the specified dimensions, resampling every layer so that the simulation carries on.
+ * Nothing is reallocated if the dimensions are unchanged, and textures of the old size go back to the pool.
  * 
  * @param width Width to resize the grids to
  * @param height Height to resize the grids to
  */
 void Grid::resize(int width, int height) {
+    // Every run of an ensemble covers an equally sized tile of the output image
+    width = std::max(columns, width / columns * columns);
+    height = std::max(rows, height / rows * rows);
+    if (width == this->width && height == this->height) return;
+    restore();
+    sync();
+
+    Texture old_image = std::move(image);
+    std::vector<Texture> old_layers = std::move(layers);
+    bool had_data = this->width > 0 && this->height > 0;
+
     this->width = width;
     this->height = height;
+    allocate(old_layers.size());
     clear();
+
+    if (had_data) {
+        for (int i = 0; i < layers.size(); i++) {
+            if (old_layers[i].depth == 0) {
+                resample_layer(old_layers[i].ID, layers[i].ID, width, height, resample_filter);
+                continue;
+            }
+
+            // Each slice of an array is resampled through a pair of 2D views
+            for (int member = 0; member < old_layers[i].depth; member++) {
+                unsigned int views[2];
+                glGenTextures(2, views);
+                glTextureView(views[0], GL_TEXTURE_2D, old_layers[i].ID, GL_R32F, 0, 1, member, 1);
+                glTextureView(views[1], GL_TEXTURE_2D, layers[i].ID, GL_R32F, 0, 1, member, 1);
+                resample_layer(views[0], views[1], layers[i].width, layers[i].height, resample_filter);
+                glDeleteTextures(2, views);
+            }
+        }
+    }
+    texture_pool().release(std::move(old_image));
+    for (Texture& layer : old_layers) texture_pool().release(std::move(layer));
+    upload_parameter_fields();
+    bind();
 }
 
 /**
- * Clears all textures to 0
+ * Clears all textures to 0 in place, then writes the initial state of any layer that has one
  */
 void Grid::clear() {
-    glGenTextures(1, &image);
-    glBindTexture(GL_TEXTURE_2D, image);
-	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, width, height);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, pixelated ? GL_NEAREST : GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glBindImageTexture(0, image, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+    revision++;
+    image.clear();
+    for (Texture& layer : layers) layer.clear();
+    converged = false;
+    residual_l2.clear();
+    residual_max.clear();
+    steps_until_residual = 0;
+
+    for (int i = 0; i < initial_state.size() && i < layers.size(); i++)
+        if (!initial_state[i].empty() && initial_state[i].size() == width * height) write_layer(i, initial_state[i]);
+}
+
+/**
+ * Turns this grid into a copy of another grid of the same PDE: settings, parameters, backend, size and the contents of every layer.
+ * PDEs with settings outside of parameters and options copy those in their override.
+ * 
+ * @param other The grid to copy, must be resident
+ */
+void Grid::copy_from(const Grid& other) {
+    columns = other.columns;
+    rows = other.rows;
+    resolution = other.resolution;
+    space_step = other.space_step;
+    time_step = other.time_step;
+    boundary_condition = other.boundary_condition;
+    brush_radius = other.brush_radius;
+    brush_layer = other.brush_layer;
+    visible_layer = other.visible_layer;
+    resample_filter = other.resample_filter;
+    integrator = other.integrator;
+    adaptive_time_step = other.adaptive_time_step;
+    safety = other.safety;
+    max_time_step = other.max_time_step;
+    adapt_every = other.adapt_every;
+    steady_state = other.steady_state;
+    steady_tolerance = other.steady_tolerance;
+    steady_norm = other.steady_norm;
+    residual_every = other.residual_every;
+    pixelated = other.pixelated;
+    for (const auto& parameter : other.parameters) {
+        auto it = parameters.find(parameter.first);
+        if (it != parameters.end()) *it->second = *parameter.second;
+    }
+    for (const auto& option : other.options) {
+        auto it = options.find(option.first);
+        if (it != options.end()) *it->second.value = *option.second.value;
+    }
+    for (const auto& kp : other.parameter_fields) {
+        ParameterField& field = parameter_fields[kp.first];
+        field.axis = kp.second.axis;
+        field.from = kp.second.from;
+        field.to = kp.second.to;
+        field.data = kp.second.data;
+        field.data_width = kp.second.data_width;
+        field.data_height = kp.second.data_height;
+    }
+    initial_state = other.initial_state;
+    stencil_order = other.stencil_order;
+    if (!other.parameter_fields.empty() || stencil_order != 2) compile_shaders();
+    set_backend(other.cpu_backend);
+
+    // Every layer is overwritten below, so the textures are allocated once at the new size instead of resampled
+    restore();
+    width = other.width;
+    height = other.height;
+    allocate(layers.size());
+    upload_parameter_fields();
+    revision++;
+    for (int i = 0; i < layers.size() && i < other.layers.size(); i++) {
+        unsigned int target = layers[i].depth > 0 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+        glCopyImageSubData(other.layers[i].ID, target, 0, 0, 0, 0, layers[i].ID, target, 0, 0, 0, 0,
+                           layers[i].width, layers[i].height, std::max(1, layers[i].depth));
+    }
+}
+
+/**
+ * Appends every Runge-Kutta method to the integrators of the PDE, which then has to implement evaluate_rates
+ */
+void Grid::add_runge_kutta_methods() {
+    first_runge_kutta = integrator_strs.size();
+    for (const ButcherTableau& method : runge_kutta_methods()) integrator_strs.push_back(method.name);
+}
+
+/**
+ * @return Index of the selected Runge-Kutta method in runge_kutta_methods(), or -1 if another integrator is selected
+ */
+int Grid::runge_kutta_method() const {
+    if (first_runge_kutta < 0 || integrator < first_runge_kutta) return -1;
+    return integrator - first_runge_kutta;
+}
+
+/**
+ * @return How far the stability region of the selected explicit integrator reaches along the negative real axis: a step is
+ * stable while dt times the fastest decay rate of the discretized PDE stays below it. Forward Euler unless a Runge-Kutta
+ * method is selected, PDEs with implicit integrators check for those first.
+ */
+float Grid::stability_extent() const {
+    int method = runge_kutta_method();
+    return method >= 0 ? runge_kutta_methods()[method].stability : 2.0f;
+}
+
+/**
+ * Every adapt_every steps, sets the time step to a fraction of the largest stable time step of the current state.
+ * The step shrinks at once when the limit drops but only grows by a quarter per estimate, so a single quiet estimate,
+ * e.g. right after a reset, cannot throw the step far beyond what the next state allows.
+ *
+ * @return True if an estimate ran, its passes use their own bindings so the grid has to be bound and its uniforms sent again
+ */
+bool Grid::adapt_time_step() {
+    if (!adaptive_supported || !adaptive_time_step) return false;
+    if (steps_until_adapt-- > 0) return false;
+    steps_until_adapt = adapt_every - 1;
 
+    float limit = stable_time_step();
+    if (safety * limit >= max_time_step) limited_by = "the max time step";
+    time_step = std::min({safety * limit, 1.25f * time_step, max_time_step});
+    return true;
+}
+
+/**
+ * Every residual_every steps, keeps a copy of the layers so that finish_residual can measure how much the next step changes
+ * them. The copies come from the texture pool and go back to it right after the step.
+ *
+ * @return True if the next step is measured, finish_residual has to be called once it ran
+ */
+bool Grid::start_residual() {
+    if (!steady_supported || !steady_state) return false;
+    if (steps_until_residual-- > 0) return false;
+    steps_until_residual = residual_every - 1;
+
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+    for (const Texture& layer : layers) {
+        Texture copy = texture_pool().acquire(GL_R32F, width, height);
+        glCopyImageSubData(layer.ID, GL_TEXTURE_2D, 0, 0, 0, 0, copy.ID, GL_TEXTURE_2D, 0, 0, 0, 0, width, height, 1);
+        residual_base.push_back(std::move(copy));
+    }
+    return true;
+}
+
+/**
+ * Reduces the change of every layer over the measured step on the GPU and appends its norms per unit time to the history.
+ * Only the last 1000 residuals are kept for the plot.
+ *
+ * @param reduction Computes the norms, shared by every grid
+ * @return True if the residual just fell below the tolerance
+ */
+bool Grid::finish_residual(Reduction& reduction) {
+    std::vector<const Texture*> current, previous;
     for (int i = 0; i < layers.size(); i++) {
-        glGenTextures(1, &layers[i]);
-        glBindTexture(GL_TEXTURE_2D, layers[i]);
-        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, width, height);
-        glBindImageTexture(i+1, layers[i], 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+        current.push_back(&layers[i]);
+        previous.push_back(&residual_base[i]);
     }
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    Norms norms = reduction.difference_norms(current, previous);
+    for (Texture& copy : residual_base) texture_pool().release(std::move(copy));
+    residual_base.clear();
+
+    residual_l2.push_back(norms.l2 / time_step);
+    residual_max.push_back(norms.max / time_step);
+    if (residual_l2.size() > 1000) {
+        residual_l2.erase(residual_l2.begin());
+        residual_max.erase(residual_max.begin());
+    }
+
+    bool was_converged = converged;
+    converged = (steady_norm == 0 ? residual_l2.back() : residual_max.back()) < steady_tolerance;
+    return converged && !was_converged;
+}
+
+/**
+ * @return The largest stable time step of the current state, infinite for PDEs without an estimate
+ */
+float Grid::stable_time_step() {
+    limited_by = "";
+    return INFINITY;
+}
+
+/**
+ * Makes a parameter vary linearly across the grid, e.g. the feed rate along x and the kill rate along y of Gray-Scott
+ * 
+ * @param name Name of the parameter, see Grid::parameters
+ * @param axis 0 to vary along x, 1 to vary along y
+ * @param from Value at the first column or row
+ * @param to Value at the last column or row
+ */
+void Grid::set_parameter_ramp(const std::string& name, int axis, float from, float to) {
+    ParameterField& field = parameter_fields[name];
+    field.axis = axis;
+    field.from = from;
+    field.to = to;
+    field.data.clear();
+    upload_parameter_fields();
+    compile_shaders();
+}
+
+/**
+ * Gives a parameter explicit per-cell values
+ * 
+ * @param name Name of the parameter, see Grid::parameters
+ * @param data Values in row-major order
+ * @param data_width Number of columns in data, resampled to the width of the grid
+ * @param data_height Number of rows in data, resampled to the height of the grid
+ */
+void Grid::set_parameter_data(const std::string& name, const std::vector<float>& data, int data_width, int data_height) {
+    ParameterField& field = parameter_fields[name];
+    field.axis = 2;
+    field.data = data;
+    field.data_width = data_width;
+    field.data_height = data_height;
+    upload_parameter_fields();
+    compile_shaders();
+}
+
+/**
+ * Goes back to a single uniform value for a parameter
+ * 
+ * @param name Name of the parameter, see Grid::parameters
+ */
+void Grid::remove_parameter_field(const std::string& name) {
+    auto it = parameter_fields.find(name);
+    if (it == parameter_fields.end()) return;
+    texture_pool().release(std::move(it->second.texture));
+    parameter_fields.erase(it);
+    compile_shaders();
+}
+
+/**
+ * Finds the largest magnitude of a parameter from the settings of its field on the CPU, without reading the GPU
+ *
+ * @param name Name of the parameter, see Grid::parameters
+ * @param value The uniform value of the parameter, used if it has no field
+ * @return The largest absolute value of the parameter over the grid
+ */
+float Grid::largest_parameter(const std::string& name, float value) const {
+    auto it = parameter_fields.find(name);
+    if (it == parameter_fields.end()) return std::abs(value);
+    const ParameterField& field = it->second;
+    if (field.axis < 2) return std::max(std::abs(field.from), std::abs(field.to));
+    float largest = 0.0f;
+    for (float x : field.data) largest = std::max(largest, std::abs(x));
+    return largest;
+}
+
+/**
+ * Rebuilds the texture of every parameter field at the current size of the grid
+ */
+void Grid::upload_parameter_fields() {
+    for (auto& kp : parameter_fields) {
+        ParameterField& field = kp.second;
+        texture_pool().release(std::move(field.texture));
+        if (width <= 0 || height <= 0) continue;
+        field.texture = texture_pool().acquire(GL_R32F, width, height);
+
+        if (field.axis == 2) {
+            Texture source = texture_pool().acquire(GL_R32F, field.data_width, field.data_height);
+            glTextureSubImage2D(source.ID, 0, 0, 0, field.data_width, field.data_height, GL_RED, GL_FLOAT, field.data.data());
+            resample_layer(source.ID, field.texture.ID, width, height, 0);
+            texture_pool().release(std::move(source));
+            continue;
+        }
+
+        std::vector<float> values(width * height);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                float t = field.axis == 0 ? (width > 1 ? (float)x / (width - 1) : 0.0f) : (height > 1 ? (float)y / (height - 1) : 0.0f);
+                values[y * width + x] = field.from + t * (field.to - field.from);
+            }
+        }
+        glTextureSubImage2D(field.texture.ID, 0, 0, 0, width, height, GL_RED, GL_FLOAT, values.data());
+    }
+}
+
+/**
+ * Binds the parameter fields to the samplers named <name>_field, using texture units from 4 upwards
+ * 
+ * @param shader The compute shader of the grid, already bound
+ */
+void Grid::bind_parameter_fields(AbstractShader& shader) {
+    int unit = 4;
+    for (auto& kp : parameter_fields) {
+        glBindTextureUnit(unit, kp.second.texture.ID);
+        shader.set_int(kp.first + "_field", unit);
+        unit++;
+    }
+}
+
+/**
+ * @return The #define lines selecting the per-cell variant of every parameter that has a field, and STENCIL_ORDER for the
+ * wider stencils
+ */
+std::string Grid::shader_defines() const {
+    std::string defines;
+    for (const auto& kp : parameter_fields) defines += "#define FIELD_" + kp.first + "\n";
+    if (stencil_order > 2) defines += "#define STENCIL_ORDER " + std::to_string(stencil_order) + "\n";
+    return defines;
+}
+
+/**
+ * Switches the explicit stencils to another order of accuracy and recompiles the shaders. Wider stencils reach 2 or 3
+ * cells past the edges, where Neumann grids mirror the cells inside and Dirichlet grids mirror them with the opposite
+ * sign, so only periodic grids keep the full order right up to the edges.
+ *
+ * @param order 2 for the 5 point stencils, 4 or 6 for the wider ones
+ */
+void Grid::set_stencil_order(int order) {
+    if (order == stencil_order) return;
+    stencil_order = order;
+    compile_shaders();
+}
+
+/**
+ * @return Coefficients of the centered second difference of the selected order times dx^2, from the center outwards.
+ * The shaders hold the same table as SECOND.
+ */
+std::vector<float> Grid::second_difference() const {
+    if (stencil_order == 6) return {-49.0f / 18.0f, 3.0f / 2.0f, -3.0f / 20.0f, 1.0f / 90.0f};
+    if (stencil_order == 4) return {-5.0f / 2.0f, 4.0f / 3.0f, -1.0f / 12.0f};
+    return {-2.0f, 1.0f};
+}
+
+/**
+ * @return How much faster the wider laplacians decay their fastest mode than the 5 point stencil: 1, 4/3 and 68/45.
+ * Explicit stability limits of diffusions shrink by this factor and those of waves by its square root.
+ */
+float Grid::laplacian_scale() const {
+    std::vector<float> second = second_difference();
+    float checkerboard = second[0];
+    for (int k = 1; k < second.size(); k++) checkerboard += 2.0f * (k % 2 ? -second[k] : second[k]);
+    return -checkerboard / 4.0f;
+}
+
+/**
+ * Chooses whether the solver runs on the GPU or the CPU
+ * 
+ * @param cpu True to run on the CPU
+ * @return False if the PDE has no CPU solver
+ */
+bool Grid::set_backend(bool cpu) {
+    return !cpu;
+}
+
+/**
+ * Moves the contents of every layer to compressed host memory and gives the textures back to the pool.
+ * The output image is not kept since the next step regenerates it.
+ */
+void Grid::evict() {
+    if (!resident) return;
+    sync();
+
+    evicted_layers.resize(layers.size());
+    for (int i = 0; i < layers.size(); i++) evicted_layers[i] = compress_floats(read_layer(i));
+    texture_pool().release(std::move(image));
+    for (Texture& layer : layers) texture_pool().release(std::move(layer));
+    for (auto& kp : parameter_fields) texture_pool().release(std::move(kp.second.texture));
+    resident = false;
+}
+
+/**
+ * Reacquires the textures of an evicted grid and uploads the layers it had when it was evicted
+ */
+void Grid::restore() {
+    if (resident) return;
+
+    allocate(evicted_layers.size());
+    image.clear();
+    for (int i = 0; i < layers.size(); i++) write_layer(i, decompress_floats(evicted_layers[i], width * height));
+    evicted_layers.clear();
+    upload_parameter_fields();
+    resident = true;
+    bind();
+}
+
+/**
+ * @return The amount of video memory held by the grid's textures
+ */
+size_t Grid::bytes() const {
+    size_t total = image.bytes();
+    for (const Texture& layer : layers) total += layer.bytes();
+    for (const auto& kp : parameter_fields) total += kp.second.texture.bytes();
+    return total;
 }
 
 /**
  * Changes the magnification filter of the image texture.
  * In effect, GL_NEAREST will make the image look pixelated while GL_LINEAR will smoothen it out.
+ * The minification filter follows along so that zoomed out views are consistent.
  */
 void Grid::set_pixelated() {
-    glBindTexture(GL_TEXTURE_2D, image);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, pixelated ? GL_NEAREST : GL_LINEAR);
+	glTextureParameteri(image.ID, GL_TEXTURE_MAG_FILTER, pixelated ? GL_NEAREST : GL_LINEAR);
+	glTextureParameteri(image.ID, GL_TEXTURE_MIN_FILTER, pixelated ? GL_NEAREST_MIPMAP_NEAREST : GL_LINEAR_MIPMAP_LINEAR);
 }
 
 /**
  * Binds all textures to the current OpenGL state
  */
 void Grid::bind() {
-    glBindTexture(GL_TEXTURE_2D, image);
-	glBindImageTexture(0, image, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+    glBindTexture(GL_TEXTURE_2D, image.ID);
+	glBindImageTexture(0, image.ID, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA8);
 
-    for (int i = 0; i < layers.size(); i++) {
-        glBindTexture(GL_TEXTURE_2D, layers[i]);
-        glBindImageTexture(i+1, layers[i], 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
-    }
+    for (int i = 0; i < layers.size(); i++)
+        glBindImageTexture(i+1, layers[i].ID, 0, layers[i].depth > 0 ? GL_TRUE : GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+}
+
+/**
+ * Reads the contents of a layer back from the GPU
+ * 
+ * @param layer Index of the layer to read
+ * @return The scalar field of the layer in row-major order, one run after another for ensembles
+ */
+std::vector<float> Grid::read_layer(int layer) {
+    sync();
+    std::vector<float> data(width * height);
+    glGetTextureImage(layers[layer].ID, 0, GL_RED, GL_FLOAT, data.size() * sizeof(float), data.data());
+    return data;
+}
+
+/**
+ * Reads the output image back from the GPU
+ * 
+ * @return The RGBA colors of the output image in row-major order
+ */
+std::vector<float> Grid::read_image() {
+    sync();
+    std::vector<float> data(width * height * 4);
+    glGetTextureImage(image.ID, 0, GL_RGBA, GL_FLOAT, data.size() * sizeof(float), data.data());
+    return data;
+}
+
+/**
+ * Uploads the contents of a layer to the GPU
+ * 
+ * @param layer Index of the layer to write
+ * @param data The scalar field in row-major order, must contain width * height values (one run after another for ensembles)
+ */
+void Grid::write_layer(int layer, const std::vector<float>& data) {
+    sync();
+    revision++;
+    const Texture& texture = layers[layer];
+    if (texture.depth > 0) glTextureSubImage3D(texture.ID, 0, 0, 0, 0, texture.width, texture.height, texture.depth, GL_RED, GL_FLOAT, data.data());
+    else glTextureSubImage2D(texture.ID, 0, 0, 0, width, height, GL_RED, GL_FLOAT, data.data());
 }
 
 /**
@@ -5,18 +5,133 @@
 #include "heat.hpp"
 #include "sandbox.hpp"
 
+#include <cmath>
 #include <iostream>
 
 Heat::Heat(int width, int height) 
     : heatCS("shaders/heat.glsl"), Grid(width, height, 1)
 {
+    parameters = {{"diffusion", &diffusion}};
+    fields_supported = true;
+    stencils_supported = true;
+    integrator_strs = {"Forward Euler", "Backward Euler", "Crank-Nicolson", "Spectral", "RKL2"};
+    add_runge_kutta_methods();
+    adaptive_supported = true;
+    steady_supported = true;
+    advance = true;
     reset_settings();
 }
 
 /**
- * Dispatch the compute shader which solves the equation
+ * @return True if the spectral integrator can advance the grid, which needs periodic boundaries and a uniform diffusion.
+ * Otherwise it falls back to Crank-Nicolson.
+ */
+bool Heat::spectral() const {
+    return integrator == 3 && boundary_condition == 2 && !parameter_fields.count("diffusion");
+}
+
+/**
+ * @return True if the Runge-Kutta-Legendre super time steps advance the solution
+ */
+bool Heat::super() const {
+    return integrator == 4;
+}
+
+/**
+ * Advances the solution exactly on the CPU: the heat equation decouples into Fourier modes that each decay at their own rate,
+ * so any time step is stable and accurate up to the resolution of the grid
+ */
+void Heat::step_spectral() {
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+    std::vector<float> u = read_layer(0);
+    fft.resize(width, height);
+    fft.forward(u.data());
+
+    std::vector<float> wavenumbers = fft.squared_wavenumbers(space_step);
+    for (size_t i = 0; i < wavenumbers.size(); i++) {
+        float decay = std::exp(-diffusion * time_step * wavenumbers[i]);
+        fft.spectrum_re[i] *= decay;
+        fft.spectrum_im[i] *= decay;
+    }
+    fft.inverse(u.data());
+    glTextureSubImage2D(layers[0].ID, 0, 0, 0, width, height, GL_RED, GL_FLOAT, u.data());
+}
+
+/**
+ * @return Number of stages of the Runge-Kutta-Legendre integrator whose stable interval covers the time step
+ */
+int Heat::super_stages() const {
+    float euler = space_step * space_step / (4.0f * laplacian_scale() * largest_parameter("diffusion", diffusion));
+    return RungeKutta::super_stages(time_step / euler);
+}
+
+/**
+ * Writes the time derivative of u into the first slice of rates
+ * 
+ * @param rates 2D array texture with a slice per layer
+ */
+void Heat::evaluate_rates(const Texture& rates) {
+    bind();
+    heatCS.bind();
+    bind_parameter_fields(heatCS);
+    heatCS.set_bool("derivative", true);
+    glBindImageTexture(2, rates.ID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R32F);
+    glDispatchCompute(width, height, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    heatCS.set_bool("derivative", false);
+}
+
+/**
+ * The 5 point laplacian decays its fastest mode at up to 8 alpha / dx^2 (the wider stencils faster, see Grid::laplacian_scale), so an explicit step is stable while dt times that
+ * rate stays within the stability region of the integrator. The implicit and spectral integrators are stable at any step.
+ *
+ * @return The largest stable time step
+ */
+float Heat::stable_time_step() {
+    if (runge_kutta_method() < 0 && integrator > 0) {
+        limited_by = "nothing, the integrator is unconditionally stable";
+        return INFINITY;
+    }
+    limited_by = "diffusion";
+    return stability_extent() * space_step * space_step / (8.0f * laplacian_scale() * largest_parameter("diffusion", diffusion));
+}
+
+/**
+ * Dispatch the compute shader which solves the equation. Implicit integrators first advance the solution
+ * with the multigrid solver, the spectral integrator with FFTs and the Runge-Kutta(-Legendre) integrators with their stages,
+ * the shader then only applies the brush and the color map.
  */
 void Heat::solve() {
+    if (spectral() && advance) {
+        step_spectral();
+    } else if (runge_kutta_method() >= 0 && advance) {
+        runge_kutta.step(*this, runge_kutta_methods()[runge_kutta_method()], time_step);
+        bind();
+        heatCS.bind();
+        bind_parameter_fields(heatCS);
+    } else if (super() && advance) {
+        runge_kutta.super_step(*this, time_step, super_stages());
+        bind();
+        heatCS.bind();
+        bind_parameter_fields(heatCS);
+    } else if (integrator > 0 && advance) {
+        float theta = integrator == 1 ? 1.0f : 0.5f;
+        auto field = parameter_fields.find("diffusion");
+
+        multigrid.resize(width, height);
+        multigrid.boundary_condition = boundary_condition;
+        multigrid.dx = space_step;
+        multigrid.identity = 1.0f;
+        multigrid.scale = theta * time_step;
+        multigrid.set_coefficient(field != parameter_fields.end() ? &field->second.texture : nullptr, diffusion);
+        multigrid.evaluate(layers[0], 1.0f, (1.0f - theta) * time_step);
+        multigrid.solve(layers[0], v_cycles);
+
+        // The multigrid passes use their own image bindings
+        bind();
+        heatCS.bind();
+    }
+
     glDispatchCompute(width, height, 1);
     glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 }
@@ -27,6 +142,19 @@ void Heat::solve() {
 void Heat::gui() {
     ImGui::Text("Diffusion");
     ImGui::SliderFloat("##Diffusion", &diffusion, 0.01, 3.0);
+    if (integrator == 3) {
+        ImGui::TextWrapped(spectral() ? "Solved exactly with FFTs on the CPU" : "Needs periodic boundaries and a uniform diffusion, using Crank-Nicolson");
+    }
+    if (runge_kutta_method() >= 0) {
+        runge_kutta.gui(runge_kutta_methods()[runge_kutta_method()]);
+    } else if (super()) {
+        ImGui::Text("Stages: %d", super_stages());
+    } else if (integrator > 0 && !spectral()) {
+        ImGui::Text("V-Cycles per Step");
+        ImGui::SliderInt("##V-Cycles", &v_cycles, 1, 8);
+        bool cpu = cpu_backend;
+        if (ImGui::Checkbox("Solve on CPU", &cpu)) set_backend(cpu);
+    }
 }
 
 /**
@@ -38,6 +166,8 @@ void Heat::reset_settings() {
     space_step = 3.0f;
     time_step = 0.5f;
     boundary_condition = 1;
+    integrator = 0;
+    v_cycles = 2;
 }
 
 /**
@@ -47,8 +177,10 @@ void Heat::reset_settings() {
  * @param paused Is the simulation paused?
  */
 void Heat::set_uniforms(std::string cmap_str, bool paused) {
+    advance = !paused;
     heatCS.bind();
-    heatCS.set_bool("paused", paused);
+    heatCS.set_bool("paused", paused || integrator > 0);
+    heatCS.set_bool("render_image", render_image);
     heatCS.set_int("width", width);
     heatCS.set_int("height", height);
     heatCS.set_int("boundary_condition", boundary_condition);
@@ -60,5 +192,54 @@ void Heat::set_uniforms(std::string cmap_str, bool paused) {
     heatCS.set_int("x_pos", x_pos);
     heatCS.set_int("y_pos", y_pos);
     heatCS.set_int("brush_radius", brush_radius);
+    bind_parameter_fields(heatCS);
     apply_cmap(heatCS, cmap_str);
+}
+
+/**
+ * Recompiles the compute shader so that every parameter with a field is sampled per cell, with the selected stencils
+ */
+void Heat::compile_shaders() {
+    glDeleteProgram(heatCS.ID);
+    heatCS = ComputeShader("shaders/heat.glsl", shader_defines());
+}
+
+/**
+ * Chooses whether the multigrid solver of the implicit integrators runs on the GPU or the CPU
+ * 
+ * @param cpu True to solve on the CPU
+ * @return True, both backends are supported
+ */
+bool Heat::set_backend(bool cpu) {
+    cpu_backend = cpu;
+    multigrid.cpu = cpu;
+    return true;
+}
+
+/**
+ * Copies another heat grid, along with the solver settings that are not parameters
+ * 
+ * @param other The grid to copy, must be resident
+ */
+void Heat::copy_from(const Grid& other) {
+    Grid::copy_from(other);
+    const Heat& heat = static_cast<const Heat&>(other);
+    v_cycles = heat.v_cycles;
+    runge_kutta.tolerance = heat.runge_kutta.tolerance;
+    runge_kutta.substep = heat.runge_kutta.substep;
+}
+
+/**
+ * Evicts the layers and gives the multigrid hierarchy back to the pool, the next implicit step rebuilds it
+ */
+void Heat::evict() {
+    Grid::evict();
+    multigrid.release();
+}
+
+/**
+ * @return The amount of video memory held by the grid's textures and the multigrid hierarchy
+ */
+size_t Heat::bytes() const {
+    return Grid::bytes() + multigrid.bytes();
 }
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "journal.hpp"
+#include "grid.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <cstring>
+
+static_assert(sizeof(BrushEvent) == 16, "BrushEvent must stay tightly packed for the on-disk format");
+
+static const char journal_magic[4] = {'P', 'D', 'E', 'J'};
+static const uint32_t journal_version = 1;
+
+Journal::Journal() {
+    sim = 0;
+    width = 0;
+    height = 0;
+    cursor = 0;
+}
+
+/**
+ * Discards any previously recorded events and starts a new journal
+ *
+ * @param sim Index of the simulation being recorded
+ * @param width Width of the grid being recorded
+ * @param height Height of the grid being recorded
+ */
+void Journal::begin(int sim, int width, int height) {
+    this->sim = sim;
+    this->width = width;
+    this->height = height;
+    events.clear();
+    cursor = 0;
+}
+
+/**
+ * Appends an event to the journal
+ *
+ * @param step Index of the simulation step the event is applied before
+ * @param kind Whether the brush was applied, lifted, or the grid was cleared
+ * @param x_pos The x coordinate in grid space that was passed to the brush
+ * @param y_pos The y coordinate in grid space that was passed to the brush
+ * @param grid The grid the event was applied to, used to capture the brush radius and layer
+ */
+void Journal::record(uint32_t step, BrushEventKind kind, int x_pos, int y_pos, const Grid& grid) {
+    BrushEvent event;
+    event.step = step;
+    event.x_pos = x_pos;
+    event.y_pos = y_pos;
+    event.radius = (uint16_t)grid.brush_radius;
+    event.layer = (uint8_t)grid.brush_layer;
+    event.kind = kind;
+    events.push_back(event);
+}
+
+/**
+ * Applies the events recorded for the given step (and any that were skipped before it) to the grid. The step only advances
+ * while the simulation runs, so strokes painted while paused share a step: replay stops after each of them, and the caller
+ * runs a paused frame to paint it before asking for the rest.
+ *
+ * @param step Index of the simulation step that is about to run
+ * @param grid The grid to apply the events to
+ * @return True if events for this step remain, the step must then not advance yet
+ */
+bool Journal::replay(uint32_t step, Grid& grid) {
+    while (cursor < events.size() && events[cursor].step <= step) {
+        const BrushEvent& event = events[cursor++];
+        grid.brush_radius = event.radius;
+        grid.brush_layer = event.layer;
+
+        if (event.kind == BrushEventKind::Stroke) {
+            grid.brush(event.x_pos, event.y_pos);
+            if (cursor < events.size() && events[cursor].step <= step) return true;
+        } else if (event.kind == BrushEventKind::Release) {
+            grid.brush_enabled = 0;
+        } else if (event.kind == BrushEventKind::Clear) {
+            grid.brush_enabled = 0;
+            grid.clear();
+        }
+    }
+    return false;
+}
+
+/**
+ * Moves the replay cursor back to the first event
+ */
+void Journal::rewind() {
+    cursor = 0;
+}
+
+/**
+ * @return True if every event has been replayed
+ */
+bool Journal::finished() const {
+    return cursor >= events.size();
+}
+
+/**
+ * @return The step index of the last recorded event, or 0 if the journal is empty
+ */
+uint32_t Journal::last_step() const {
+    return events.empty() ? 0 : events.back().step;
+}
+
+/**
+ * Writes the journal to a compact binary file (native endianness)
+ *
+ * @param path Path of the file to write
+ * @return True if the file was written successfully
+ */
+bool Journal::save(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cout << "Could not open journal " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    int32_t header[3] = {sim, width, height};
+    uint32_t count = (uint32_t)events.size();
+    file.write(journal_magic, sizeof(journal_magic));
+    file.write((const char*)&journal_version, sizeof(journal_version));
+    file.write((const char*)header, sizeof(header));
+    file.write((const char*)&count, sizeof(count));
+    file.write((const char*)events.data(), events.size() * sizeof(BrushEvent));
+    return (bool)file;
+}
+
+/**
+ * Reads a journal previously written by Journal::save
+ *
+ * @param path Path of the file to read
+ * @return True if the file was read successfully
+ */
+bool Journal::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cout << "Could not open journal " << path << std::endl;
+        return false;
+    }
+
+    char magic[4];
+    uint32_t version, count;
+    int32_t header[3];
+    file.read(magic, sizeof(magic));
+    file.read((char*)&version, sizeof(version));
+    if (!file || std::memcmp(magic, journal_magic, sizeof(magic)) != 0 || version != journal_version) {
+        std::cout << path << " is not a valid journal" << std::endl;
+        return false;
+    }
+
+    file.read((char*)header, sizeof(header));
+    file.read((char*)&count, sizeof(count));
+    events.resize(count);
+    file.read((char*)events.data(), count * sizeof(BrushEvent));
+    if (!file) {
+        std::cout << "Journal " << path << " is truncated" << std::endl;
+        events.clear();
+        return false;
+    }
+
+    sim = header[0];
+    width = header[1];
+    height = header[2];
+    cursor = 0;
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,211 @@
+#include "json.hpp"
+
+#include <cstdlib>
+#include <cctype>
+
+JsonValue::JsonValue() {
+    type = JsonType::Null;
+    boolean = false;
+    number = 0.0;
+}
+
+bool JsonValue::is_null() const { return type == JsonType::Null; }
+bool JsonValue::is_number() const { return type == JsonType::Number; }
+bool JsonValue::is_string() const { return type == JsonType::String; }
+bool JsonValue::is_array() const { return type == JsonType::Array; }
+bool JsonValue::is_object() const { return type == JsonType::Object; }
+
+/**
+ * Looks up a member of an object
+ *
+ * @param key Name of the member
+ * @return A pointer to the member, or nullptr if this is not an object or the member does not exist
+ */
+const JsonValue* JsonValue::find(const std::string& key) const {
+    for (const auto& member : object)
+        if (member.first == key) return &member.second;
+    return nullptr;
+}
+
+/**
+ * @return The number stored under key, or fallback if it is missing or not a number
+ */
+double JsonValue::get_number(const std::string& key, double fallback) const {
+    const JsonValue* value = find(key);
+    return value && value->type == JsonType::Number ? value->number : fallback;
+}
+
+/**
+ * @return The string stored under key, or fallback if it is missing or not a string
+ */
+std::string JsonValue::get_string(const std::string& key, const std::string& fallback) const {
+    const JsonValue* value = find(key);
+    return value && value->type == JsonType::String ? value->string : fallback;
+}
+
+/**
+ * @return The boolean stored under key, or fallback if it is missing or not a boolean
+ */
+bool JsonValue::get_bool(const std::string& key, bool fallback) const {
+    const JsonValue* value = find(key);
+    return value && value->type == JsonType::Bool ? value->boolean : fallback;
+}
+
+// Recursive descent parser over a JSON document
+class JsonParser {
+public:
+    const std::string& text;
+    size_t pos;
+    std::string error;
+
+    JsonParser(const std::string& text) : text(text), pos(0) {}
+
+    // Records the first error along with the line it occurred on
+    bool fail(const std::string& message) {
+        if (error.empty()) {
+            int line = 1;
+            for (size_t i = 0; i < pos && i < text.size(); i++)
+                if (text[i] == '\n') line++;
+            error = "line " + std::to_string(line) + ": " + message;
+        }
+        return false;
+    }
+
+    // Skips whitespace as well as // line comments, which are handy in hand-written scenario files
+    void skip_whitespace() {
+        while (pos < text.size()) {
+            if (std::isspace((unsigned char)text[pos])) {
+                pos++;
+            } else if (text.compare(pos, 2, "//") == 0) {
+                while (pos < text.size() && text[pos] != '\n') pos++;
+            } else {
+                break;
+            }
+        }
+    }
+
+    bool parse_literal(const char* literal) {
+        std::string word(literal);
+        if (text.compare(pos, word.size(), word) != 0) return fail("unexpected token");
+        pos += word.size();
+        return true;
+    }
+
+    bool parse_string(std::string& out) {
+        pos++; // Opening quote
+        while (pos < text.size() && text[pos] != '"') {
+            char c = text[pos++];
+            if (c == '\\') {
+                if (pos >= text.size()) break;
+                char escaped = text[pos++];
+                switch (escaped) {
+                    case 'n': out += '\n'; break;
+                    case 't': out += '\t'; break;
+                    case 'r': out += '\r'; break;
+                    case 'b': out += '\b'; break;
+                    case 'f': out += '\f'; break;
+                    case 'u':
+                        // Only the ASCII range is needed for scenario files
+                        if (pos + 4 > text.size()) return fail("bad unicode escape");
+                        out += (char)std::strtol(text.substr(pos, 4).c_str(), nullptr, 16);
+                        pos += 4;
+                        break;
+                    default: out += escaped; break;
+                }
+            } else {
+                out += c;
+            }
+        }
+        if (pos >= text.size()) return fail("unterminated string");
+        pos++; // Closing quote
+        return true;
+    }
+
+    bool parse_value(JsonValue& value) {
+        skip_whitespace();
+        if (pos >= text.size()) return fail("unexpected end of document");
+
+        char c = text[pos];
+        if (c == '{') {
+            value.type = JsonType::Object;
+            pos++;
+            skip_whitespace();
+            if (pos < text.size() && text[pos] == '}') { pos++; return true; }
+            while (true) {
+                skip_whitespace();
+                if (pos >= text.size() || text[pos] != '"') return fail("expected a member name");
+                std::string key;
+                if (!parse_string(key)) return false;
+                skip_whitespace();
+                if (pos >= text.size() || text[pos] != ':') return fail("expected ':'");
+                pos++;
+                value.object.emplace_back(key, JsonValue());
+                if (!parse_value(value.object.back().second)) return false;
+                skip_whitespace();
+                if (pos < text.size() && text[pos] == ',') { pos++; continue; }
+                if (pos < text.size() && text[pos] == '}') { pos++; return true; }
+                return fail("expected ',' or '}'");
+            }
+        } else if (c == '[') {
+            value.type = JsonType::Array;
+            pos++;
+            skip_whitespace();
+            if (pos < text.size() && text[pos] == ']') { pos++; return true; }
+            while (true) {
+                value.array.emplace_back();
+                if (!parse_value(value.array.back())) return false;
+                skip_whitespace();
+                if (pos < text.size() && text[pos] == ',') { pos++; continue; }
+                if (pos < text.size() && text[pos] == ']') { pos++; return true; }
+                return fail("expected ',' or ']'");
+            }
+        } else if (c == '"') {
+            value.type = JsonType::String;
+            return parse_string(value.string);
+        } else if (c == 't') {
+            value.type = JsonType::Bool;
+            value.boolean = true;
+            return parse_literal("true");
+        } else if (c == 'f') {
+            value.type = JsonType::Bool;
+            value.boolean = false;
+            return parse_literal("false");
+        } else if (c == 'n') {
+            value.type = JsonType::Null;
+            return parse_literal("null");
+        } else {
+            const char* start = text.c_str() + pos;
+            char* end;
+            value.type = JsonType::Number;
+            value.number = std::strtod(start, &end);
+            if (end == start) return fail("unexpected character");
+            pos += end - start;
+            return true;
+        }
+    }
+};
+
+/**
+ * Parses a JSON document
+ *
+ * @param text The document to parse
+ * @param value Receives the root value of the document
+ * @param error Receives a description of the first syntax error, if any
+ * @return True if the document was parsed successfully
+ */
+bool parse_json(const std::string& text, JsonValue& value, std::string& error) {
+    JsonParser parser(text);
+    value = JsonValue();
+    if (!parser.parse_value(value)) {
+        error = parser.error;
+        return false;
+    }
+
+    parser.skip_whitespace();
+    if (parser.pos != text.size()) {
+        parser.fail("trailing characters after the document");
+        error = parser.error;
+        return false;
+    }
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include <glad/glad.h>
+#include <imgui/imgui.h>
+
+#include "color_maps.hpp"
+#include "lattice_boltzmann.hpp"
+
+#include <utility>
+
+LatticeBoltzmann::LatticeBoltzmann(int width, int height)
+    : lattice_boltzmannCS("shaders/lattice_boltzmann.glsl"), Grid(width, height, 4)
+{
+    prev_x_pos = -1;
+    prev_y_pos = -1;
+    parameters = {{"viscosity", &viscosity}, {"inflow", &inflow}, {"diffusion", &diffusion}};
+    odd = false;
+    populations_revision = 0;
+    advance = true;
+
+    visible_layer_strs = {"Velocity (x)", "Velocity (y)", "Velocity (Magnitude)", "Dye", "Density"};
+    brush_layer_strs = {"Velocity", "Force", "Dye"};
+
+    reset_settings();
+}
+
+/**
+ * Updates the currently tracked mouse position and brush enabled status, while also keeping track of the previous mouse position
+ * 
+ * @param x_pos The x coordinate of the mouse mapped to the grid, not the window
+ * @param y_pos The y coordinate of the mouse mapped to the grid, not the window
+ */
+void LatticeBoltzmann::brush(int x_pos, int y_pos) {
+    if (brush_enabled && x_pos >= 0 && x_pos < this->width && y_pos >= 0 && y_pos < this->height) {
+        prev_x_pos = this->x_pos;
+        prev_y_pos = this->y_pos;
+    } else {
+        prev_x_pos = -1;
+        prev_y_pos = -1;
+    }
+
+    this->x_pos = x_pos;
+    this->y_pos = y_pos;
+    brush_enabled = x_pos >= 0 && x_pos < width && y_pos >= 0 && y_pos < height;
+}
+
+/**
+ * Dispatches one pass of the compute shader over every cell
+ * 
+ * @param pass Index of the pass, see lattice_boltzmann.glsl
+ */
+void LatticeBoltzmann::dispatch(int pass) {
+    lattice_boltzmannCS.set_int("pass", pass);
+    glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+/**
+ * Advances the populations by one fused stream and collide step, then moves the dye and draws the output image.
+ * The populations start over from the equilibrium of the layers whenever those were rewritten, e.g. by a scenario or a resize.
+ */
+void LatticeBoltzmann::solve() {
+    size_t size = 9 * (size_t)width * height * sizeof(float);
+    if (populations.size != size) {
+        populations = Buffer(size);
+        populations_revision = revision - 1;
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, populations.ID);
+
+    if (populations_revision != revision) {
+        odd = false;
+        dispatch(0);
+        populations_revision = revision;
+    }
+    if (advance) {
+        lattice_boltzmannCS.set_bool("odd", odd);
+        dispatch(1);
+        odd = !odd;
+    }
+
+    // The dye reads its neighbours, so it is written into a fresh texture that then replaces the layer
+    Texture dye = texture_pool().acquire(GL_R32F, width, height);
+    glBindImageTexture(5, dye.ID, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    dispatch(2);
+    std::swap(layers[3], dye);
+    texture_pool().release(std::move(dye));
+    bind();
+}
+
+/**
+ * Render the GUI for this specific equation
+ */
+void LatticeBoltzmann::gui() {
+    ImGui::Text("Viscosity (Lattice Units)");
+    ImGui::SliderFloat("##Viscosity", &viscosity, 0.001, 0.2);
+    ImGui::Text("Inflow (Open Boundaries)");
+    ImGui::SliderFloat("##Inflow", &inflow, -0.2, 0.2);
+    ImGui::Text("Dye Diffusion");
+    ImGui::SliderFloat("##Diffusion", &diffusion, 0.0, 0.2);
+    ImGui::Text("Visible Layer");
+    ImGui::Combo("##Visible Layer", &visible_layer, visible_layer_strs.data(), visible_layer_strs.size());
+    ImGui::Text("Brush Layer");
+    ImGui::Combo("##Brush Layer", &brush_layer, brush_layer_strs.data(), brush_layer_strs.size());
+}
+
+/**
+ * Reset all simulation specific settings to default
+ */
+void LatticeBoltzmann::reset_settings() {
+    viscosity = 0.02f;
+    inflow = 0.05f;
+    diffusion = 0.01f;
+    visible_layer = 2;
+    brush_layer = 0;
+    space_step = 1.0f;
+    time_step = 1.0f;
+    boundary_condition = 0;
+}
+
+/**
+ * Send the uniforms for this simulation to the compute shader
+ * 
+ * @param cmap_str String representing a color map to use
+ * @param paused Is the simulation paused?
+ */
+void LatticeBoltzmann::set_uniforms(std::string cmap_str, bool paused) {
+    advance = !paused;
+    lattice_boltzmannCS.bind();
+    lattice_boltzmannCS.set_bool("paused", paused);
+    lattice_boltzmannCS.set_bool("render_image", render_image);
+    lattice_boltzmannCS.set_int("width", width);
+    lattice_boltzmannCS.set_int("height", height);
+    lattice_boltzmannCS.set_int("boundary_condition", boundary_condition);
+    lattice_boltzmannCS.set_float("tau", 3.0f * viscosity + 0.5f);
+    lattice_boltzmannCS.set_float("inflow", inflow);
+    lattice_boltzmannCS.set_float("diffusion", diffusion);
+
+    lattice_boltzmannCS.set_int("visible_layer", visible_layer);
+    lattice_boltzmannCS.set_int("brush_layer", brush_layer);
+    lattice_boltzmannCS.set_int("brush_enabled", brush_enabled);
+    lattice_boltzmannCS.set_int("x_pos", x_pos);
+    lattice_boltzmannCS.set_int("y_pos", y_pos);
+    lattice_boltzmannCS.set_int("prev_x_pos", prev_x_pos);
+    lattice_boltzmannCS.set_int("prev_y_pos", prev_y_pos);
+    lattice_boltzmannCS.set_int("brush_radius", brush_radius);
+    apply_cmap(lattice_boltzmannCS, cmap_str);
+}
+
+/**
+ * Evicts the layers and frees the populations, solve rebuilds them from the equilibrium of the restored layers
+ */
+void LatticeBoltzmann::evict() {
+    Grid::evict();
+    populations = Buffer();
+}
+
+/**
+ * @return The amount of video memory held by the grid's textures and populations
+ */
+size_t LatticeBoltzmann::bytes() const {
+    return Grid::bytes() + populations.size;
+}
\ No newline at end of file
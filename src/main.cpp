@@ -9,8 +9,14 @@
 
 #include "shader.hpp"
 #include "sandbox.hpp"
+#include "scenario.hpp"
+#include "texture.hpp"
 
 #include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cmath>
+#include <string>
 #include <vector>
 #include <memory>
 
@@ -20,22 +26,92 @@ unsigned int WINDOW_HEIGHT = 1000;
 unsigned int GUI_WIDTH = 340;
 unsigned int VAO, VBO, EBO;
 
-void setup();
+void setup(bool headless);
+void run_headless(Sandbox& sandbox, unsigned int steps);
+void release_gpu_resources(Sandbox& sandbox);
 
-int main() {
-	setup();
+void print_usage() {
+	std::cout << "Usage: pdes [options]\n"
+	          << "  --headless       Run without a visible window or GUI\n"
+	          << "  --scenario FILE  Load the PDE, settings, initial conditions and outputs from a scenario file\n"
+	          << "  --steps N        Number of steps to run in headless mode, overriding the scenario\n"
+	          << "  --record FILE    Record every brush event into a journal\n"
+	          << "  --replay FILE    Replay a journal step-exactly, ignoring live brush input\n"
+	          << "  --dump FILE      Write the raw float layers of the grid after a headless run\n"
+	          << "  --memory-budget MB  Video memory for grids before inactive simulations are evicted to host memory" << std::endl;
+}
+
+int main(int argc, char** argv) {
+	bool headless = false;
+	unsigned int steps = 0;
+	int memory_budget = 0;
+	std::string scenario_path, record_path, replay_path, dump_path;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--headless") headless = true;
+		else if (arg == "--scenario" && i + 1 < argc) scenario_path = argv[++i];
+		else if (arg == "--steps" && i + 1 < argc) steps = std::atoi(argv[++i]);
+		else if (arg == "--record" && i + 1 < argc) record_path = argv[++i];
+		else if (arg == "--replay" && i + 1 < argc) replay_path = argv[++i];
+		else if (arg == "--dump" && i + 1 < argc) dump_path = argv[++i];
+		else if (arg == "--memory-budget" && i + 1 < argc) memory_budget = std::atoi(argv[++i]);
+		else {
+			print_usage();
+			return 1;
+		}
+	}
+
+	setup(headless);
 	Sandbox sandbox = Sandbox(WINDOW_WIDTH, WINDOW_HEIGHT, GUI_WIDTH);
+	if (memory_budget > 0) sandbox.memory_budget = memory_budget;
+
+	Scenario scenario;
+	if (!scenario_path.empty() && !scenario.load(scenario_path)) return 1;
+
+	if (headless) {
+		sandbox.resize(WINDOW_WIDTH, WINDOW_HEIGHT, GUI_WIDTH);
+		if (!scenario_path.empty() && !sandbox.load_scenario(scenario)) return 1;
+		if (!replay_path.empty() && !sandbox.start_replay(replay_path)) return 1;
+		if (!record_path.empty()) sandbox.start_recording();
+		if (steps == 0) steps = scenario.steps;
+		if (steps == 0) steps = sandbox.journal_mode == JournalMode::Replay ? sandbox.journal.last_step() + 1 : 1000;
+
+		run_headless(sandbox, steps);
+
+		// Always finish with the final state unless the output cadence already wrote it
+		Grid& grid = *sandbox.grids[sandbox.sim];
+		if (scenario.output_every == 0 || sandbox.step % scenario.output_every != 0) scenario.write_outputs(grid, sandbox.step);
+		if (!record_path.empty()) sandbox.journal.save(record_path);
+		if (!dump_path.empty()) {
+			write_raw(grid, dump_path);
+			std::cout << "Wrote " << grid.layers.size() << " layers of " << grid.width << "x" << grid.height << " floats to " << dump_path << std::endl;
+		}
+		release_gpu_resources(sandbox);
+		glfwTerminate();
+		return 0;
+	}
+
 	glfwSetWindowUserPointer(window, &sandbox);
 	auto resize_window = [](GLFWwindow* window, int width, int height){
 		WINDOW_WIDTH = width;
 		WINDOW_HEIGHT = height;
 		Sandbox* sandbox = (Sandbox*)glfwGetWindowUserPointer(window);
 
-		sandbox->resize(width, height, GUI_WIDTH);
+		sandbox->resize(width, height, GUI_WIDTH, true);
 		glViewport(0, 0, WINDOW_WIDTH - sandbox->gui_width, WINDOW_HEIGHT);
 	};
     glfwSetFramebufferSizeCallback(window, resize_window);
 	resize_window(window, WINDOW_WIDTH, WINDOW_HEIGHT);
+	sandbox.apply_pending_resize(true);
+
+	if (!scenario_path.empty() && !sandbox.load_scenario(scenario)) return 1;
+	if (!replay_path.empty() && !sandbox.start_replay(replay_path)) return 1;
+	if (!record_path.empty()) sandbox.start_recording();
+	auto replay_start = std::chrono::steady_clock::now();
+	bool replay_reported = false;
+	bool panning = false;
+	double pan_x = 0.0, pan_y = 0.0;
 
 	Shader shader("shaders/default.vert", "shaders/default.frag");
     shader.bind();
@@ -45,25 +121,59 @@ int main() {
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+		sandbox.apply_pending_resize();
 		sandbox.bind_current_grid();
 		sandbox.render_gui();
 
-		if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
-			double x_pos, y_pos;
-			glfwGetCursorPos(window, &x_pos, &y_pos);
+		// Mouse input only applies to the grid when the cursor is over the viewport and not captured by the GUI
+		double x_pos, y_pos;
+		glfwGetCursorPos(window, &x_pos, &y_pos);
+		ImGuiIO& io = ImGui::GetIO();
+		bool over_view = !io.WantCaptureMouse && x_pos < WINDOW_WIDTH - sandbox.gui_width;
+
+		if (over_view && io.MouseWheel != 0.0f) sandbox.zoom_view(x_pos, y_pos, std::pow(1.1f, io.MouseWheel));
+		if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS && (panning || over_view)) {
+			if (panning) sandbox.pan_view(x_pos - pan_x, y_pos - pan_y);
+			panning = true;
+			pan_x = x_pos;
+			pan_y = y_pos;
+		} else {
+			panning = false;
+		}
+
+		if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS && over_view) {
 			sandbox.brush(x_pos, y_pos);
 		} else {
-			sandbox.grids[sandbox.sim]->brush_enabled = false;
+			sandbox.release_brush();
+		}
+
+		// Only the last step of each frame needs to write the color mapped image
+		for (int i = 0; i < sandbox.steps_per_frame; i++) {
+			sandbox.advance_step(i == sandbox.steps_per_frame - 1);
+			if (sandbox.step == sandbox.scenario.steps) sandbox.paused = true;
 		}
 
-		for (int i = 0; i < 10; i++) sandbox.advance_step();
+		if (sandbox.journal_mode == JournalMode::Replay && sandbox.journal.finished() && !replay_reported) {
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - replay_start;
+			std::cout << "Replay reached step " << sandbox.step << " in " << elapsed.count() << " s" << std::endl;
+			replay_reported = true;
+		}
 
-		shader.bind();
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, sandbox.grids[sandbox.sim]->image);
+		// Each tile is drawn into its own part of the viewport
+		for (int i = 0; i < sandbox.tiles.size(); i++) {
+			float lod = sandbox.prepare_view(i);
+			glm::vec4 rect = sandbox.tile_rect(i);
+			glViewport((int)rect.x, (int)(WINDOW_HEIGHT - rect.y - rect.w), (int)rect.z, (int)rect.w);
+			shader.bind();
+			shader.set_vec2("view_center", sandbox.view_center);
+			shader.set_vec2("view_extent", sandbox.view_extent(i));
+			shader.set_float("lod", lod);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, sandbox.tiles[i].grid->image.ID);
 
-		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+			glBindVertexArray(VAO);
+			glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+		}
 
 		ImGui::Render();
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
@@ -72,15 +182,57 @@ int main() {
 		glfwPollEvents();
 	}
 
+	if (!record_path.empty()) sandbox.journal.save(record_path);
+
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
 
+	release_gpu_resources(sandbox);
 	glfwTerminate();
 	return 0;
 }
 
-void setup() {
+/**
+ * Advances the current simulation without drawing anything and reports the throughput. Stops early once a grid that stops at
+ * its steady state converged.
+ * 
+ * @param sandbox The sandbox to advance
+ * @param steps Number of simulation steps to run
+ */
+void run_headless(Sandbox& sandbox, unsigned int steps) {
+	sandbox.bind_current_grid();
+	glFinish();
+	auto start = std::chrono::steady_clock::now();
+
+	// Frames that replay strokes painted while paused do not advance the step. A run that stops at its steady state pauses the
+	// sandbox once it converged.
+	unsigned int first = sandbox.step, ran = 0;
+	while (ran < steps && !sandbox.paused) {
+		sandbox.advance_step(ran + 1 == steps);
+		ran = sandbox.step - first;
+	}
+
+	glFinish();
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	Grid& grid = *sandbox.grids[sandbox.sim];
+	std::cout << "Ran " << ran << " steps on a " << grid.width << "x" << grid.height << " grid in " << elapsed.count() << " s ("
+	          << ran / elapsed.count() << " steps/s)" << std::endl;
+}
+
+/**
+ * Frees every texture and buffer while the OpenGL context still exists, the grids, the reduction and the pool would otherwise outlive it
+ * 
+ * @param sandbox The sandbox whose grids are destroyed
+ */
+void release_gpu_resources(Sandbox& sandbox) {
+	sandbox.tiles.clear();
+	sandbox.grids.clear();
+	sandbox.reduction.reset();
+	texture_pool().trim(0);
+}
+
+void setup(bool headless) {
 	float vertices[] = {
 		 1.0f,  1.0f, 0.0f, 1.0f, 0.0f,   // top right
 		 1.0f, -1.0f, 0.0f, 1.0f, 1.0f,   // bottom right
@@ -97,9 +249,15 @@ void setup() {
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	if (headless) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
 	window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "PDE Sandbox", NULL, NULL);
 	glfwMakeContextCurrent(window);
+	if (headless) {
+		gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+		return;
+	}
+
 	GLFWimage icons[2];
 	icons[0].pixels = stbi_load("assets/laplacian.png", &icons[0].width, &icons[0].height, 0, 4);
 	icons[1].pixels = stbi_load("assets/laplacian_small.png", &icons[1].width, &icons[1].height, 0, 4);
@@ -0,0 +1,384 @@
+#include <glad/glad.h>
+
+#include "multigrid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Passes of multigrid.glsl
+enum MultigridPass {
+    PASS_SMOOTH = 0,
+    PASS_RESIDUAL,
+    PASS_RESTRICT_RESIDUAL,
+    PASS_RESTRICT_COEFFICIENT,
+    PASS_PROLONG,
+    PASS_EVALUATE
+};
+
+/**
+ * Accesses a field on the CPU while respecting the boundary conditions, matching U() in multigrid.glsl
+ */
+static float at(const std::vector<float>& field, int width, int height, int x, int y, int boundary_condition) {
+    if (x < 0 || x >= width || y < 0 || y >= height) {
+        if (boundary_condition == 2) return field[((y % height + height) % height) * width + (x % width + width) % width];
+        if (boundary_condition == 1) return field[std::clamp(y, 0, height - 1) * width + std::clamp(x, 0, width - 1)];
+        return 0.0f;
+    }
+    return field[y * width + x];
+}
+
+Multigrid::Multigrid()
+    : multigridCS("shaders/multigrid.glsl")
+{
+    identity = 1.0f;
+    scale = 1.0f;
+    dx = 1.0f;
+    boundary_condition = 0;
+    pre_smooth = 2;
+    post_smooth = 2;
+    coarse_sweeps = 40;
+    cpu = false;
+}
+
+Multigrid::~Multigrid() {
+    release();
+}
+
+/**
+ * Builds the hierarchy for a finest level of the given size, halving the resolution until it is a few cells across
+ *
+ * @param width Number of cells of the finest level along the x-axis
+ * @param height Number of cells of the finest level along the y-axis
+ */
+void Multigrid::resize(int width, int height) {
+    if (!levels.empty() && levels[0].width == width && levels[0].height == height) return;
+    release();
+    if (width <= 0 || height <= 0) return;
+
+    while (true) {
+        MultigridLevel level;
+        level.width = width;
+        level.height = height;
+        level.u = texture_pool().acquire(GL_R32F, width, height);
+        level.f = texture_pool().acquire(GL_R32F, width, height);
+        level.r = texture_pool().acquire(GL_R32F, width, height);
+        level.k = texture_pool().acquire(GL_R32F, width, height);
+        levels.push_back(std::move(level));
+        if (std::min(width, height) < 8) break;
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+}
+
+/**
+ * Gives every texture of the hierarchy back to the pool
+ */
+void Multigrid::release() {
+    for (MultigridLevel& level : levels) {
+        texture_pool().release(std::move(level.u));
+        texture_pool().release(std::move(level.f));
+        texture_pool().release(std::move(level.r));
+        texture_pool().release(std::move(level.k));
+    }
+    levels.clear();
+}
+
+/**
+ * @return The amount of video memory held by the textures of every level
+ */
+size_t Multigrid::bytes() const {
+    size_t total = 0;
+    for (const MultigridLevel& level : levels) total += level.u.bytes() + level.f.bytes() + level.r.bytes() + level.k.bytes();
+    return total;
+}
+
+/**
+ * Sets the coefficient k of the laplacian on every level
+ *
+ * @param field Per-cell values of the coefficient at the size of the finest level, or nullptr for a uniform coefficient
+ * @param value The uniform coefficient, used if there is no field
+ */
+void Multigrid::set_coefficient(const Texture* field, float value) {
+    MultigridLevel& finest = levels[0];
+    if (cpu) {
+        finest.host_k.assign(finest.width * finest.height, value);
+        if (field) glGetTextureImage(field->ID, 0, GL_RED, GL_FLOAT, finest.host_k.size() * sizeof(float), finest.host_k.data());
+    } else if (field) {
+        glCopyImageSubData(field->ID, GL_TEXTURE_2D, 0, 0, 0, 0, finest.k.ID, GL_TEXTURE_2D, 0, 0, 0, 0, finest.width, finest.height, 1);
+    } else {
+        glClearTexImage(finest.k.ID, 0, GL_RED, GL_FLOAT, &value);
+    }
+
+    for (int level = 0; level + 1 < levels.size(); level++) restrict_coefficient(level);
+}
+
+/**
+ * Writes identity * u + scale * k * laplacian(u) into the right hand side of the finest level,
+ * e.g. the explicit half of a Crank-Nicolson step
+ *
+ * @param u The field to evaluate, at the size of the finest level
+ * @param identity Coefficient of u
+ * @param scale Coefficient of the laplacian
+ */
+void Multigrid::evaluate(const Texture& u, float identity, float scale) {
+    MultigridLevel& finest = levels[0];
+    if (!cpu) {
+        glCopyImageSubData(u.ID, GL_TEXTURE_2D, 0, 0, 0, 0, finest.u.ID, GL_TEXTURE_2D, 0, 0, 0, 0, finest.width, finest.height, 1);
+        multigridCS.bind();
+        multigridCS.set_float("identity", identity);
+        multigridCS.set_float("scale", scale);
+        dispatch(0, PASS_EVALUATE);
+        return;
+    }
+
+    int w = finest.width, h = finest.height;
+    finest.host_u.resize(w * h);
+    finest.host_f.resize(w * h);
+    glGetTextureImage(u.ID, 0, GL_RED, GL_FLOAT, finest.host_u.size() * sizeof(float), finest.host_u.data());
+    const std::vector<float>& v = finest.host_u;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            float laplacian = (at(v, w, h, x-1, y, boundary_condition) + at(v, w, h, x+1, y, boundary_condition) +
+                               at(v, w, h, x, y-1, boundary_condition) + at(v, w, h, x, y+1, boundary_condition) - 4.0f * v[y * w + x]) / (dx * dx);
+            finest.host_f[y * w + x] = identity * v[y * w + x] + scale * finest.host_k[y * w + x] * laplacian;
+        }
+    }
+}
+
+/**
+ * Solves the system for the right hand side of the finest level (see evaluate), starting from the current contents of u
+ *
+ * @param u Initial guess at the size of the finest level, receives the solution
+ * @param cycles Number of V-cycles to run
+ */
+void Multigrid::solve(const Texture& u, int cycles) {
+    MultigridLevel& finest = levels[0];
+    if (cpu) {
+        finest.host_u.resize(finest.width * finest.height);
+        glGetTextureImage(u.ID, 0, GL_RED, GL_FLOAT, finest.host_u.size() * sizeof(float), finest.host_u.data());
+    } else {
+        glCopyImageSubData(u.ID, GL_TEXTURE_2D, 0, 0, 0, 0, finest.u.ID, GL_TEXTURE_2D, 0, 0, 0, 0, finest.width, finest.height, 1);
+    }
+
+    for (int i = 0; i < cycles; i++) v_cycle(0);
+
+    if (cpu) glTextureSubImage2D(u.ID, 0, 0, 0, finest.width, finest.height, GL_RED, GL_FLOAT, finest.host_u.data());
+    else glCopyImageSubData(finest.u.ID, GL_TEXTURE_2D, 0, 0, 0, 0, u.ID, GL_TEXTURE_2D, 0, 0, 0, 0, finest.width, finest.height, 1);
+}
+
+/**
+ * @return The root mean square residual of the finest level, read back from the GPU if needed
+ */
+float Multigrid::residual_norm() {
+    MultigridLevel& finest = levels[0];
+    residual(0);
+    if (!cpu) {
+        finest.host_r.resize(finest.width * finest.height);
+        glGetTextureImage(finest.r.ID, 0, GL_RED, GL_FLOAT, finest.host_r.size() * sizeof(float), finest.host_r.data());
+    }
+
+    double sum = 0.0;
+    for (float value : finest.host_r) sum += (double)value * value;
+    return (float)std::sqrt(sum / finest.host_r.size());
+}
+
+/**
+ * Runs one V-cycle: smooth, restrict the residual, correct from the coarser level, smooth again
+ *
+ * @param level Index of the level the cycle starts at
+ */
+void Multigrid::v_cycle(int level) {
+    if (level == levels.size() - 1) {
+        smooth(level, coarse_sweeps);
+        return;
+    }
+
+    smooth(level, pre_smooth);
+    residual(level);
+    restrict_residual(level);
+
+    // The coarse level solves for a correction, starting from zero
+    MultigridLevel& coarse = levels[level + 1];
+    if (cpu) coarse.host_u.assign(coarse.width * coarse.height, 0.0f);
+    else coarse.u.clear();
+
+    v_cycle(level + 1);
+    prolong(level);
+    smooth(level, post_smooth);
+}
+
+/**
+ * Red-black Gauss-Seidel sweeps, Neumann ghost cells equal the cell itself and move to the diagonal
+ *
+ * @param level Index of the level to smooth
+ * @param sweeps Number of sweeps, each updates both colors once
+ */
+void Multigrid::smooth(int level, int sweeps) {
+    if (!cpu) {
+        for (int i = 0; i < sweeps; i++) {
+            dispatch(level, PASS_SMOOTH, 0);
+            dispatch(level, PASS_SMOOTH, 1);
+        }
+        return;
+    }
+
+    MultigridLevel& l = levels[level];
+    int w = l.width, h = l.height;
+    float h2 = std::pow(dx * (float)(1 << level), 2.0f);
+    std::vector<float>& u = l.host_u;
+    const int offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    for (int i = 0; i < sweeps; i++) {
+        for (int parity = 0; parity < 2; parity++) {
+            for (int y = 0; y < h; y++) {
+                for (int x = (y + parity) % 2; x < w; x += 2) {
+                    float coefficient = scale * l.host_k[y * w + x] / h2;
+                    float sum = 0.0f;
+                    float diagonal = identity + 4.0f * coefficient;
+                    for (const auto& offset : offsets) {
+                        int nx = x + offset[0], ny = y + offset[1];
+                        bool outside = nx < 0 || nx >= w || ny < 0 || ny >= h;
+                        if (outside && boundary_condition == 1) diagonal -= coefficient;
+                        else sum += at(u, w, h, nx, ny, boundary_condition);
+                    }
+                    if (diagonal != 0.0f) u[y * w + x] = (l.host_f[y * w + x] + coefficient * sum) / diagonal;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Computes the residual f - A u of a level
+ *
+ * @param level Index of the level
+ */
+void Multigrid::residual(int level) {
+    if (!cpu) {
+        dispatch(level, PASS_RESIDUAL);
+        return;
+    }
+
+    MultigridLevel& l = levels[level];
+    int w = l.width, h = l.height;
+    float h2 = std::pow(dx * (float)(1 << level), 2.0f);
+    const std::vector<float>& u = l.host_u;
+    l.host_r.resize(w * h);
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            float laplacian = (at(u, w, h, x-1, y, boundary_condition) + at(u, w, h, x+1, y, boundary_condition) +
+                               at(u, w, h, x, y-1, boundary_condition) + at(u, w, h, x, y+1, boundary_condition) - 4.0f * u[y * w + x]) / h2;
+            l.host_r[y * w + x] = l.host_f[y * w + x] - (identity * u[y * w + x] - scale * l.host_k[y * w + x] * laplacian);
+        }
+    }
+}
+
+/**
+ * Averages a field of a level into the next coarser level, every coarse cell covers up to four fine cells
+ */
+static void restrict_average(const std::vector<float>& fine, int width, int height, std::vector<float>& coarse, int coarse_width, int coarse_height) {
+    coarse.resize(coarse_width * coarse_height);
+    for (int y = 0; y < coarse_height; y++) {
+        for (int x = 0; x < coarse_width; x++) {
+            float sum = 0.0f;
+            int count = 0;
+            for (int fy = 2 * y; fy < std::min(2 * y + 2, height); fy++)
+                for (int fx = 2 * x; fx < std::min(2 * x + 2, width); fx++, count++) sum += fine[fy * width + fx];
+            coarse[y * coarse_width + x] = sum / count;
+        }
+    }
+}
+
+/**
+ * Restricts the residual of a level to the right hand side of the next coarser level
+ *
+ * @param level Index of the finer level
+ */
+void Multigrid::restrict_residual(int level) {
+    if (!cpu) {
+        dispatch(level, PASS_RESTRICT_RESIDUAL);
+        return;
+    }
+    MultigridLevel& fine = levels[level];
+    MultigridLevel& coarse = levels[level + 1];
+    restrict_average(fine.host_r, fine.width, fine.height, coarse.host_f, coarse.width, coarse.height);
+}
+
+/**
+ * Restricts the laplacian coefficient of a level to the next coarser level
+ *
+ * @param level Index of the finer level
+ */
+void Multigrid::restrict_coefficient(int level) {
+    if (!cpu) {
+        dispatch(level, PASS_RESTRICT_COEFFICIENT);
+        return;
+    }
+    MultigridLevel& fine = levels[level];
+    MultigridLevel& coarse = levels[level + 1];
+    restrict_average(fine.host_k, fine.width, fine.height, coarse.host_k, coarse.width, coarse.height);
+}
+
+/**
+ * Adds the bilinearly interpolated correction of the next coarser level to a level
+ *
+ * @param level Index of the finer level
+ */
+void Multigrid::prolong(int level) {
+    if (!cpu) {
+        dispatch(level, PASS_PROLONG);
+        return;
+    }
+
+    MultigridLevel& fine = levels[level];
+    const MultigridLevel& coarse = levels[level + 1];
+    int cw = coarse.width, ch = coarse.height;
+    for (int y = 0; y < fine.height; y++) {
+        for (int x = 0; x < fine.width; x++) {
+            int cx = (x + 1) / 2 - 1, cy = (y + 1) / 2 - 1;
+            float wx = x % 2 == 0 ? 0.75f : 0.25f, wy = y % 2 == 0 ? 0.75f : 0.25f;
+            float bottom = at(coarse.host_u, cw, ch, cx, cy, boundary_condition) * (1 - wx) + at(coarse.host_u, cw, ch, cx+1, cy, boundary_condition) * wx;
+            float top = at(coarse.host_u, cw, ch, cx, cy+1, boundary_condition) * (1 - wx) + at(coarse.host_u, cw, ch, cx+1, cy+1, boundary_condition) * wx;
+            fine.host_u[y * fine.width + x] += bottom * (1 - wy) + top * wy;
+        }
+    }
+}
+
+/**
+ * Runs one pass of multigrid.glsl on a level
+ *
+ * @param level Index of the level, restriction and prolongation also access the next coarser level
+ * @param pass One of the passes in multigrid.glsl
+ * @param parity Color of the cells updated by a smoothing pass
+ */
+void Multigrid::dispatch(int level, int pass, int parity) {
+    MultigridLevel& l = levels[level];
+    MultigridLevel* coarse = level + 1 < levels.size() ? &levels[level + 1] : nullptr;
+
+    multigridCS.bind();
+    multigridCS.set_int("pass", pass);
+    multigridCS.set_int("parity", parity);
+    multigridCS.set_int("width", l.width);
+    multigridCS.set_int("height", l.height);
+    multigridCS.set_int("coarse_width", coarse ? coarse->width : 0);
+    multigridCS.set_int("coarse_height", coarse ? coarse->height : 0);
+    multigridCS.set_int("boundary_condition", boundary_condition);
+    multigridCS.set_float("dx", dx * (float)(1 << level));
+    if (pass != PASS_EVALUATE) {
+        multigridCS.set_float("identity", identity);
+        multigridCS.set_float("scale", scale);
+    }
+
+    glBindImageTexture(1, l.u.ID, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+    glBindImageTexture(2, l.f.ID, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+    glBindImageTexture(3, l.r.ID, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+    glBindImageTexture(4, l.k.ID, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+    if (coarse) {
+        unsigned int target = pass == PASS_RESTRICT_RESIDUAL ? coarse->f.ID : pass == PASS_RESTRICT_COEFFICIENT ? coarse->k.ID : coarse->u.ID;
+        glBindImageTexture(5, target, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+    }
+
+    bool restricting = pass == PASS_RESTRICT_RESIDUAL || pass == PASS_RESTRICT_COEFFICIENT;
+    int w = restricting ? coarse->width : l.width, h = restricting ? coarse->height : l.height;
+    glDispatchCompute((w + 7) / 8, (h + 7) / 8, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+}
\ No newline at end of file
@@ -6,22 +6,62 @@
 #include "sandbox.hpp"
 
 #include <iostream>
+#include <algorithm>
+#include <utility>
+#include <cmath>
+#include <cfloat>
 
 NavierStokes::NavierStokes(int width, int height) 
-    : navier_stokesCS("shaders/navier_stokes.glsl"), Grid(width, height, 4)
+    : navier_stokesCS("shaders/navier_stokes.glsl"), projectionCS("shaders/projection.glsl"), advectionCS("shaders/advection.glsl"),
+      staggeredCS("shaders/navier_stokes_mac.glsl"), Grid(width, height, 4)
 {
     brush_layer = 0;
     prev_x_pos = -1;
     prev_y_pos = -1;
+    parameters = {{"viscosity", &viscosity}};
+    options = {
+        {"pressure_solver", {&pressure_solver, {"Artificial Compressibility", "Projection", "Spectral Projection"}}},
+        {"advection", {&advection, {"Centered", "Semi-Lagrangian", "MacCormack"}}},
+        {"layout", {&layout, {"Collocated", "Staggered"}}}
+    };
+    add_runge_kutta_methods();
+    adaptive_supported = true;
+    steady_supported = true;
+    advance = true;
+    faces_revision = 0;
+    show_spectrum = false;
+    fields_supported = true;
+    stencils_supported = true;
 
     visible_layer_strs.resize(4);
     visible_layer_strs = {"Velocity (x)", "Velocity (y)", "Velocity (Magnitude)", "Dye"};
     brush_layer_strs.resize(3);
     brush_layer_strs = {"Velocity", "Force", "Dye"};
 
+    // Bilinear samplers for the advection, the dye always repeats vertically
+    const int wraps[3] = {GL_CLAMP_TO_BORDER, GL_CLAMP_TO_EDGE, GL_REPEAT};
+    const float border[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    glCreateSamplers(4, samplers);
+    for (int i = 0; i < 4; i++) {
+        glSamplerParameteri(samplers[i], GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glSamplerParameteri(samplers[i], GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glSamplerParameteri(samplers[i], GL_TEXTURE_WRAP_S, wraps[i < 3 ? i : 1]);
+        glSamplerParameteri(samplers[i], GL_TEXTURE_WRAP_T, wraps[i < 3 ? i : 2]);
+        glSamplerParameterfv(samplers[i], GL_TEXTURE_BORDER_COLOR, border);
+    }
+
     reset_settings();
 }
 
+/**
+ * Returns the face velocities to the pool along with the layers and deletes the advection samplers
+ */
+NavierStokes::~NavierStokes() {
+    texture_pool().release(std::move(u_faces));
+    texture_pool().release(std::move(v_faces));
+    glDeleteSamplers(4, samplers);
+}
+
 /**
  * Updates the currently tracked mouse position and brush enabled status, while also keeping track of the previous mouse position
  * 
@@ -43,11 +83,496 @@ void NavierStokes::brush(int x_pos, int y_pos) {
 }
 
 /**
- * Dispatch the compute shader which solves the equation
+ * Dispatch the compute shader which solves the equation, preceded by the advection if it is semi-Lagrangian
+ * and followed by the projection if it enforces incompressibility. On a staggered grid the velocity is advanced
+ * and projected on the faces first, and the compute shader is left with the dye. A Runge-Kutta integrator advances
+ * every layer of the collocated grid before the compute shader, which then only applies the brush.
  */
 void NavierStokes::solve() {
+    if (layout == 1) step_staggered();
+    if (advection != 0 && advance) advect();
+    if (layout == 0 && runge_kutta_method() >= 0 && advance) {
+        runge_kutta.step(*this, runge_kutta_methods()[runge_kutta_method()], time_step);
+        bind();
+        navier_stokesCS.bind();
+        bind_parameter_fields(navier_stokesCS);
+    }
     glDispatchCompute(width, height, 1);
     glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    if (layout == 0 && pressure_solver >= 1 && advance) project();
+}
+
+/**
+ * Writes the time derivative of every layer into the slices of rates, leaving out the pressure gradient and the advection
+ * if a projection or the semi-Lagrangian advection handles them
+ * 
+ * @param rates 2D array texture with a slice per layer
+ */
+void NavierStokes::evaluate_rates(const Texture& rates) {
+    bind();
+    navier_stokesCS.bind();
+    bind_parameter_fields(navier_stokesCS);
+    navier_stokesCS.set_bool("derivative", true);
+    glBindImageTexture(5, rates.ID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R32F);
+    glDispatchCompute(width, height, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    navier_stokesCS.set_bool("derivative", false);
+}
+
+/**
+ * Explicit viscosity decays the fastest mode at up to 8 nu / dx^2 (faster with the wider stencils of the collocated layout), which has to stay within the stability region of the
+ * integrator, and centered advection and the pressure waves of artificial compressibility must not cross more than a cell per
+ * step (the CFL condition). The largest velocities and viscosity are reduced on the GPU.
+ *
+ * @return The largest stable time step
+ */
+float NavierStokes::stable_time_step() {
+    std::vector<const Texture*> fields = {&layers[0], &layers[1]};
+    auto field = parameter_fields.find("viscosity");
+    if (field != parameter_fields.end()) fields.push_back(&field->second.texture);
+    std::vector<float> maxima = reduction.max_abs(fields);
+
+    float nu = fields.size() > 2 ? maxima[2] : std::abs(viscosity);
+    float extent = layout == 0 ? stability_extent() : 2.0f;
+    float scale = layout == 0 ? laplacian_scale() : 1.0f;
+    float viscous = extent * space_step * space_step / (8.0f * scale * nu);
+
+    // Semi-Lagrangian and MacCormack advection are stable at any Courant number, the pressure waves travel at 1 / M = 2
+    // in navier_stokes.glsl
+    float speed = (advection == 0 ? maxima[0] + maxima[1] : 0.0f) + (layout == 0 && pressure_solver == 0 ? 2.0f : 0.0f);
+    float courant = space_step / speed;
+    limited_by = viscous < courant ? "viscosity" : "the Courant number";
+    return std::min(viscous, courant);
+}
+
+/**
+ * Dispatches one pass of navier_stokes_mac.glsl over every face and cell
+ * 
+ * @param pass Index of the pass, see navier_stokes_mac.glsl
+ * @param u_in Read by the pass as the velocity along x, either the faces or the cell centered layer
+ * @param v_in Read by the pass as the velocity along y
+ * @param u_out Written by the pass as the velocity along x
+ * @param v_out Written by the pass as the velocity along y
+ */
+void NavierStokes::dispatch_staggered(int pass, const Texture& u_in, const Texture& v_in, const Texture& u_out, const Texture& v_out) {
+    glBindTextureUnit(0, u_in.ID);
+    glBindTextureUnit(1, v_in.ID);
+    glBindImageTexture(1, u_out.ID, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+    glBindImageTexture(2, v_out.ID, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+    staggeredCS.set_int("pass", pass);
+    glDispatchCompute((width + 8) / 8, (height + 8) / 8, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+/**
+ * Advances the velocity on the faces of a staggered (MAC) grid and projects it, then averages it into the velocity layers.
+ * The faces are rebuilt from the layers whenever those were rewritten, e.g. by a scenario, a resize or a restore after an eviction.
+ */
+void NavierStokes::step_staggered() {
+    if (u_faces.ID == 0 || u_faces.width != width + 1 || u_faces.height != height || v_faces.width != width || v_faces.height != height + 1) {
+        texture_pool().release(std::move(u_faces));
+        texture_pool().release(std::move(v_faces));
+        u_faces = texture_pool().acquire(GL_R32F, width + 1, height);
+        v_faces = texture_pool().acquire(GL_R32F, width, height + 1);
+        faces_revision = revision - 1;
+    }
+
+    staggeredCS.bind();
+    staggeredCS.set_int("u_in", 0);
+    staggeredCS.set_int("v_in", 1);
+    staggeredCS.set_int("p_in", 2);
+    staggeredCS.set_bool("paused", !advance);
+    staggeredCS.set_int("width", width);
+    staggeredCS.set_int("height", height);
+    staggeredCS.set_int("boundary_condition", boundary_condition);
+    staggeredCS.set_float("viscosity", viscosity);
+    staggeredCS.set_float("dx", space_step);
+    staggeredCS.set_float("dt", time_step);
+    staggeredCS.set_bool("semi_lagrangian", advection != 0);
+    staggeredCS.set_int("brush_layer", brush_layer);
+    staggeredCS.set_int("brush_enabled", brush_enabled);
+    staggeredCS.set_int("x_pos", x_pos);
+    staggeredCS.set_int("y_pos", y_pos);
+    staggeredCS.set_int("prev_x_pos", prev_x_pos);
+    staggeredCS.set_int("prev_y_pos", prev_y_pos);
+    staggeredCS.set_int("brush_radius", brush_radius);
+    bind_parameter_fields(staggeredCS);
+
+    if (faces_revision != revision) {
+        dispatch_staggered(0, layers[0], layers[1], u_faces, v_faces);
+        faces_revision = revision;
+    }
+
+    // The momentum pass reads neighbouring faces, so it writes into fresh textures that then replace the faces
+    Texture u_next = texture_pool().acquire(GL_R32F, width + 1, height);
+    Texture v_next = texture_pool().acquire(GL_R32F, width, height + 1);
+    dispatch_staggered(1, u_faces, v_faces, u_next, v_next);
+    std::swap(u_faces, u_next);
+    std::swap(v_faces, v_next);
+    texture_pool().release(std::move(u_next));
+    texture_pool().release(std::move(v_next));
+
+    if (advance) project();
+
+    staggeredCS.bind();
+    dispatch_staggered(4, u_faces, v_faces, layers[0], layers[1]);
+    bind();
+    navier_stokesCS.bind();
+    bind_parameter_fields(navier_stokesCS);
+}
+
+/**
+ * Projects the velocity onto its divergence free part: solves laplacian(p) = div(u) / dt with multigrid,
+ * warm started from the previous pressure, then subtracts dt * grad(p) from the velocity
+ */
+void NavierStokes::project() {
+    // Walls keep the fluid in (zero pressure gradient), open boundaries let it out at zero pressure
+    multigrid.resize(width, height);
+    multigrid.boundary_condition = boundary_condition == 0 ? 1 : boundary_condition == 1 ? 0 : 2;
+    multigrid.dx = space_step;
+    multigrid.identity = 0.0f;
+    multigrid.scale = 1.0f;
+    multigrid.set_coefficient(nullptr, 1.0f);
+    if (layout == 1) {
+        project_staggered();
+        return;
+    }
+
+    if (!multigrid.cpu) {
+        // The multigrid passes use their own image bindings
+        bind();
+        projectionCS.bind();
+        projectionCS.set_int("width", width);
+        projectionCS.set_int("height", height);
+        projectionCS.set_int("boundary_condition", boundary_condition);
+        projectionCS.set_float("dx", space_step);
+        projectionCS.set_float("dt", time_step);
+        projectionCS.set_int("pass", 0);
+        glBindImageTexture(5, multigrid.levels[0].f.ID, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+        glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        solve_pressure();
+
+        bind();
+        projectionCS.bind();
+        projectionCS.set_int("pass", 1);
+        glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        navier_stokesCS.bind();
+        return;
+    }
+
+    // The same passes on the CPU, see projection.glsl
+    std::vector<float> u = read_layer(0), v = read_layer(1);
+    auto velocity = [&](const std::vector<float>& field, int x, int y, int inside_x, int inside_y) {
+        if (x >= 0 && x < width && y >= 0 && y < height) return field[y * width + x];
+        if (boundary_condition == 2) return field[((y + height) % height) * width + (x + width) % width];
+        float inside = field[inside_y * width + inside_x];
+        return boundary_condition == 1 ? inside : -inside;
+    };
+    std::vector<float>& rhs = multigrid.levels[0].host_f;
+    rhs.resize(width * height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            float flux_x = (velocity(u, x+1, y, x, y) - velocity(u, x-1, y, x, y)) * 0.5f;
+            float flux_y = (velocity(v, x, y+1, x, y) - velocity(v, x, y-1, x, y)) * 0.5f;
+            rhs[y * width + x] = -(flux_x + flux_y) / space_step / time_step;
+        }
+    }
+
+    solve_pressure();
+
+    const std::vector<float>& p = multigrid.levels[0].host_u;
+    auto pressure = [&](int x, int y) {
+        if (x >= 0 && x < width && y >= 0 && y < height) return p[y * width + x];
+        if (boundary_condition == 2) return p[((y + height) % height) * width + (x + width) % width];
+        if (boundary_condition == 1) return 0.0f;
+        return p[std::clamp(y, 0, height - 1) * width + std::clamp(x, 0, width - 1)];
+    };
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            u[y * width + x] -= time_step * (pressure(x+1, y) - pressure(x-1, y)) / (2.0f * space_step);
+            v[y * width + x] -= time_step * (pressure(x, y+1) - pressure(x, y-1)) / (2.0f * space_step);
+        }
+    }
+    write_layer(0, u);
+    write_layer(1, v);
+    bind();
+    navier_stokesCS.bind();
+}
+
+/**
+ * Projects the face velocities of a staggered grid, see project. The divergence of a cell and the pressure gradient on a face
+ * both use the two values next to each other, so the discrete operators match the multigrid laplacian and the projection is exact.
+ */
+void NavierStokes::project_staggered() {
+    if (!multigrid.cpu) {
+        staggeredCS.bind();
+        glBindTextureUnit(0, u_faces.ID);
+        glBindTextureUnit(1, v_faces.ID);
+        glBindImageTexture(5, multigrid.levels[0].f.ID, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+        staggeredCS.set_int("pass", 2);
+        glDispatchCompute((width + 8) / 8, (height + 8) / 8, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        solve_pressure();
+
+        staggeredCS.bind();
+        glBindTextureUnit(2, layers[2].ID);
+        dispatch_staggered(3, u_faces, v_faces, u_faces, v_faces);
+        return;
+    }
+
+    // The same passes on the CPU, see navier_stokes_mac.glsl
+    std::vector<float> u((width + 1) * height), v(width * (height + 1));
+    glGetTextureImage(u_faces.ID, 0, GL_RED, GL_FLOAT, u.size() * sizeof(float), u.data());
+    glGetTextureImage(v_faces.ID, 0, GL_RED, GL_FLOAT, v.size() * sizeof(float), v.data());
+    std::vector<float>& rhs = multigrid.levels[0].host_f;
+    rhs.resize(width * height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            // The last face of a periodic grid is the same as the first
+            int right = boundary_condition == 2 && x == width - 1 ? 0 : x + 1;
+            int top = boundary_condition == 2 && y == height - 1 ? 0 : y + 1;
+            float divergence = (u[y * (width + 1) + right] - u[y * (width + 1) + x] + v[top * width + x] - v[y * width + x]) / space_step;
+            rhs[y * width + x] = -divergence / time_step;
+        }
+    }
+
+    solve_pressure();
+
+    const std::vector<float>& p = multigrid.levels[0].host_u;
+    auto pressure = [&](int x, int y) {
+        if (x >= 0 && x < width && y >= 0 && y < height) return p[y * width + x];
+        if (boundary_condition == 2) return p[((y + height) % height) * width + (x + width) % width];
+        if (boundary_condition == 1) return 0.0f;
+        return p[std::clamp(y, 0, height - 1) * width + std::clamp(x, 0, width - 1)];
+    };
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x <= width; x++)
+            if (boundary_condition != 0 || (x > 0 && x < width)) u[y * (width + 1) + x] -= time_step * (pressure(x, y) - pressure(x-1, y)) / space_step;
+    for (int y = 0; y <= height; y++)
+        for (int x = 0; x < width; x++)
+            if (boundary_condition != 0 || (y > 0 && y < height)) v[y * width + x] -= time_step * (pressure(x, y) - pressure(x, y-1)) / space_step;
+    glTextureSubImage2D(u_faces.ID, 0, 0, 0, width + 1, height, GL_RED, GL_FLOAT, u.data());
+    glTextureSubImage2D(v_faces.ID, 0, 0, 0, width, height + 1, GL_RED, GL_FLOAT, v.data());
+}
+
+/**
+ * @return True if the pressure is solved for with FFTs, which needs periodic boundaries. Otherwise the projection uses multigrid.
+ */
+bool NavierStokes::spectral() const {
+    return pressure_solver == 2 && boundary_condition == 2;
+}
+
+/**
+ * Solves the pressure equation for the right hand side in the finest multigrid level and writes the pressure into its layer
+ * (and into host_u on the CPU). The spectral solver divides every Fourier mode by the matching eigenvalue of the laplacian,
+ * which is exact in one pass. On the collocated grid that laplacian is the divergence of the centered gradient the projection
+ * subtracts, whose wide stencil leaves the velocity exactly divergence free where multigrid's 5 point stencil would not.
+ */
+void NavierStokes::solve_pressure() {
+    if (!spectral()) {
+        multigrid.solve(layers[2], v_cycles);
+        return;
+    }
+
+    bool wide = layout == 0;
+    if (!multigrid.cpu) {
+        gpu_fft.resize(width, height);
+        gpu_fft.load(multigrid.levels[0].f);
+        gpu_fft.forward();
+        gpu_fft.solve_poisson(space_step, wide);
+        gpu_fft.inverse();
+        gpu_fft.store(layers[2]);
+        return;
+    }
+
+    // The same division on the CPU, see PASS_POISSON in fft.glsl
+    MultigridLevel& finest = multigrid.levels[0];
+    fft.resize(width, height);
+    fft.forward(finest.host_f.data());
+    int frequencies = fft.frequencies();
+    for (int kx = 0; kx < width; kx++) {
+        for (int ky = 0; ky < frequencies; ky++) {
+            double theta_x = 2.0 * M_PI * kx / width, theta_y = 2.0 * M_PI * ky / height;
+            double eigenvalue = wide ? std::pow(std::sin(theta_x), 2) + std::pow(std::sin(theta_y), 2)
+                                     : 4.0 * (std::pow(std::sin(0.5 * theta_x), 2) + std::pow(std::sin(0.5 * theta_y), 2));
+            float factor = eigenvalue > 1e-6 ? (float)(space_step * space_step / eigenvalue) : 0.0f;
+            fft.spectrum_re[kx * frequencies + ky] *= factor;
+            fft.spectrum_im[kx * frequencies + ky] *= factor;
+        }
+    }
+    finest.host_u.resize(width * height);
+    fft.inverse(finest.host_u.data());
+    glTextureSubImage2D(layers[2].ID, 0, 0, 0, width, height, GL_RED, GL_FLOAT, finest.host_u.data());
+}
+
+/**
+ * Fetches a cell of a field the way a GL sampler would outside of the grid
+ * 
+ * @param field Row-major scalar field
+ * @param width Width of the field
+ * @param height Height of the field
+ * @param x Column of the cell
+ * @param y Row of the cell
+ * @param wrap_x What lies beyond the left and right edges: 0 for a border of 0, 1 for the nearest edge cell, 2 to repeat
+ * @param wrap_y What lies beyond the top and bottom edges, as for wrap_x
+ * @return The value of the cell
+ */
+static float texel(const std::vector<float>& field, int width, int height, int x, int y, int wrap_x, int wrap_y) {
+    if (x < 0 || x >= width) {
+        if (wrap_x == 0) return 0.0f;
+        x = wrap_x == 1 ? std::clamp(x, 0, width - 1) : (x % width + width) % width;
+    }
+    if (y < 0 || y >= height) {
+        if (wrap_y == 0) return 0.0f;
+        y = wrap_y == 1 ? std::clamp(y, 0, height - 1) : (y % height + height) % height;
+    }
+    return field[y * width + x];
+}
+
+/**
+ * Bilinearly interpolates a field between the four cell centers around a position, like texture() in advection.glsl
+ * 
+ * @param field Row-major scalar field
+ * @param width Width of the field
+ * @param height Height of the field
+ * @param x X coordinate in cells, with cell centers on integers
+ * @param y Y coordinate in cells
+ * @param wrap_x What lies beyond the left and right edges, see texel
+ * @param wrap_y What lies beyond the top and bottom edges
+ * @return The interpolated value
+ */
+static float sample(const std::vector<float>& field, int width, int height, float x, float y, int wrap_x, int wrap_y) {
+    int x0 = (int)std::floor(x), y0 = (int)std::floor(y);
+    float fx = x - x0, fy = y - y0;
+    float top = (1.0f - fx) * texel(field, width, height, x0, y0, wrap_x, wrap_y) + fx * texel(field, width, height, x0 + 1, y0, wrap_x, wrap_y);
+    float bottom = (1.0f - fx) * texel(field, width, height, x0, y0 + 1, wrap_x, wrap_y) + fx * texel(field, width, height, x0 + 1, y0 + 1, wrap_x, wrap_y);
+    return (1.0f - fy) * top + fy * bottom;
+}
+
+/**
+ * Advects the velocity and dye along the velocity with a semi-Lagrangian step: every cell traces its characteristic
+ * back by dt and interpolates the fields where it started, which is stable for any time step.
+ * MacCormack's correction then advects that estimate forwards again and removes half of the round-trip error,
+ * limited to the values around the start of the characteristic.
+ */
+void NavierStokes::advect() {
+    // Velocities beyond walls are 0, beyond open boundaries equal the edge and periodic boundaries repeat; the dye always repeats vertically
+    const int layer_of[3] = {0, 1, 3};
+    const int wrap_of[3] = {boundary_condition, boundary_condition, 1};
+
+    if (!cpu_backend) {
+        const char* names[3] = {"u", "v", "s"};
+
+        advectionCS.bind();
+        advectionCS.set_int("width", width);
+        advectionCS.set_int("height", height);
+        advectionCS.set_float("dx", space_step);
+        advectionCS.set_float("dt", time_step);
+        Texture estimate[3];
+        for (int i = 0; i < 3; i++) {
+            estimate[i] = texture_pool().acquire(GL_R32F, width, height);
+            glBindTextureUnit(i, layers[layer_of[i]].ID);
+            glBindSampler(i, samplers[i < 2 ? boundary_condition : 3]);
+            glBindImageTexture(i+1, estimate[i].ID, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+            advectionCS.set_int(std::string(names[i]) + "_field", i);
+            advectionCS.set_int(std::string(names[i]) + "_estimate", i + 3);
+        }
+        advectionCS.set_int("pass", 0);
+        glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        if (advection == 2) {
+            Texture corrected[3];
+            for (int i = 0; i < 3; i++) {
+                corrected[i] = texture_pool().acquire(GL_R32F, width, height);
+                glBindTextureUnit(i + 3, estimate[i].ID);
+                glBindSampler(i + 3, samplers[i < 2 ? boundary_condition : 3]);
+                glBindImageTexture(i+1, corrected[i].ID, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+            }
+            advectionCS.set_int("pass", 1);
+            glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+            for (int i = 0; i < 3; i++) {
+                std::swap(estimate[i], corrected[i]);
+                texture_pool().release(std::move(corrected[i]));
+            }
+        }
+
+        // The advected fields become the layers and the old layers go back to the pool, a staggered grid advects its own velocity
+        for (int i = 0; i < 6; i++) glBindSampler(i, 0);
+        for (int i = 0; i < 3; i++) {
+            if (layout == 0 || i == 2) std::swap(layers[layer_of[i]], estimate[i]);
+            texture_pool().release(std::move(estimate[i]));
+        }
+        bind();
+        navier_stokesCS.bind();
+        bind_parameter_fields(navier_stokesCS);
+        return;
+    }
+
+    // The same passes on the CPU, see advection.glsl
+    std::vector<float> fields[3] = {read_layer(0), read_layer(1), read_layer(3)};
+    auto sample_field = [&](const std::vector<float>& field, int i, float x, float y) {
+        float value = sample(field, width, height, x, y, wrap_of[i], i < 2 ? wrap_of[i] : 2);
+        if (i < 2) return value;
+        // The dye flows in at 1 through the left edge and out at 0 through the right edge
+        value += (1.0f - value) * std::clamp(-x, 0.0f, 1.0f);
+        return value * (1.0f - std::clamp(x - (width - 1), 0.0f, 1.0f));
+    };
+    auto trace = [&](float x, float y, float direction, float& traced_x, float& traced_y) {
+        float mid_x = x - 0.5f * direction * time_step * sample_field(fields[0], 0, x, y) / space_step;
+        float mid_y = y - 0.5f * direction * time_step * sample_field(fields[1], 1, x, y) / space_step;
+        traced_x = x - direction * time_step * sample_field(fields[0], 0, mid_x, mid_y) / space_step;
+        traced_y = y - direction * time_step * sample_field(fields[1], 1, mid_x, mid_y) / space_step;
+    };
+
+    std::vector<float> estimate[3];
+    for (int i = 0; i < 3; i++) estimate[i].resize(width * height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            float back_x, back_y;
+            trace(x, y, 1.0f, back_x, back_y);
+            for (int i = 0; i < 3; i++) estimate[i][y * width + x] = sample_field(fields[i], i, back_x, back_y);
+        }
+    }
+
+    if (advection == 2) {
+        std::vector<float> corrected[3];
+        for (int i = 0; i < 3; i++) corrected[i].resize(width * height);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                float back_x, back_y, forward_x, forward_y;
+                trace(x, y, 1.0f, back_x, back_y);
+                trace(x, y, -1.0f, forward_x, forward_y);
+                int x0 = (int)std::floor(back_x), y0 = (int)std::floor(back_y);
+                for (int i = 0; i < 3; i++) {
+                    int index = y * width + x;
+                    float value = estimate[i][index] + 0.5f * (fields[i][index] - sample_field(estimate[i], i, forward_x, forward_y));
+                    float low = INFINITY, high = -INFINITY;
+                    for (int corner = 0; corner < 4; corner++) {
+                        float around = texel(fields[i], width, height, x0 + corner % 2, y0 + corner / 2, wrap_of[i], i < 2 ? wrap_of[i] : 2);
+                        if (i == 2 && x0 + corner % 2 < 0) around = 1.0f;
+                        if (i == 2 && x0 + corner % 2 >= width) around = 0.0f;
+                        low = std::min(low, around);
+                        high = std::max(high, around);
+                    }
+                    corrected[i][index] = std::clamp(value, low, high);
+                }
+            }
+        }
+        for (int i = 0; i < 3; i++) estimate[i].swap(corrected[i]);
+    }
+
+    // A staggered grid advects its own velocity, the faces stay valid while only the dye changes
+    bool faces_valid = faces_revision == revision;
+    for (int i = layout == 0 ? 0 : 2; i < 3; i++) write_layer(layer_of[i], estimate[i]);
+    if (faces_valid) faces_revision = revision;
+    bind();
+    navier_stokesCS.bind();
 }
 
 /**
@@ -56,10 +581,45 @@ void NavierStokes::solve() {
 void NavierStokes::gui() {
     ImGui::Text("Viscosity (v)");
     ImGui::SliderFloat("##Viscosity", &viscosity, 0.0, 1.0);
+    ImGui::Text("Grid Layout");
+    ImGui::Combo("##Grid Layout", &layout, options["layout"].names.data(), options["layout"].names.size());
+    ImGui::Text("Pressure Solver");
+    ImGui::Combo("##Pressure Solver", &pressure_solver, options["pressure_solver"].names.data(), options["pressure_solver"].names.size());
+    if (layout == 1 && pressure_solver == 0)
+        ImGui::TextWrapped("The staggered layout is always projected");
+    if (pressure_solver == 2)
+        ImGui::TextWrapped(spectral() ? "Pressure solved exactly with FFTs" : "Needs periodic boundaries, using multigrid");
+    if ((pressure_solver >= 1 || layout == 1) && !spectral()) {
+        ImGui::Text("V-Cycles per Step");
+        ImGui::SliderInt("##V-Cycles", &v_cycles, 1, 8);
+    }
+    if (runge_kutta_method() >= 0) {
+        if (layout == 1) ImGui::TextWrapped("The staggered layout advances the velocity with its own scheme, using Forward Euler");
+        else runge_kutta.gui(runge_kutta_methods()[runge_kutta_method()]);
+    }
+    ImGui::Text("Advection");
+    ImGui::Combo("##Advection", &advection, options["advection"].names.data(), options["advection"].names.size());
+    if (pressure_solver >= 1 || advection != 0 || layout == 1) {
+        bool cpu = cpu_backend;
+        if (ImGui::Checkbox("Advect and Project on CPU", &cpu)) set_backend(cpu);
+    }
     ImGui::Text("Visible Layer");
     ImGui::Combo("##Visible Layer", &visible_layer, visible_layer_strs.data(), visible_layer_strs.size());
     ImGui::Text("Brush Layer");
     ImGui::Combo("##Brush Layer", &brush_layer, brush_layer_strs.data(), brush_layer_strs.size());
+
+    // The spectrum is computed on the GPU, only the shells are read back
+    ImGui::Checkbox("Energy Spectrum", &show_spectrum);
+    if (show_spectrum) {
+        gpu_fft.resize(width, height);
+        gpu_fft.load(layers[0], &layers[1]);
+        gpu_fft.forward();
+        energy = gpu_fft.energy_spectrum();
+
+        std::vector<float> log_energy(energy.size() - 1);
+        for (int k = 1; k < energy.size(); k++) log_energy[k - 1] = std::log10(std::max(energy[k], 1e-12f));
+        ImGui::PlotLines("##Energy Spectrum", log_energy.data(), log_energy.size(), 0, "log10 E(k)", FLT_MAX, FLT_MAX, ImVec2(0, 80));
+    }
 }
 
 /**
@@ -72,6 +632,11 @@ void NavierStokes::reset_settings() {
     space_step = 0.5f;
     time_step = 0.03f;
     boundary_condition = 0;
+    integrator = 0;
+    pressure_solver = 0;
+    v_cycles = 2;
+    advection = 0;
+    layout = 0;
 }
 
 /**
@@ -81,14 +646,20 @@ void NavierStokes::reset_settings() {
  * @param paused Is the simulation paused?
  */
 void NavierStokes::set_uniforms(std::string cmap_str, bool paused) {
+    advance = !paused;
     navier_stokesCS.bind();
     navier_stokesCS.set_bool("paused", paused);
+    navier_stokesCS.set_bool("render_image", render_image);
     navier_stokesCS.set_int("width", width);
     navier_stokesCS.set_int("height", height);
     navier_stokesCS.set_int("boundary_condition", boundary_condition);
     navier_stokesCS.set_float("viscosity", viscosity);
     navier_stokesCS.set_float("dx", space_step);
     navier_stokesCS.set_float("dt", time_step);
+    navier_stokesCS.set_bool("projection", pressure_solver >= 1 || layout == 1);
+    navier_stokesCS.set_bool("advected", advection != 0);
+    navier_stokesCS.set_bool("staggered", layout == 1);
+    navier_stokesCS.set_bool("integrated", layout == 0 && runge_kutta_method() >= 0);
 
     navier_stokesCS.set_int("visible_layer", visible_layer);
     navier_stokesCS.set_int("brush_layer", brush_layer);
@@ -98,5 +669,60 @@ void NavierStokes::set_uniforms(std::string cmap_str, bool paused) {
     navier_stokesCS.set_int("prev_x_pos", prev_x_pos);
     navier_stokesCS.set_int("prev_y_pos", prev_y_pos);
     navier_stokesCS.set_int("brush_radius", brush_radius);
+    bind_parameter_fields(navier_stokesCS);
     apply_cmap(navier_stokesCS, cmap_str);
+}
+
+/**
+ * Recompiles the compute shaders so that every parameter with a field is sampled per cell, with the selected stencils
+ */
+void NavierStokes::compile_shaders() {
+    glDeleteProgram(navier_stokesCS.ID);
+    glDeleteProgram(staggeredCS.ID);
+    navier_stokesCS = ComputeShader("shaders/navier_stokes.glsl", shader_defines());
+    staggeredCS = ComputeShader("shaders/navier_stokes_mac.glsl", shader_defines());
+}
+
+/**
+ * Chooses whether the advection and projection run on the GPU or the CPU
+ * 
+ * @param cpu True to advect and project on the CPU
+ * @return True, both backends are supported
+ */
+bool NavierStokes::set_backend(bool cpu) {
+    cpu_backend = cpu;
+    multigrid.cpu = cpu;
+    return true;
+}
+
+/**
+ * Copies another Navier-Stokes grid, along with the solver settings that are not parameters or options
+ * 
+ * @param other The grid to copy, must be resident
+ */
+void NavierStokes::copy_from(const Grid& other) {
+    Grid::copy_from(other);
+    const NavierStokes& fluid = static_cast<const NavierStokes&>(other);
+    v_cycles = fluid.v_cycles;
+    runge_kutta.tolerance = fluid.runge_kutta.tolerance;
+    runge_kutta.substep = fluid.runge_kutta.substep;
+    show_spectrum = fluid.show_spectrum;
+}
+
+/**
+ * Evicts the layers and gives the multigrid hierarchy and the face velocities back to the pool.
+ * The next projection rebuilds the hierarchy, the next staggered step rebuilds the faces from the restored layers.
+ */
+void NavierStokes::evict() {
+    Grid::evict();
+    multigrid.release();
+    texture_pool().release(std::move(u_faces));
+    texture_pool().release(std::move(v_faces));
+}
+
+/**
+ * @return The amount of video memory held by the grid's textures, the multigrid hierarchy and the face velocities
+ */
+size_t NavierStokes::bytes() const {
+    return Grid::bytes() + multigrid.bytes() + u_faces.bytes() + v_faces.bytes();
 }
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include <glad/glad.h>
+
+#include "reduction.hpp"
+
+#include <cmath>
+#include <cstring>
+
+Reduction::Reduction()
+    : reductionCS("shaders/reduction.glsl")
+{
+}
+
+/**
+ * Finds the largest absolute value of every field with one dispatch per field and a single read back
+ *
+ * @param fields R32F textures, 2D arrays are reduced over their first slice
+ * @return The largest absolute value of every field, a very large value if a field holds NaNs or infinities
+ */
+std::vector<float> Reduction::max_abs(const std::vector<const Texture*>& fields) {
+    size_t size = fields.size() * sizeof(unsigned int);
+    if (maxima.size < size) maxima = Buffer(size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    maxima.clear();
+
+    reductionCS.bind();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, maxima.ID);
+    for (int i = 0; i < fields.size(); i++) {
+        reductionCS.set_bool("difference", false);
+        reductionCS.set_int("index", i);
+        reductionCS.set_int("width", fields[i]->width);
+        reductionCS.set_int("height", fields[i]->height);
+        glBindImageTexture(1, fields[i]->ID, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        glDispatchCompute((fields[i]->width + 15) / 16, (fields[i]->height + 15) / 16, 1);
+    }
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    // Non-negative floats order like their bits, which is how the shader reduces them with atomicMax
+    std::vector<unsigned int> bits(fields.size());
+    std::vector<float> result(fields.size());
+    glGetNamedBufferSubData(maxima.ID, 0, size, bits.data());
+    std::memcpy(result.data(), bits.data(), size);
+    return result;
+}
+
+/**
+ * Finds the root mean square and the largest absolute value of the difference between two sets of fields, e.g. the change of
+ * every layer over a step. The largest value is reduced with an atomic like max_abs, the squares are summed per work group
+ * and only those sums are read back and added up.
+ *
+ * @param fields R32F textures of the same size
+ * @param previous The textures subtracted from each field
+ * @return The norms over every cell of every field, very large if a field holds NaNs or infinities
+ */
+Norms Reduction::difference_norms(const std::vector<const Texture*>& fields, const std::vector<const Texture*>& previous) {
+    Norms norms = {0.0f, 0.0f};
+    if (fields.empty()) return norms;
+    int x_groups = (fields[0]->width + 15) / 16, y_groups = (fields[0]->height + 15) / 16;
+    size_t groups = (size_t)x_groups * y_groups * fields.size();
+    if (sums.size < groups * sizeof(float)) sums = Buffer(groups * sizeof(float), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    if (maxima.size < sizeof(unsigned int)) maxima = Buffer(sizeof(unsigned int), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    maxima.clear();
+
+    reductionCS.bind();
+    reductionCS.set_bool("difference", true);
+    reductionCS.set_int("index", 0);
+    reductionCS.set_int("width", fields[0]->width);
+    reductionCS.set_int("height", fields[0]->height);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, maxima.ID);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, sums.ID);
+    for (int i = 0; i < fields.size(); i++) {
+        reductionCS.set_int("first_group", i * x_groups * y_groups);
+        glBindImageTexture(1, fields[i]->ID, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        glBindImageTexture(2, previous[i]->ID, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        glDispatchCompute(x_groups, y_groups, 1);
+    }
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    unsigned int bits;
+    glGetNamedBufferSubData(maxima.ID, 0, sizeof(unsigned int), &bits);
+    std::memcpy(&norms.max, &bits, sizeof(float));
+
+    std::vector<float> partial(groups);
+    glGetNamedBufferSubData(sums.ID, 0, groups * sizeof(float), partial.data());
+    double sum = 0.0;
+    for (float x : partial) sum += x;
+    norms.l2 = (float)std::sqrt(sum / ((double)fields[0]->width * fields[0]->height * fields.size()));
+    return norms;
+}
\ No newline at end of file
@@ -0,0 +1,254 @@
+#include <glad/glad.h>
+#include <imgui/imgui.h>
+
+#include "runge_kutta.hpp"
+#include "grid.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Passes of runge_kutta.glsl
+enum RungeKuttaPass {
+    PASS_COMBINE = 0,
+    PASS_ERROR
+};
+
+/**
+ * @return Every Runge-Kutta method in the order they are appended to the integrators, see Grid::add_runge_kutta_methods
+ */
+const std::vector<ButcherTableau>& runge_kutta_methods() {
+    static const std::vector<ButcherTableau> methods = {
+        // Heun's method, the second order strong stability preserving method
+        {"RK2", {{}, {1.0f}}, {0.5f, 0.5f}, {}, 2, false, 2.0f},
+        // Third order strong stability preserving method of Shu and Osher
+        {"SSP-RK3", {{}, {1.0f}, {0.25f, 0.25f}}, {1.0f / 6.0f, 1.0f / 6.0f, 2.0f / 3.0f}, {}, 3, false, 2.51f},
+        // The classical fourth order method
+        {"RK4", {{}, {0.5f}, {0.0f, 0.5f}, {0.0f, 0.0f, 1.0f}}, {1.0f / 6.0f, 1.0f / 3.0f, 1.0f / 3.0f, 1.0f / 6.0f}, {}, 4, false, 2.79f},
+        // Dormand-Prince 5(4), the fifth order solution is kept and the fourth order one estimates the error
+        {"RK45", {
+            {},
+            {1.0f / 5.0f},
+            {3.0f / 40.0f, 9.0f / 40.0f},
+            {44.0f / 45.0f, -56.0f / 15.0f, 32.0f / 9.0f},
+            {19372.0f / 6561.0f, -25360.0f / 2187.0f, 64448.0f / 6561.0f, -212.0f / 729.0f},
+            {9017.0f / 3168.0f, -355.0f / 33.0f, 46732.0f / 5247.0f, 49.0f / 176.0f, -5103.0f / 18656.0f},
+            {35.0f / 384.0f, 0.0f, 500.0f / 1113.0f, 125.0f / 192.0f, -2187.0f / 6784.0f, 11.0f / 84.0f}
+        }, {35.0f / 384.0f, 0.0f, 500.0f / 1113.0f, 125.0f / 192.0f, -2187.0f / 6784.0f, 11.0f / 84.0f, 0.0f},
+           {71.0f / 57600.0f, 0.0f, -71.0f / 16695.0f, 71.0f / 1920.0f, -17253.0f / 339200.0f, 22.0f / 525.0f, -1.0f / 40.0f}, 4, true, 3.31f}
+    };
+    return methods;
+}
+
+/**
+ * Copies every layer of a grid from or into the slices of a 2D array texture
+ *
+ * @param save True to copy the layers into the array, false to restore them from it
+ */
+static void copy_layers(Grid& grid, const Texture& array, bool save) {
+    for (int l = 0; l < grid.layers.size(); l++) {
+        if (save) glCopyImageSubData(grid.layers[l].ID, GL_TEXTURE_2D, 0, 0, 0, 0, array.ID, GL_TEXTURE_2D_ARRAY, 0, 0, 0, l, grid.width, grid.height, 1);
+        else glCopyImageSubData(array.ID, GL_TEXTURE_2D_ARRAY, 0, 0, 0, l, grid.layers[l].ID, GL_TEXTURE_2D, 0, 0, 0, 0, grid.width, grid.height, 1);
+    }
+}
+
+RungeKutta::RungeKutta()
+    : runge_kuttaCS("shaders/runge_kutta.glsl")
+{
+    tolerance = 1e-3f;
+    substep = 0.0f;
+    substeps = 0;
+    rejected = 0;
+    reduction = Buffer(sizeof(unsigned int), nullptr, GL_DYNAMIC_STORAGE_BIT);
+}
+
+/**
+ * Advances every layer of a grid by one time step. Adaptive methods take as many substeps as the tolerance requires,
+ * starting from the substep size the previous step settled on.
+ *
+ * @param grid The grid to advance, its layers hold the state and evaluate_rates gives its time derivative
+ * @param method The Runge-Kutta method
+ * @param dt Size of the time step
+ */
+void RungeKutta::step(Grid& grid, const ButcherTableau& method, float dt) {
+    int stages = method.b.size(), layers = grid.layers.size();
+    Texture base = texture_pool().acquire(GL_R32F, grid.width, grid.height, 1, layers);
+    std::vector<Texture> rates;
+    for (int i = 0; i < stages; i++) rates.push_back(texture_pool().acquire(GL_R32F, grid.width, grid.height, 1, layers));
+
+    bool adaptive = !method.error.empty();
+    float proposal = adaptive && substep > 0.0f ? substep : dt;
+    float done = 0.0f;
+    bool first_rates = false; // Whether the rates of the first stage are already known from the previous substep
+    substeps = 0;
+    rejected = 0;
+
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+    while (dt - done > 1e-6f * dt) {
+        float h = std::min(proposal, dt - done);
+        copy_layers(grid, base, true);
+        for (int i = 0; i < stages; i++) {
+            if (i > 0) combine(grid, base, rates, method.a[i], h);
+            if (i == 0 && first_rates) continue;
+            grid.evaluate_rates(rates[i]);
+            glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        }
+        if (!method.fsal) combine(grid, base, rates, method.b, h);
+        substeps++;
+        if (!adaptive) break;
+
+        // Standard step size control, with the step size floored so that a stiff state cannot stall the sandbox
+        float error = estimate_error(grid, base, rates, method.error, h);
+        float factor = std::clamp(0.9f * std::pow(std::max(error, 1e-10f), -1.0f / (method.order + 1)), 0.2f, 5.0f);
+        if (error <= 1.0f || h <= dt / 1024.0f) {
+            done += h;
+            proposal = std::min(dt, h < proposal ? std::max(proposal, h * factor) : h * factor);
+            if (method.fsal) std::swap(rates[0], rates[stages - 1]);
+            first_rates = method.fsal;
+        } else {
+            // The rates of the first stage still belong to the state the substep is retried from
+            copy_layers(grid, base, false);
+            glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+            proposal = h * factor;
+            first_rates = true;
+            rejected++;
+        }
+    }
+    if (adaptive) substep = proposal;
+
+    texture_pool().release(std::move(base));
+    for (Texture& texture : rates) texture_pool().release(std::move(texture));
+}
+
+/**
+ * Advances every layer of a grid by one step of the second order Runge-Kutta-Legendre method (RKL2) of Meyer, Balsara
+ * and Aslam. Its stages follow the recursion of the Legendre polynomials, so the stable interval grows with the square of
+ * the number of stages while every stage costs one evaluation of the explicit stencil. Meant for diffusions, whose rates
+ * are real and negative.
+ *
+ * @param grid The grid to advance, evaluate_rates gives the diffusion of its layers
+ * @param dt Size of the time step
+ * @param stages Number of stages, see super_stages
+ */
+void RungeKutta::super_step(Grid& grid, float dt, int stages) {
+    int layers = grid.layers.size();
+    Texture base = texture_pool().acquire(GL_R32F, grid.width, grid.height, 1, layers);
+    Texture base_rates = texture_pool().acquire(GL_R32F, grid.width, grid.height, 1, layers);
+    Texture rates = texture_pool().acquire(GL_R32F, grid.width, grid.height, 1, layers);
+    Texture previous[2] = {
+        texture_pool().acquire(GL_R32F, grid.width, grid.height, 1, layers),
+        texture_pool().acquire(GL_R32F, grid.width, grid.height, 1, layers)
+    };
+
+    auto b = [](int j) { return j < 2 ? 1.0f / 3.0f : (j * j + j - 2.0f) / (2.0f * j * (j + 1.0f)); };
+    float w1 = 4.0f / (stages * stages + stages - 2.0f);
+
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+    copy_layers(grid, base, true);
+    grid.evaluate_rates(base_rates);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    dispatch(grid, PASS_COMBINE, base, 1.0f, {&base_rates}, {b(1) * w1}, dt);
+
+    // Every stage combines the two before it, the first stage and the rates of the last and first stages
+    const Texture* older = &base;
+    for (int j = 2; j <= stages; j++) {
+        const Texture& last = previous[j % 2];
+        glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+        copy_layers(grid, last, true);
+        grid.evaluate_rates(rates);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        float mu = (2.0f * j - 1.0f) / j * b(j) / b(j - 1);
+        float nu = -(j - 1.0f) / j * b(j) / b(j - 2);
+        float mu_dt = mu * w1 * dt;
+        float gamma_dt = -(1.0f - b(j - 1)) * mu_dt;
+        dispatch(grid, PASS_COMBINE, base, 1.0f - mu - nu, {&last, older, &rates, &base_rates}, {mu, nu, mu_dt, gamma_dt}, 1.0f);
+        older = &last;
+    }
+
+    texture_pool().release(std::move(base));
+    texture_pool().release(std::move(base_rates));
+    texture_pool().release(std::move(rates));
+    for (Texture& texture : previous) texture_pool().release(std::move(texture));
+}
+
+/**
+ * @param ratio The time step over the largest stable forward Euler step
+ * @return The fewest RKL2 stages whose stable interval, (s^2 + s - 2) / 4 forward Euler steps, covers the time step
+ */
+int RungeKutta::super_stages(float ratio) {
+    return std::max(2, (int)std::ceil((std::sqrt(9.0f + 16.0f * ratio) - 1.0f) / 2.0f));
+}
+
+/**
+ * Shows the settings of adaptive methods
+ *
+ * @param method The selected method
+ */
+void RungeKutta::gui(const ButcherTableau& method) {
+    if (method.error.empty()) return;
+    ImGui::Text("Tolerance");
+    ImGui::SliderFloat("##Tolerance", &tolerance, 1e-6f, 1e-1f, "%.0e", ImGuiSliderFlags_Logarithmic);
+    ImGui::Text("Substeps: %d (%d rejected)", substeps, rejected);
+}
+
+/**
+ * Writes base + h * sum(weights[j] * rates[j]) into the layers of the grid
+ */
+void RungeKutta::combine(Grid& grid, const Texture& base, const std::vector<Texture>& rates, const std::vector<float>& weights, float h) {
+    std::vector<const Texture*> textures;
+    for (const Texture& texture : rates) textures.push_back(&texture);
+    dispatch(grid, PASS_COMBINE, base, 1.0f, textures, weights, h);
+}
+
+/**
+ * @return The largest error of the substep that just ended over every cell and layer, scaled by the tolerance
+ */
+float RungeKutta::estimate_error(Grid& grid, const Texture& base, const std::vector<Texture>& rates, const std::vector<float>& weights, float h) {
+    reduction.clear();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, reduction.ID);
+    std::vector<const Texture*> textures;
+    for (const Texture& texture : rates) textures.push_back(&texture);
+    dispatch(grid, PASS_ERROR, base, 1.0f, textures, weights, h);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    // Non-negative floats order like their bits, which is how the shader reduces them with atomicMax
+    unsigned int bits;
+    float error;
+    glGetNamedBufferSubData(reduction.ID, 0, sizeof(bits), &bits);
+    std::memcpy(&error, &bits, sizeof(error));
+    return error;
+}
+
+/**
+ * Runs a pass of runge_kutta.glsl over every layer of the grid
+ *
+ * @param grid The grid whose layers are written or read as the state
+ * @param pass One of RungeKuttaPass
+ * @param base Every layer at the start of the substep
+ * @param base_weight Coefficient of base in the combined state
+ * @param rates Rates of the stages (or earlier stages), the first weights.size() are read
+ * @param weights Coefficients of the rates
+ * @param h Size of the substep
+ */
+void RungeKutta::dispatch(Grid& grid, int pass, const Texture& base, float base_weight, const std::vector<const Texture*>& rates, const std::vector<float>& weights, float h) {
+    runge_kuttaCS.bind();
+    runge_kuttaCS.set_int("pass", pass);
+    runge_kuttaCS.set_int("width", grid.width);
+    runge_kuttaCS.set_int("height", grid.height);
+    runge_kuttaCS.set_int("stages", weights.size());
+    runge_kuttaCS.set_float("tolerance", tolerance);
+    runge_kuttaCS.set_float("base_weight", base_weight);
+    for (int j = 0; j < weights.size(); j++) {
+        runge_kuttaCS.set_float("weights[" + std::to_string(j) + "]", h * weights[j]);
+        glBindTextureUnit(j, rates[j]->ID);
+    }
+
+    glBindImageTexture(2, base.ID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32F);
+    for (int l = 0; l < grid.layers.size(); l++) {
+        runge_kuttaCS.set_int("layer", l);
+        glBindImageTexture(1, grid.layers[l].ID, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+        glDispatchCompute((grid.width + 7) / 8, (grid.height + 7) / 8, 1);
+    }
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+}
\ No newline at end of file
@@ -1,40 +1,66 @@
 #include <imgui/imgui.h>
 #include <imgui/backends/imgui_impl_glfw.h>
 #include <imgui/backends/imgui_impl_opengl3.h>
+#include <glad/glad.h>
 
 #include "sandbox.hpp"
 #include "heat.hpp"
 #include "gray_scott.hpp"
 #include "wave.hpp"
 #include "navier_stokes.hpp"
+#include "gray_scott_ensemble.hpp"
+#include "lattice_boltzmann.hpp"
 #include "color_maps.hpp"
+#include "scenario.hpp"
+#include "texture.hpp"
 
 #include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
 
-Sandbox::Sandbox(int window_width, int window_height, int gui_width) {
-	grids.emplace_back(std::make_shared<Heat>(window_width, window_height));
-	grids.emplace_back(std::make_shared<GrayScott>(window_width, window_height));
-	grids.emplace_back(std::make_shared<Wave>(window_width, window_height));
-	grids.emplace_back(std::make_shared<NavierStokes>(window_width, window_height));
-
+Sandbox::Sandbox(int window_width, int window_height, int gui_width) 
+    : downsampleCS("shaders/downsample.glsl")
+{
     this->window_width = window_width;
     this->window_height = window_height;
     this->gui_width = gui_width;
+    grid_width = 0;
+    grid_height = 0;
+    resize_pending = false;
 
     paused = false;
+    step = 0;
+    steps_per_frame = 10;
+    journal_mode = JournalMode::Off;
+    memory_budget = 512;
+    field_parameter = 0;
+    field_mode = 0;
+    field_range[0] = 0.0f;
+    field_range[1] = 1.0f;
+    selections = 0;
+    reduction = std::make_unique<Reduction>();
 
-    cmap = 1; // Set default color map to "Inferno"
-    sim = 0; // Set default simulation to "Heat Equation"
+    tiles.push_back({nullptr, 0, 1}); // The first tile, its grid is created by select_sim and drawn with "Inferno"
+    focus = 0;
+    reset_view();
 
     // Initialize the dropdown lists
     for (const auto& kp : cmaps) cmap_strs.push_back(kp.first.c_str());
     sim_strs.resize(3); 
-    sim_strs = {"Heat Equation", "Gray-Scott Reaction Diffusion", "Wave Equation", "Navier-Stokes Fluid Flow"};
+    sim_strs = {"Heat Equation", "Gray-Scott Reaction Diffusion", "Wave Equation", "Navier-Stokes Fluid Flow", "Gray-Scott Ensemble", "Lattice Boltzmann Fluid Flow"};
+    sim_ids = {"heat", "gray_scott", "wave", "navier_stokes", "gray_scott_ensemble", "lattice_boltzmann"};
     boundary_condition_strs.resize(3); 
     boundary_condition_strs = {"Dirichlet", "Neumann", "Periodic"};
+    stencil_strs = {"2nd Order (5 Point)", "4th Order (9 Point)", "6th Order (13 Point)"};
+    steady_norm_strs = {"Root Mean Square (L2)", "Largest Change (Max)"};
+    resample_filter_strs = {"Bilinear", "Conservative"};
 
-    reset_grid();
-    reset_settings();
+    // Grids are only created once their simulation is selected
+    grids.resize(sim_strs.size());
+    last_selected.resize(sim_strs.size(), 0);
+    select_sim(0); // Set default simulation to "Heat Equation"
 }
 
 /**
@@ -60,73 +86,381 @@ void Sandbox::render_gui() {
     ImGui::SeparatorText("Simulation");
     ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x);
     ImGui::Text("Simulation");
-    if (ImGui::Combo("##Simulation", &sim, sim_strs.data(), sim_strs.size())) {
-        reset_settings();
-        reset_grid();
+    int selected = tiles[focus].sim;
+    if (ImGui::Combo("##Simulation", &selected, sim_strs.data(), sim_strs.size())) {
+        if (focus == 0) {
+            select_sim(selected);
+        } else {
+            tiles[focus] = {create_grid(selected), selected, tiles[focus].cmap};
+            fit_grid(*tiles[focus].grid);
+        }
+    }
+    Grid& grid = *tiles[focus].grid;
+    bool fixed_size = grid_width > 0 && grid_height > 0;
+    if (ImGui::Checkbox("Fixed Grid Size", &fixed_size))
+        set_grid_size(fixed_size ? grid.width : 0, fixed_size ? grid.height : 0);
+    if (fixed_size) {
+        int size[2] = {grid_width, grid_height};
+        ImGui::Text("Grid Size (Cells, Enter to Apply)");
+        if (ImGui::InputInt2("##Grid Size", size, ImGuiInputTextFlags_EnterReturnsTrue)) set_grid_size(size[0], size[1]);
+    } else {
+        ImGui::Text("Resolution (Pixels per Cell)");
+        if (ImGui::SliderInt("##Resolution (Pixels per Cell)", &grid.resolution, 1, 20)) fit_grid(grid);
+    }
+    ImGui::Text("Resize Filter");
+    ImGui::Combo("##Resize Filter", &grid.resample_filter, resample_filter_strs.data(), resample_filter_strs.size());
+    ImGui::Text("GPU Memory: %.1f MB (Budget in MB)", gpu_memory() / (1024.0f * 1024.0f));
+    if (ImGui::SliderInt("##Memory Budget", &memory_budget, 64, 8192)) enforce_memory_budget();
+    ImGui::Text("Space Step");    ImGui::SliderFloat("##Space Step", &grid.space_step, 0.1, 5.0);
+    if (grid.adaptive_supported) ImGui::Checkbox("Adaptive Time Step", &grid.adaptive_time_step);
+    if (grid.adaptive_time_step) {
+        ImGui::Text("Time Step: %.4g", grid.time_step);
+        if (*grid.limited_by) ImGui::TextWrapped("Limited by %s", grid.limited_by);
+        ImGui::Text("Safety Factor"); ImGui::SliderFloat("##Safety Factor", &grid.safety, 0.1, 1.0);
+        ImGui::Text("Max Time Step"); ImGui::SliderFloat("##Max Time Step", &grid.max_time_step, 0.01, 100.0, "%.2f", ImGuiSliderFlags_Logarithmic);
+        ImGui::Text("Steps per Estimate"); ImGui::SliderInt("##Steps per Estimate", &grid.adapt_every, 1, 100);
+    } else {
+        ImGui::Text("Time Step");     ImGui::SliderFloat("##Time Step", &grid.time_step, 0.01, 0.5);
+    }
+    if (grid.steady_supported) ImGui::Checkbox("Stop at Steady State", &grid.steady_state);
+    if (grid.steady_supported && grid.steady_state) {
+        ImGui::Text("Residual Norm"); ImGui::Combo("##Residual Norm", &grid.steady_norm, steady_norm_strs.data(), steady_norm_strs.size());
+        ImGui::Text("Steady State Tolerance");
+        ImGui::SliderFloat("##Steady State Tolerance", &grid.steady_tolerance, 1e-8f, 1e-1f, "%.0e", ImGuiSliderFlags_Logarithmic);
+        ImGui::Text("Steps per Residual"); ImGui::SliderInt("##Steps per Residual", &grid.residual_every, 1, 100);
+
+        // The residuals are the change per unit time of every measured step, plotted on a log scale
+        const std::vector<float>& residuals = grid.steady_norm == 0 ? grid.residual_l2 : grid.residual_max;
+        if (!residuals.empty()) {
+            ImGui::Text("Residual: %.3g (RMS %.3g, Max %.3g)", residuals.back(), grid.residual_l2.back(), grid.residual_max.back());
+            std::vector<float> log_residuals(residuals.size());
+            for (int i = 0; i < residuals.size(); i++) log_residuals[i] = std::log10(std::max(residuals[i], 1e-30f));
+            ImGui::PlotLines("##Residual", log_residuals.data(), log_residuals.size(), 0, "log10 residual", FLT_MAX, FLT_MAX, ImVec2(0, 80));
+        }
+        if (grid.converged) ImGui::TextWrapped("Converged, the residual is below the tolerance");
+    }
+    ImGui::Text("Boundary Condition"); ImGui::Combo("##Boundary Condition", &grid.boundary_condition, boundary_condition_strs.data(), boundary_condition_strs.size());
+    if (grid.stencils_supported) {
+        int stencil = grid.stencil_order / 2 - 1;
+        ImGui::Text("Spatial Stencil");
+        if (ImGui::Combo("##Spatial Stencil", &stencil, stencil_strs.data(), stencil_strs.size())) grid.set_stencil_order(2 * stencil + 2);
+    }
+    if (grid.integrator_strs.size() > 1) {
+        ImGui::Text("Time Integration"); ImGui::Combo("##Time Integration", &grid.integrator, grid.integrator_strs.data(), grid.integrator_strs.size());
     }
-    ImGui::Text("Resolution (Pixels per Cell)");
-    if (ImGui::SliderInt("##Resolution (Pixels per Cell)", &grids[sim]->resolution, 1, 20))
-        grids[sim]->resize((window_width - gui_width) / grids[sim]->resolution, window_height / grids[sim]->resolution);
-    ImGui::Text("Space Step");    ImGui::SliderFloat("##Space Step", &grids[sim]->space_step, 0.1, 5.0);
-    ImGui::Text("Time Step");     ImGui::SliderFloat("##Time Step", &grids[sim]->time_step, 0.01, 0.5);
-    ImGui::Text("Boundary Condition"); ImGui::Combo("##Boundary Condition", &grids[sim]->boundary_condition, boundary_condition_strs.data(), boundary_condition_strs.size());
 
     // Control Buttons
     if (ImGui::Button(paused ? "Unpause" : "Pause")) paused = !paused;
-    ImGui::SameLine(); if (ImGui::Button("Reset Grid")) grids[sim]->clear();
+    ImGui::SameLine(); if (ImGui::Button("Reset Grid")) reset_grid();
     ImGui::SameLine(); if (ImGui::Button("Reset Settings")) reset_settings();
 
     // Brush Section
     ImGui::SeparatorText("Brush");
     ImGui::Text("Brush Radius"); 
-    ImGui::SliderInt("##Brush Radius", &(grids[sim]->brush_radius), 1, 100);
+    ImGui::SliderInt("##Brush Radius", &grid.brush_radius, 1, 100);
+
+    // Parameter Fields Section
+    if (grid.fields_supported) {
+        std::vector<const char*> names;
+        for (const auto& kp : grid.parameters) names.push_back(kp.first.c_str());
+        field_parameter = std::min(field_parameter, (int)names.size() - 1);
+        std::string name = names[field_parameter];
+
+        ImGui::SeparatorText("Parameter Fields");
+        ImGui::Text("Parameter");
+        if (ImGui::Combo("##Field Parameter", &field_parameter, names.data(), names.size())) {
+            // Show the current layout of the newly chosen parameter
+            name = names[field_parameter];
+            auto it = grid.parameter_fields.find(name);
+            field_mode = it == grid.parameter_fields.end() || it->second.axis == 2 ? 0 : it->second.axis + 1;
+            if (field_mode > 0) {
+                field_range[0] = it->second.from;
+                field_range[1] = it->second.to;
+            }
+        }
+        const char* field_mode_strs[] = {"Uniform", "Ramp Along X", "Ramp Along Y"};
+        ImGui::Text("Layout");
+        ImGui::Combo("##Field Layout", &field_mode, field_mode_strs, 3);
+        if (field_mode > 0) {
+            ImGui::Text("From, To");
+            ImGui::InputFloat2("##Field Range", field_range);
+        }
+        if (ImGui::Button("Apply Field")) {
+            if (field_mode == 0) grid.remove_parameter_field(name);
+            else grid.set_parameter_ramp(name, field_mode - 1, field_range[0], field_range[1]);
+        }
+    }
 
     // Visual Section
     ImGui::SeparatorText("Visual");
     ImGui::Text("Color Map");
-    ImGui::Combo("##Color Map", &cmap, cmap_strs.data(), cmap_strs.size());
-    if (ImGui::Checkbox("Pixelated", &grids[sim]->pixelated)) grids[sim]->set_pixelated();
+    ImGui::Combo("##Color Map", &tiles[focus].cmap, cmap_strs.data(), cmap_strs.size());
+    if (ImGui::Checkbox("Pixelated", &grid.pixelated)) grid.set_pixelated();
+    ImGui::Text("Zoom: %.2fx (Scroll to Zoom, Right Drag to Pan)", zoom);
+    if (ImGui::Button("Reset View")) reset_view();
+    ImGui::Text("Tiles: %d (Click a Tile to Edit It)", (int)tiles.size());
+    if (ImGui::Button("Add Tile")) add_tile();
+    ImGui::SameLine(); bool remove = ImGui::Button("Remove Tile");
     ImGui::PopItemWidth();
 
+    if (journal_mode == JournalMode::Record) {
+        ImGui::Text("Recording: %d events", (int)journal.events.size());
+    } else if (journal_mode == JournalMode::Replay) {
+        ImGui::Text("Replaying: step %u of %u%s", step, journal.last_step(), journal.finished() ? " (done)" : "");
+    }
+
 
     // PDE specific section
-    ImGui::SeparatorText(sim_strs[sim]);
+    ImGui::SeparatorText(sim_strs[tiles[focus].sim]);
     ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x);
-    grids[sim]->gui();
+    grid.gui();
 
 
     ImGui::PopItemWidth();
     ImGui::PopStyleColor(2);
     ImGui::PopStyleVar(3);
     ImGui::End();
+
+    // Removed last since the settings above refer to the focused grid
+    if (remove) remove_tile();
+}
+
+/**
+ * Switches the first tile to another simulation. Its grid is created on first selection, and brought back from host memory
+ * if it was evicted, so switching back and forth never loses any state.
+ * 
+ * @param index Index of the simulation to select
+ */
+void Sandbox::select_sim(int index) {
+    sim = index;
+    focus = 0;
+    last_selected[sim] = ++selections;
+    if (!grids[sim]) grids[sim] = create_grid(sim);
+    grids[sim]->restore();
+    tiles[0].grid = grids[sim];
+    tiles[0].sim = sim;
+    fit_grid(*grids[sim]);
+    grids[sim]->bind();
+}
+
+/**
+ * Constructs the grid of a simulation without any textures, they are allocated once the grid is given a size
+ * 
+ * @param index Index of the simulation, see sim_strs
+ * @return The new grid
+ */
+std::shared_ptr<Grid> Sandbox::create_grid(int index) {
+    switch (index) {
+        case 0: return std::make_shared<Heat>(0, 0);
+        case 1: return std::make_shared<GrayScott>(0, 0);
+        case 2: return std::make_shared<Wave>(0, 0);
+        case 3: return std::make_shared<NavierStokes>(0, 0);
+        case 4: return std::make_shared<GrayScottEnsemble>(0, 0);
+        default: return std::make_shared<LatticeBoltzmann>(0, 0);
+    }
+}
+
+/**
+ * Gives a grid the explicit grid size, or the size derived from the window and its resolution.
+ * A minimized window leaves no viewport to derive a size from, the grid then keeps its size and state.
+ * 
+ * @param grid The grid to resize
+ */
+void Sandbox::fit_grid(Grid& grid) {
+    // A replayed grid keeps the dimensions the journal was recorded with
+    if (journal_mode == JournalMode::Replay && &grid == grids[sim].get() && grid.width > 0) return;
+
+    bool viewport_empty = window_width - gui_width <= 0 || window_height <= 0;
+    if (grid_width > 0 && grid_height > 0) grid.resize(grid_width, grid_height);
+    else if (viewport_empty && grid.width > 0) return;
+    else grid.resize((window_width - gui_width) / grid.resolution, window_height / grid.resolution);
+    enforce_memory_budget();
+}
+
+/**
+ * Adds a tile running a copy of the focused tile, with the same simulation, settings, parameters and current state,
+ * so that the copy can be given different parameters and compared side by side
+ */
+void Sandbox::add_tile() {
+    const Tile& source = tiles[focus];
+    Tile tile = {create_grid(source.sim), source.sim, source.cmap};
+    source.grid->sync();
+    tile.grid->copy_from(*source.grid);
+    tiles.push_back(tile);
+    focus = tiles.size() - 1;
+    enforce_memory_budget();
 }
 
 /**
- *  Resizes all grids to the specified dimensions while also clearing them
+ * Removes the focused tile, the first tile always stays
+ */
+void Sandbox::remove_tile() {
+    if (focus == 0) return;
+    tiles.erase(tiles.begin() + focus);
+    focus = 0;
+    grids[sim]->bind();
+}
+
+/**
+ * Splits the viewport into a near-square arrangement of equally sized tiles
+ * 
+ * @param index Index of the tile
+ * @return The position and size of the tile in window pixels, measured from the top left of the window
+ */
+glm::vec4 Sandbox::tile_rect(int index) {
+    int columns = (int)std::ceil(std::sqrt((float)tiles.size()));
+    int rows = ((int)tiles.size() + columns - 1) / columns;
+    float width = (float)(window_width - gui_width) / columns;
+    float height = (float)window_height / rows;
+    return glm::vec4((index % columns) * width, (index / columns) * height, width, height);
+}
+
+/**
+ * @return The index of the tile under a position in the window, or the nearest tile if there is none
+ */
+int Sandbox::tile_at(double x_pos, double y_pos) {
+    for (int i = 0; i < tiles.size(); i++) {
+        glm::vec4 rect = tile_rect(i);
+        if (x_pos >= rect.x && x_pos < rect.x + rect.z && y_pos >= rect.y && y_pos < rect.y + rect.w) return i;
+    }
+    return 0;
+}
+
+/**
+ * Evicts the least recently used inactive grids to host memory until the resident grids fit in the memory budget,
+ * then frees idle pooled textures that do not fit in what is left
+ */
+void Sandbox::enforce_memory_budget() {
+    size_t budget = (size_t)memory_budget * 1024 * 1024;
+    size_t used = 0;
+    for (const auto& grid : grids)
+        if (grid) used += grid->bytes();
+    for (int i = 1; i < tiles.size(); i++) used += tiles[i].grid->bytes();
+
+    while (used > budget) {
+        int victim = -1;
+        for (int i = 0; i < grids.size(); i++)
+            if (i != sim && grids[i] && grids[i]->resident && (victim < 0 || last_selected[i] < last_selected[victim])) victim = i;
+        if (victim < 0) break;
+
+        used -= grids[victim]->bytes();
+        grids[victim]->evict();
+    }
+    texture_pool().trim(used < budget ? budget - used : 0);
+    grids[sim]->bind();
+}
+
+/**
+ * @return The video memory held by resident grids, extra tiles and idle pooled textures, in bytes
+ */
+size_t Sandbox::gpu_memory() {
+    size_t used = texture_pool().idle_bytes;
+    for (const auto& grid : grids)
+        if (grid) used += grid->bytes();
+    for (int i = 1; i < tiles.size(); i++) used += tiles[i].grid->bytes();
+    return used;
+}
+
+/**
+ * Resizes the grids of every tile to match the window. Layers are resampled so no simulation state is lost.
  * 
  * @param window_width The new width of the application window
  * @param window_height The new height of the application window
  * @param gui_width The new width of the sidebar UI
+ * @param debounce If true, the grids are only reallocated once the window size has settled, see apply_pending_resize
  */
-void Sandbox::resize(int window_width, int window_height, int gui_width) {
+void Sandbox::resize(int window_width, int window_height, int gui_width, bool debounce) {
     this->window_width = window_width;
     this->window_height = window_height;
     this->gui_width = gui_width;
 
-	for (int i = 0; i < grids.size(); i++)
-		grids[i]->resize((window_width - gui_width) / grids[sim]->resolution, window_height / grids[sim]->resolution);
+    resize_pending = true;
+    resize_requested = std::chrono::steady_clock::now();
+    if (!debounce) apply_pending_resize(true);
 }
 
 /**
- * Advances one time step in the simulation
+ * Reallocates the grids of every tile for the latest window size once it has stopped changing, so that dragging the
+ * window edge does not resample them on every frame. Grids that are not shown catch up when they are selected again.
+ * 
+ * @param force Apply the resize immediately, even if the window size changed very recently
  */
-void Sandbox::advance_step() {
-    grids[sim]->set_uniforms(cmap_strs[cmap], paused);
-    grids[sim]->solve();
+void Sandbox::apply_pending_resize(bool force) {
+    if (!resize_pending) return;
+    if (!force && std::chrono::steady_clock::now() - resize_requested < std::chrono::milliseconds(250)) return;
+    resize_pending = false;
+
+    for (Tile& tile : tiles) fit_grid(*tile.grid);
 }
 
 /**
- * Binds the currently selected grid
+ * Gives the grids an explicit size that no longer follows the window, or goes back to deriving it from the window
+ * 
+ * @param width Width of the grids in cells, or 0 to derive the size from the window and resolution
+ * @param height Height of the grids in cells, or 0 to derive the size from the window and resolution
+ */
+void Sandbox::set_grid_size(int width, int height) {
+    int max_size;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+    grid_width = std::clamp(width, 0, max_size);
+    grid_height = std::clamp(height, 0, max_size);
+
+    if (grid_width == 0 || grid_height == 0) {
+        grid_width = 0;
+        grid_height = 0;
+    }
+    for (Tile& tile : tiles) fit_grid(*tile.grid);
+    reset_view();
+}
+
+/**
+ * Advances one time step in the simulation of every tile. Paused frames still apply the brush and render, but do not count
+ * as a step, so journals replay their events at the same simulation step however long the recording or replay was paused.
+ * 
+ * @param render_image Whether the color mapped output image should be written on this step
+ */
+void Sandbox::advance_step(bool render_image) {
+    // Strokes that were painted while paused are replayed one paused frame each
+    bool replay_pending = journal_mode == JournalMode::Replay && journal.replay(step, *grids[sim]);
+    bool advancing = !paused && !replay_pending;
+
+    // The output image is only needed when it is about to be displayed or written out
+    bool output_due = advancing && scenario.output_every > 0 && (step + 1) % scenario.output_every == 0;
+
+    // Every tile is dispatched in turn, so the simulations advance together and share the GPU
+    bool steady = false;
+    for (int i = 0; i < tiles.size(); i++) {
+        Grid& grid = *tiles[i].grid;
+        // Measured steps also write the output image, so that it is up to date if the grid stops there
+        bool measured = advancing && grid.start_residual();
+        grid.bind();
+        grid.render_image = render_image || (i == 0 && output_due) || measured;
+        grid.set_uniforms(cmap_strs[tiles[i].cmap], !advancing);
+        if (advancing && grid.adapt_time_step()) {
+            // The estimate changed the time step and left its own bindings behind
+            grid.bind();
+            grid.set_uniforms(cmap_strs[tiles[i].cmap], !advancing);
+        }
+        grid.solve();
+        if (measured && grid.finish_residual(*reduction) && i == 0) steady = true;
+    }
+    if (!advancing) return;
+    step++;
+
+    if (scenario.output_every > 0 && step % scenario.output_every == 0)
+        scenario.write_outputs(*grids[sim], step);
+
+    // The first tile reached its steady state, headless runs stop here and write the converged field
+    if (steady) {
+        Grid& grid = *grids[sim];
+        std::cout << "Reached a steady state after " << step << " steps, residual " << grid.residual_l2.back() << " (RMS) and "
+                  << grid.residual_max.back() << " (max)" << std::endl;
+        paused = true;
+    }
+}
+
+/**
+ * Binds the grid of the first tile
  */
 void Sandbox::bind_current_grid() {
     grids[sim]->bind();
@@ -139,22 +473,353 @@ void Sandbox::bind_current_grid() {
  * @param y_pos Y coordinate in window space as taken from the mouse
  */
 void Sandbox::brush(double x_pos, double y_pos) {
-    grids[sim]->brush(
-        (int)(x_pos / (window_width - gui_width) * grids[sim]->width), 
-        (int)(y_pos / window_height * grids[sim]->height)
-    );
+    // Brushing a tile also focuses it in the sidebar
+    int tile = tile_at(x_pos, y_pos);
+    if (tile != focus) release_brush();
+    focus = tile;
+    if (focus == 0 && journal_mode == JournalMode::Replay) return;
+
+    Grid& grid = *tiles[focus].grid;
+    glm::vec2 uv = window_to_uv(x_pos, y_pos, focus);
+    int grid_x = (int)std::floor(uv.x * grid.width);
+    int grid_y = (int)std::floor(uv.y * grid.height);
+    grid.brush(grid_x, grid_y);
+
+    // Only the first tile is journaled
+    if (focus == 0 && journal_mode == JournalMode::Record)
+        journal.record(step, BrushEventKind::Stroke, grid_x, grid_y, grid);
+}
+
+/**
+ * Lifts the brush from every tile
+ */
+void Sandbox::release_brush() {
+    for (int i = 1; i < tiles.size(); i++) tiles[i].grid->brush_enabled = 0;
+    if (journal_mode == JournalMode::Replay || !grids[sim]->brush_enabled) return;
+
+    grids[sim]->brush_enabled = false;
+    if (journal_mode == JournalMode::Record)
+        journal.record(step, BrushEventKind::Release, grids[sim]->x_pos, grids[sim]->y_pos, *grids[sim]);
+}
+
+/**
+ * Clears the currently selected grid and starts recording every brush event into the journal
+ */
+void Sandbox::start_recording() {
+    reset_grid();
+    step = 0;
+    journal.begin(sim, grids[sim]->width, grids[sim]->height);
+    journal_mode = JournalMode::Record;
+}
+
+/**
+ * Loads a journal and replays it from a cleared grid, ignoring live brush input until it is stopped
+ * 
+ * @param path Path to a journal written by Journal::save
+ * @return True if the journal was loaded successfully
+ */
+bool Sandbox::start_replay(const std::string& path) {
+    if (!journal.load(path)) return false;
+    if (journal.sim < 0 || journal.sim >= grids.size()) {
+        std::cout << "Journal " << path << " refers to an unknown simulation" << std::endl;
+        return false;
+    }
+
+    select_sim(journal.sim);
+    grids[sim]->brush_enabled = 0;
+    if (grids[sim]->width != journal.width || grids[sim]->height != journal.height)
+        grids[sim]->resize(journal.width, journal.height);
+    grids[sim]->clear();
+
+    step = 0;
+    journal_mode = JournalMode::Replay;
+    return true;
 }
 
 /**
- * Resets settings for the currently selected grid to their defaults
+ * Selects the simulation described by a scenario and applies all of its settings and initial conditions
+ * 
+ * @param scenario A scenario loaded with Scenario::load
+ * @return True if every setting in the scenario could be applied
+ */
+bool Sandbox::load_scenario(const Scenario& scenario) {
+    int index = -1;
+    for (int i = 0; i < sim_strs.size(); i++)
+        if (scenario.pde == sim_strs[i] || scenario.pde == sim_ids[i]) index = i;
+    if (index < 0) {
+        std::cout << "Unknown PDE \"" << scenario.pde << "\" in " << scenario.path << std::endl;
+        return false;
+    }
+
+    this->scenario = scenario;
+    select_sim(index);
+    Grid& grid = *grids[sim];
+    grid.reset_settings();
+
+    if (scenario.resolution) grid.resolution = *scenario.resolution;
+    if (scenario.space_step) grid.space_step = *scenario.space_step;
+    if (scenario.time_step) grid.time_step = *scenario.time_step;
+    if (scenario.adaptive_time_step) {
+        if (*scenario.adaptive_time_step && !grid.adaptive_supported) {
+            std::cout << "Adaptive time steps are not supported by this simulation" << std::endl;
+            return false;
+        }
+        grid.adaptive_time_step = *scenario.adaptive_time_step;
+    }
+    if (scenario.boundary_condition) grid.boundary_condition = *scenario.boundary_condition;
+    if (scenario.steady_tolerance) {
+        if (!grid.steady_supported) {
+            std::cout << "Steady state runs are not supported by " << sim_strs[sim] << std::endl;
+            return false;
+        }
+        if (scenario.steady_norm != "l2" && scenario.steady_norm != "max") {
+            std::cout << "Unknown residual norm \"" << scenario.steady_norm << "\", it must be \"l2\" or \"max\"" << std::endl;
+            return false;
+        }
+        grid.steady_state = true;
+        grid.steady_tolerance = *scenario.steady_tolerance;
+        grid.steady_norm = scenario.steady_norm == "l2" ? 0 : 1;
+        grid.residual_every = std::max(1, scenario.residual_every);
+    }
+    if (scenario.stencil_order) {
+        if (*scenario.stencil_order != 2 && *scenario.stencil_order != 4 && *scenario.stencil_order != 6) {
+            std::cout << "Unknown stencil order " << *scenario.stencil_order << ", it must be 2, 4 or 6" << std::endl;
+            return false;
+        }
+        if (*scenario.stencil_order != 2 && !grid.stencils_supported) {
+            std::cout << "Higher order stencils are not supported by " << sim_strs[sim] << std::endl;
+            return false;
+        }
+        grid.set_stencil_order(*scenario.stencil_order);
+    }
+    if (scenario.brush_radius) grid.brush_radius = *scenario.brush_radius;
+    if (scenario.brush_layer) grid.brush_layer = *scenario.brush_layer;
+    if (scenario.visible_layer) grid.visible_layer = *scenario.visible_layer;
+
+    if (!scenario.presets.empty() || scenario.preset) {
+        GrayScott* gray_scott = dynamic_cast<GrayScott*>(&grid);
+        if (!gray_scott) {
+            std::cout << "Presets are only supported by the Gray-Scott simulation" << std::endl;
+            return false;
+        }
+        for (const auto& preset : scenario.presets) gray_scott->add_preset(preset.first, preset.second.first, preset.second.second);
+        if (scenario.preset && !gray_scott->select_preset(*scenario.preset)) {
+            std::cout << "Unknown preset \"" << *scenario.preset << "\"" << std::endl;
+            return false;
+        }
+    }
+
+    for (const auto& parameter : scenario.parameters) {
+        auto it = grid.parameters.find(parameter.first);
+        if (it == grid.parameters.end()) {
+            std::cout << "Unknown parameter \"" << parameter.first << "\" for " << sim_strs[sim] << std::endl;
+            return false;
+        }
+        *it->second = parameter.second;
+    }
+
+    for (const auto& option : scenario.options) {
+        auto it = grid.options.find(option.first);
+        if (it == grid.options.end()) {
+            std::cout << "Unknown option \"" << option.first << "\" for " << sim_strs[sim] << std::endl;
+            return false;
+        }
+        const std::vector<const char*>& names = it->second.names;
+        auto name = std::find_if(names.begin(), names.end(), [&](const char* n) { return option.second == n; });
+        if (name == names.end()) {
+            std::cout << "Unknown value \"" << option.second << "\" for option \"" << option.first << "\"" << std::endl;
+            return false;
+        }
+        *it->second.value = (int)(name - names.begin());
+    }
+
+    while (!grid.parameter_fields.empty()) grid.remove_parameter_field(grid.parameter_fields.begin()->first);
+    for (const FieldSpec& field : scenario.parameter_fields) {
+        if (!grid.fields_supported) {
+            std::cout << "Parameter fields are not supported by " << sim_strs[sim] << std::endl;
+            return false;
+        }
+        if (grid.parameters.find(field.name) == grid.parameters.end()) {
+            std::cout << "Unknown parameter \"" << field.name << "\" for " << sim_strs[sim] << std::endl;
+            return false;
+        }
+        if (field.axis < 2) {
+            grid.set_parameter_ramp(field.name, field.axis, field.from, field.to);
+            continue;
+        }
+
+        std::vector<float> data(field.width * field.height);
+        std::ifstream file(field.path, std::ios::binary);
+        file.read((char*)data.data(), data.size() * sizeof(float));
+        if (!file) {
+            std::cout << "Parameter field " << field.path << " is missing or smaller than " << field.width << "x" << field.height << std::endl;
+            return false;
+        }
+        grid.set_parameter_data(field.name, data, field.width, field.height);
+    }
+
+    std::string backend = scenario.backend.value_or("gpu");
+    if ((backend != "gpu" && backend != "cpu") || !grid.set_backend(backend == "cpu")) {
+        std::cout << "Unknown backend \"" << backend << "\" for " << sim_strs[sim] << std::endl;
+        return false;
+    }
+
+    if (scenario.integrator) {
+        auto it = std::find_if(grid.integrator_strs.begin(), grid.integrator_strs.end(), [&](const char* name) { return *scenario.integrator == name; });
+        if (it == grid.integrator_strs.end()) {
+            std::cout << "Unknown integrator \"" << *scenario.integrator << "\" for " << sim_strs[sim] << std::endl;
+            return false;
+        }
+        grid.integrator = (int)(it - grid.integrator_strs.begin());
+    }
+
+    if (scenario.color_map) {
+        auto it = std::find_if(cmap_strs.begin(), cmap_strs.end(), [&](const char* name) { return *scenario.color_map == name; });
+        if (it == cmap_strs.end()) {
+            std::cout << "Unknown color map \"" << *scenario.color_map << "\"" << std::endl;
+            return false;
+        }
+        tiles[0].cmap = (int)(it - cmap_strs.begin());
+    }
+
+    steps_per_frame = scenario.steps_per_frame;
+    set_grid_size(scenario.width, scenario.height);
+
+    // Every run of an ensemble starts from the same initial state
+    grid.initial_state = scenario.build_initial_state(grid.layers.size(), grid.width / grid.columns, grid.height / grid.rows);
+    for (std::vector<float>& data : grid.initial_state) {
+        std::vector<float> run = data;
+        for (int i = 1; i < grid.members(); i++) data.insert(data.end(), run.begin(), run.end());
+    }
+    reset_grid();
+    step = 0;
+
+    if (!scenario.journal.empty()) return start_replay(scenario.journal);
+    return true;
+}
+
+/**
+ * Resets settings for the grid of the focused tile to their defaults
  */
 void Sandbox::reset_settings() {
-    grids[sim]->reset_settings();
+    tiles[focus].grid->reset_settings();
 }
 
 /**
- * Clears the currently selected grid
+ * Clears the grid of the focused tile
  */
 void Sandbox::reset_grid() {
-    grids[sim]->clear();
+    tiles[focus].grid->clear();
+    if (focus == 0 && journal_mode == JournalMode::Record)
+        journal.record(step, BrushEventKind::Clear, 0, 0, *grids[sim]);
+}
+
+/**
+ * @param tile Index of the tile
+ * @return The number of grid cells covered by one pixel of the tile at the current zoom
+ */
+float Sandbox::cells_per_pixel(int tile) {
+    glm::vec4 rect = tile_rect(tile);
+    const Grid& grid = *tiles[tile].grid;
+
+    // At a zoom of 1 the whole grid fits inside the tile while keeping its aspect ratio
+    float fit = std::max(grid.width / rect.z, grid.height / rect.w);
+    return fit / zoom;
+}
+
+/**
+ * @param tile Index of the tile
+ * @return The size of the region covered by the tile, in texture coordinates of its grid
+ */
+glm::vec2 Sandbox::view_extent(int tile) {
+    glm::vec4 rect = tile_rect(tile);
+    float cells = cells_per_pixel(tile);
+    return glm::vec2(rect.z * cells / tiles[tile].grid->width, rect.w * cells / tiles[tile].grid->height);
+}
+
+/**
+ * Maps a position in the window to texture coordinates of the grid shown in a tile
+ * 
+ * @param x_pos X coordinate in window space
+ * @param y_pos Y coordinate in window space
+ * @param tile Index of the tile
+ * @return The position in texture coordinates, outside of [0, 1] if it is not over the grid
+ */
+glm::vec2 Sandbox::window_to_uv(double x_pos, double y_pos, int tile) {
+    glm::vec4 rect = tile_rect(tile);
+    glm::vec2 screen((float)((x_pos - rect.x) / rect.z), (float)((y_pos - rect.y) / rect.w));
+    return view_center + (screen - glm::vec2(0.5f)) * view_extent(tile);
+}
+
+/**
+ * Zooms the view of every tile while keeping the point under the cursor in place
+ * 
+ * @param x_pos X coordinate of the cursor in window space
+ * @param y_pos Y coordinate of the cursor in window space
+ * @param factor Amount to multiply the zoom by
+ */
+void Sandbox::zoom_view(double x_pos, double y_pos, float factor) {
+    int tile = tile_at(x_pos, y_pos);
+    glm::vec2 before = window_to_uv(x_pos, y_pos, tile);
+    zoom = std::clamp(zoom * factor, 0.25f, 1024.0f);
+    view_center = view_center + before - window_to_uv(x_pos, y_pos, tile);
+}
+
+/**
+ * Moves the view of every tile by a distance given in window pixels
+ * 
+ * @param dx Horizontal distance the cursor moved
+ * @param dy Vertical distance the cursor moved
+ */
+void Sandbox::pan_view(double dx, double dy) {
+    glm::vec4 rect = tile_rect(focus);
+    glm::vec2 extent = view_extent(focus);
+    view_center = view_center - glm::vec2((float)(dx / rect.z) * extent.x, (float)(dy / rect.w) * extent.y);
+}
+
+/**
+ * Centers the view on the grid and fits the whole grid inside the viewport
+ */
+void Sandbox::reset_view() {
+    zoom = 1.0f;
+    view_center = glm::vec2(0.5f, 0.5f);
+}
+
+/**
+ * Generates the mip levels of a tile's output image needed to display the current view.
+ * Only the part of each level covered by the view is generated, so the cost follows the viewport rather than the grid.
+ * 
+ * @param tile Index of the tile
+ * @return The mip level to sample the output image at
+ */
+float Sandbox::prepare_view(int tile) {
+    Grid& grid = *tiles[tile].grid;
+    float lod = std::clamp(std::log2(cells_per_pixel(tile)), 0.0f, (float)(grid.image.levels - 1));
+    int levels = (int)std::ceil(lod);
+    if (levels == 0) return lod;
+
+    glm::vec2 extent = view_extent(tile);
+    glm::vec2 uv_min = glm::clamp(view_center - extent * 0.5f, glm::vec2(0.0f), glm::vec2(1.0f));
+    glm::vec2 uv_max = glm::clamp(view_center + extent * 0.5f, glm::vec2(0.0f), glm::vec2(1.0f));
+
+    downsampleCS.bind();
+    for (int level = 1; level <= levels; level++) {
+        int level_width = std::max(1, grid.width >> level);
+        int level_height = std::max(1, grid.height >> level);
+        int x0 = std::max(0, (int)std::floor(uv_min.x * level_width) - 1);
+        int y0 = std::max(0, (int)std::floor(uv_min.y * level_height) - 1);
+        int x1 = std::min(level_width, (int)std::ceil(uv_max.x * level_width) + 1);
+        int y1 = std::min(level_height, (int)std::ceil(uv_max.y * level_height) + 1);
+
+        glBindImageTexture(0, grid.image.ID, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA8);
+        glBindImageTexture(1, grid.image.ID, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+        downsampleCS.set_int("x_offset", x0);
+        downsampleCS.set_int("y_offset", y0);
+        glDispatchCompute((x1 - x0 + 7) / 8, (y1 - y0 + 7) / 8, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+
+    // Restore the image bindings used by the simulation
+    grid.bind();
+    return lod;
 }
\ No newline at end of file
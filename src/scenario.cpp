@@ -0,0 +1,308 @@
+#include "scenario.hpp"
+#include "json.hpp"
+#include "grid.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <random>
+#include <cstdio>
+#include <cmath>
+
+static const std::vector<std::string> scenario_keys = {
+    "pde", "width", "height", "resolution", "space_step", "time_step", "adaptive_time_step", "boundary_condition",
+    "stencil_order", "steady_state", "brush_radius", "brush_layer", "visible_layer", "color_map", "preset", "presets",
+    "parameters", "parameter_fields", "backend", "integrator", "options", "initial_conditions", "steps", "steps_per_frame",
+    "journal", "outputs"
+};
+
+/**
+ * Checks that the members of an object that hold numbers really are numbers, since a quoted number would otherwise
+ * silently fall back to the default
+ *
+ * @param object The object to check
+ * @param keys Members that have to be numbers when present
+ * @param path Path of the scenario, for the message
+ * @return True if every present member is a number
+ */
+static bool check_numbers(const JsonValue& object, const std::vector<std::string>& keys, const std::string& path) {
+    for (const std::string& key : keys) {
+        const JsonValue* value = object.find(key);
+        if (value && !value->is_number()) {
+            std::cout << "Setting \"" << key << "\" must be a number in " << path << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+Scenario::Scenario() {
+    width = 0;
+    height = 0;
+    steps = 0;
+    steps_per_frame = 10;
+    output_every = 0;
+    steady_norm = "max";
+    residual_every = 10;
+}
+
+/**
+ * Reads and validates a scenario file
+ *
+ * @param path Path to a JSON scenario file
+ * @return True if the scenario was loaded successfully
+ */
+bool Scenario::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cout << "Could not open scenario " << path << std::endl;
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+
+    JsonValue root;
+    std::string error;
+    if (!parse_json(buffer.str(), root, error)) {
+        std::cout << "Problem parsing scenario " << path << ", " << error << std::endl;
+        return false;
+    }
+    if (!root.is_object() || !root.find("pde")) {
+        std::cout << "Scenario " << path << " must be an object with at least a \"pde\" member" << std::endl;
+        return false;
+    }
+    for (const auto& member : root.object)
+        if (std::find(scenario_keys.begin(), scenario_keys.end(), member.first) == scenario_keys.end())
+            std::cout << "Ignoring unknown scenario setting \"" << member.first << "\"" << std::endl;
+    if (!check_numbers(root, {"width", "height", "steps", "steps_per_frame", "resolution", "space_step", "time_step", "stencil_order",
+                              "brush_radius", "brush_layer", "visible_layer"}, path))
+        return false;
+
+    *this = Scenario();
+    this->path = path;
+    pde = root.get_string("pde", "");
+    width = (int)root.get_number("width", 0);
+    height = (int)root.get_number("height", 0);
+    steps = (unsigned int)root.get_number("steps", 0);
+    steps_per_frame = std::max(1, (int)root.get_number("steps_per_frame", 10));
+    journal = root.get_string("journal", "");
+
+    if (root.find("resolution")) resolution = (int)root.get_number("resolution", 8);
+    if (root.find("space_step")) space_step = (float)root.get_number("space_step", 1.0);
+    if (root.find("time_step")) time_step = (float)root.get_number("time_step", 0.1);
+    if (root.find("adaptive_time_step")) adaptive_time_step = root.get_bool("adaptive_time_step", false);
+    if (root.find("stencil_order")) stencil_order = (int)root.get_number("stencil_order", 2);
+    if (const JsonValue* steady = root.find("steady_state")) {
+        if (!check_numbers(*steady, {"tolerance", "every"}, path)) return false;
+        steady_tolerance = (float)steady->get_number("tolerance", 1e-4);
+        steady_norm = steady->get_string("norm", "max");
+        residual_every = (int)steady->get_number("every", 10);
+    }
+    if (root.find("brush_radius")) brush_radius = (int)root.get_number("brush_radius", 10);
+    if (root.find("brush_layer")) brush_layer = (int)root.get_number("brush_layer", 0);
+    if (root.find("visible_layer")) visible_layer = (int)root.get_number("visible_layer", 0);
+    if (root.find("color_map")) color_map = root.get_string("color_map", "");
+    if (root.find("preset")) preset = root.get_string("preset", "");
+    if (root.find("backend")) backend = root.get_string("backend", "");
+    if (root.find("integrator")) integrator = root.get_string("integrator", "");
+
+    // Boundary conditions may be given by name or by index
+    if (const JsonValue* bc = root.find("boundary_condition")) {
+        const std::vector<std::string> names = {"Dirichlet", "Neumann", "Periodic"};
+        if (bc->is_number()) {
+            boundary_condition = (int)bc->number;
+        } else {
+            auto it = std::find(names.begin(), names.end(), bc->string);
+            if (it == names.end()) {
+                std::cout << "Unknown boundary condition \"" << bc->string << "\" in " << path << std::endl;
+                return false;
+            }
+            boundary_condition = (int)(it - names.begin());
+        }
+    }
+
+    if (const JsonValue* list = root.find("presets")) {
+        for (const auto& member : list->object) {
+            if (!member.second.is_array() || member.second.array.size() != 2 || !member.second.array[0].is_number() ||
+                !member.second.array[1].is_number()) {
+                std::cout << "Preset \"" << member.first << "\" must be a [feed, kill] pair of numbers in " << path << std::endl;
+                return false;
+            }
+            presets.push_back({member.first, {(float)member.second.array[0].number, (float)member.second.array[1].number}});
+        }
+    }
+
+    if (const JsonValue* list = root.find("parameters")) {
+        for (const auto& member : list->object) {
+            if (!member.second.is_number()) {
+                std::cout << "Parameter \"" << member.first << "\" must be a number in " << path << std::endl;
+                return false;
+            }
+            parameters.push_back({member.first, (float)member.second.number});
+        }
+    }
+
+    if (const JsonValue* list = root.find("options")) {
+        for (const auto& member : list->object)
+            options.push_back({member.first, member.second.string});
+    }
+
+    // Fields are either {"axis": "x" or "y", "from": ..., "to": ...} or {"path": ..., "width": ..., "height": ...}
+    if (const JsonValue* list = root.find("parameter_fields")) {
+        for (const auto& member : list->object) {
+            if (!check_numbers(member.second, {"from", "to", "width", "height"}, path)) return false;
+            FieldSpec field;
+            field.name = member.first;
+            std::string axis = member.second.get_string("axis", "");
+            field.axis = axis == "x" ? 0 : axis == "y" ? 1 : 2;
+            field.from = (float)member.second.get_number("from", 0.0);
+            field.to = (float)member.second.get_number("to", 0.0);
+            field.path = member.second.get_string("path", "");
+            field.width = (int)member.second.get_number("width", 0);
+            field.height = (int)member.second.get_number("height", 0);
+            if (field.axis == 2 && (field.path.empty() || field.width <= 0 || field.height <= 0)) {
+                std::cout << "Parameter field \"" << field.name << "\" needs an axis of \"x\" or \"y\", or a path, width and height" << std::endl;
+                return false;
+            }
+            parameter_fields.push_back(field);
+        }
+    }
+
+    if (const JsonValue* list = root.find("initial_conditions")) {
+        for (const JsonValue& entry : list->array) {
+            if (!check_numbers(entry, {"layer", "value", "x", "y", "radius", "width", "height", "amplitude", "seed"}, path)) return false;
+            InitialCondition ic;
+            ic.layer = (int)entry.get_number("layer", 0);
+            ic.type = entry.get_string("type", "constant");
+            ic.value = (float)entry.get_number("value", 1.0);
+            ic.x = (float)entry.get_number("x", 0.0);
+            ic.y = (float)entry.get_number("y", 0.0);
+            ic.radius = (float)entry.get_number("radius", 10.0);
+            ic.width = (float)entry.get_number("width", 0.0);
+            ic.height = (float)entry.get_number("height", 0.0);
+            ic.amplitude = (float)entry.get_number("amplitude", 0.0);
+            ic.seed = (unsigned int)entry.get_number("seed", 0);
+            ic.path = entry.get_string("path", "");
+            if (ic.type == "noise" && !entry.find("value")) ic.value = 0.0f;
+
+            if (ic.type != "constant" && ic.type != "disk" && ic.type != "rectangle" && ic.type != "noise" && ic.type != "file") {
+                std::cout << "Unknown initial condition type \"" << ic.type << "\" in " << path << std::endl;
+                return false;
+            }
+            initial_conditions.push_back(ic);
+        }
+    }
+
+    if (const JsonValue* outputs = root.find("outputs")) {
+        if (!check_numbers(*outputs, {"every"}, path)) return false;
+        output_every = (unsigned int)outputs->get_number("every", 0);
+        output_path = outputs->get_string("path", "output");
+        if (const JsonValue* formats = outputs->find("formats"))
+            for (const JsonValue& format : formats->array) output_formats.push_back(format.string);
+        for (const std::string& format : output_formats) {
+            if (format != "raw" && format != "ppm") {
+                std::cout << "Unknown output format \"" << format << "\" in " << path << std::endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Evaluates the initial conditions of the scenario on a grid of the given size
+ *
+ * @param num_layers Number of layers of the grid
+ * @param width Width of the grid in cells
+ * @param height Height of the grid in cells
+ * @return Per-layer data, layers without any initial condition are left empty
+ */
+std::vector<std::vector<float>> Scenario::build_initial_state(int num_layers, int width, int height) const {
+    std::vector<std::vector<float>> state(num_layers);
+
+    for (const InitialCondition& ic : initial_conditions) {
+        if (ic.layer < 0 || ic.layer >= num_layers) {
+            std::cout << "Skipping initial condition for missing layer " << ic.layer << std::endl;
+            continue;
+        }
+        std::vector<float>& data = state[ic.layer];
+        if (data.empty()) data.assign(width * height, 0.0f);
+
+        if (ic.type == "constant") {
+            std::fill(data.begin(), data.end(), ic.value);
+        } else if (ic.type == "disk") {
+            for (int y = std::max(0, (int)(ic.y - ic.radius)); y < std::min(height, (int)(ic.y + ic.radius) + 1); y++)
+                for (int x = std::max(0, (int)(ic.x - ic.radius)); x < std::min(width, (int)(ic.x + ic.radius) + 1); x++)
+                    if (std::pow(x - ic.x, 2) + std::pow(y - ic.y, 2) <= ic.radius * ic.radius) data[y * width + x] = ic.value;
+        } else if (ic.type == "rectangle") {
+            for (int y = std::max(0, (int)ic.y); y < std::min(height, (int)(ic.y + ic.height)); y++)
+                for (int x = std::max(0, (int)ic.x); x < std::min(width, (int)(ic.x + ic.width)); x++)
+                    data[y * width + x] = ic.value;
+        } else if (ic.type == "noise") {
+            std::mt19937 generator(ic.seed);
+            std::uniform_real_distribution<float> distribution(-ic.amplitude, ic.amplitude);
+            for (float& cell : data) cell += ic.value + distribution(generator);
+        } else if (ic.type == "file") {
+            std::ifstream file(ic.path, std::ios::binary);
+            file.read((char*)data.data(), data.size() * sizeof(float));
+            if (!file) std::cout << "Initial condition " << ic.path << " is missing or smaller than " << width << "x" << height << std::endl;
+        }
+    }
+
+    return state;
+}
+
+/**
+ * Writes the outputs requested by the scenario for the current state of the grid
+ *
+ * @param grid The grid to write
+ * @param step Index of the step, used to name the files
+ */
+void Scenario::write_outputs(Grid& grid, unsigned int step) const {
+    if (output_formats.empty()) return;
+
+    std::filesystem::path parent = std::filesystem::path(output_path).parent_path();
+    if (!parent.empty()) std::filesystem::create_directories(parent);
+
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), "_%08u", step);
+    for (const std::string& format : output_formats) {
+        if (format == "raw") write_raw(grid, output_path + suffix + ".raw");
+        else if (format == "ppm") write_ppm(grid, output_path + suffix + ".ppm");
+    }
+}
+
+/**
+ * Writes every layer of a grid to a file as consecutive row-major 32-bit floats
+ *
+ * @param grid The grid to read back
+ * @param path Path of the file to write
+ */
+void write_raw(Grid& grid, const std::string& path) {
+    std::ofstream file(path, std::ios::binary);
+    for (int i = 0; i < (int)grid.layers.size(); i++) {
+        std::vector<float> data = grid.read_layer(i);
+        file.write((const char*)data.data(), data.size() * sizeof(float));
+    }
+}
+
+/**
+ * Writes the color mapped output image of a grid as a binary PPM
+ *
+ * @param grid The grid to read back
+ * @param path Path of the file to write
+ */
+void write_ppm(Grid& grid, const std::string& path) {
+    std::vector<float> rgba = grid.read_image();
+    std::vector<unsigned char> rgb(grid.width * grid.height * 3);
+    for (int i = 0; i < grid.width * grid.height; i++)
+        for (int c = 0; c < 3; c++)
+            rgb[i * 3 + c] = (unsigned char)(std::clamp(rgba[i * 4 + c], 0.0f, 1.0f) * 255.0f + 0.5f);
+
+    std::ofstream file(path, std::ios::binary);
+    file << "P6\n" << grid.width << " " << grid.height << "\n255\n";
+    file.write((const char*)rgb.data(), rgb.size());
+}
\ No newline at end of file
@@ -72,14 +72,16 @@ Shader::Shader(const std::string& vertex_source_path, const std::string& fragmen
     glDeleteShader(FS);
 }
 
-// Create a compute shader given the path to a source file
-ComputeShader::ComputeShader(const std::string& compute_source_path) {
+// Create a compute shader given the path to a source file, optionally inserting #define lines to pick a kernel variant
+ComputeShader::ComputeShader(const std::string& compute_source_path, const std::string& defines) {
     std::string line, text;
     std::ifstream file(compute_source_path);
 
-    // Read compute shader from file
-    while(std::getline(file, line))
+    // Read compute shader from file, the defines go right after the #version line
+    while(std::getline(file, line)) {
         text += line + "\n";
+        if (line.rfind("#version", 0) == 0) text += defines;
+    }
     file.close();
     const char* source = text.c_str();
 
@@ -0,0 +1,207 @@
+#include <glad/glad.h>
+
+#include "texture.hpp"
+
+#include <algorithm>
+
+/**
+ * @return Size in bytes of a single texel of a sized internal format
+ */
+static size_t texel_bytes(unsigned int format) {
+    switch (format) {
+        case GL_RGBA32F: return 16;
+        case GL_RG32F:
+        case GL_RGBA16F: return 8;
+        default: return 4; // GL_R32F, GL_R32UI, GL_RGBA8
+    }
+}
+
+Texture::Texture() {
+    ID = 0;
+    format = 0;
+    width = 0;
+    height = 0;
+    levels = 0;
+    depth = 0;
+}
+
+/**
+ * Allocates immutable storage for a 2D texture, or a 2D array texture if depth is given.
+ * The contents are undefined until cleared or written.
+ *
+ * @param format Sized internal format, e.g. GL_R32F
+ * @param width Width of the base level
+ * @param height Height of the base level
+ * @param levels Number of mip levels
+ * @param depth Number of array layers, 0 for a plain 2D texture
+ */
+Texture::Texture(unsigned int format, int width, int height, int levels, int depth) {
+    this->format = format;
+    this->width = width;
+    this->height = height;
+    this->levels = levels;
+    this->depth = depth;
+    if (depth > 0) {
+        glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &ID);
+        glTextureStorage3D(ID, levels, format, width, height, depth);
+    } else {
+        glCreateTextures(GL_TEXTURE_2D, 1, &ID);
+        glTextureStorage2D(ID, levels, format, width, height);
+    }
+}
+
+Texture::~Texture() {
+    if (ID != 0) glDeleteTextures(1, &ID);
+}
+
+Texture::Texture(Texture&& other) noexcept {
+    ID = other.ID;
+    format = other.format;
+    width = other.width;
+    height = other.height;
+    levels = other.levels;
+    depth = other.depth;
+    other.ID = 0;
+}
+
+Texture& Texture::operator=(Texture&& other) noexcept {
+    if (this != &other) {
+        if (ID != 0) glDeleteTextures(1, &ID);
+        ID = other.ID;
+        format = other.format;
+        width = other.width;
+        height = other.height;
+        levels = other.levels;
+        depth = other.depth;
+        other.ID = 0;
+    }
+    return *this;
+}
+
+/**
+ * Sets every texel of every level to 0 without reallocating
+ */
+void Texture::clear() {
+    for (int level = 0; level < levels; level++)
+        glClearTexImage(ID, level, format == GL_R32UI ? GL_RED_INTEGER : GL_RED, format == GL_R32UI ? GL_UNSIGNED_INT : GL_FLOAT, nullptr);
+}
+
+/**
+ * @return The approximate amount of video memory used by the texture, including its mip chain
+ */
+size_t Texture::bytes() const {
+    if (ID == 0) return 0;
+
+    size_t total = 0;
+    for (int level = 0; level < levels; level++)
+        total += (size_t)std::max(1, width >> level) * std::max(1, height >> level) * texel_bytes(format);
+    return total * std::max(1, depth);
+}
+
+Buffer::Buffer() {
+    ID = 0;
+    size = 0;
+}
+
+/**
+ * Allocates immutable storage for a buffer
+ *
+ * @param size Size of the buffer in bytes
+ * @param data Initial contents, or nullptr to leave them undefined
+ * @param flags Storage flags such as GL_DYNAMIC_STORAGE_BIT
+ */
+Buffer::Buffer(size_t size, const void* data, unsigned int flags) {
+    this->size = size;
+    glCreateBuffers(1, &ID);
+    glNamedBufferStorage(ID, size, data, flags);
+}
+
+Buffer::~Buffer() {
+    if (ID != 0) glDeleteBuffers(1, &ID);
+}
+
+Buffer::Buffer(Buffer&& other) noexcept {
+    ID = other.ID;
+    size = other.size;
+    other.ID = 0;
+}
+
+Buffer& Buffer::operator=(Buffer&& other) noexcept {
+    if (this != &other) {
+        if (ID != 0) glDeleteBuffers(1, &ID);
+        ID = other.ID;
+        size = other.size;
+        other.ID = 0;
+    }
+    return *this;
+}
+
+/**
+ * Sets every byte of the buffer to 0
+ */
+void Buffer::clear() {
+    glClearNamedBufferData(ID, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+}
+
+TexturePool::TexturePool() {
+    idle_bytes = 0;
+    max_idle_bytes = 256 * 1024 * 1024;
+}
+
+/**
+ * Hands out a texture with the given layout, reusing an idle one if possible. The contents are undefined.
+ *
+ * @param format Sized internal format, e.g. GL_R32F
+ * @param width Width of the base level
+ * @param height Height of the base level
+ * @param levels Number of mip levels
+ * @param depth Number of array layers, 0 for a plain 2D texture
+ * @return An owning handle to the texture
+ */
+Texture TexturePool::acquire(unsigned int format, int width, int height, int levels, int depth) {
+    auto it = idle.find({format, width, height, levels, depth});
+    if (it == idle.end() || it->second.empty()) return Texture(format, width, height, levels, depth);
+
+    Texture texture = std::move(it->second.back());
+    it->second.pop_back();
+    if (it->second.empty()) idle.erase(it);
+    idle_bytes -= texture.bytes();
+    return texture;
+}
+
+/**
+ * Returns a texture to the pool so that it can be handed out again
+ *
+ * @param texture The texture to give up, empty handles are ignored
+ */
+void TexturePool::release(Texture&& texture) {
+    if (texture.ID == 0) return;
+
+    idle_bytes += texture.bytes();
+    idle[{texture.format, texture.width, texture.height, texture.levels, texture.depth}].push_back(std::move(texture));
+    trim(max_idle_bytes);
+}
+
+/**
+ * Frees idle textures until at most max_bytes of them remain, largest layouts first
+ *
+ * @param max_bytes The amount of idle video memory to keep
+ */
+void TexturePool::trim(size_t max_bytes) {
+    while (idle_bytes > max_bytes && !idle.empty()) {
+        auto largest = std::max_element(idle.begin(), idle.end(), [](const auto& a, const auto& b) {
+            return a.second.back().bytes() < b.second.back().bytes();
+        });
+        idle_bytes -= largest->second.back().bytes();
+        largest->second.pop_back();
+        if (largest->second.empty()) idle.erase(largest);
+    }
+}
+
+/**
+ * @return The pool shared by every grid, there is only a single OpenGL context
+ */
+TexturePool& texture_pool() {
+    static TexturePool pool;
+    return pool;
+}
\ No newline at end of file
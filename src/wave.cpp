@@ -5,26 +5,205 @@
 #include "wave.hpp"
 #include "sandbox.hpp"
 
+#include <algorithm>
 #include <iostream>
+#include <cmath>
+
+// Passes of wave.glsl
+enum WavePass {
+    PASS_BRUSH = 0,
+    PASS_STEP,
+    PASS_RENDER,
+    PASS_REST
+};
 
 Wave::Wave(int width, int height) 
-    : waveCS("shaders/wave.glsl"), Grid(width, height, 2)
+    : waveCS("shaders/wave.glsl"), Grid(width, height, 3)
 {
+    stencils_supported = true;
+    parameters = {{"speed", &speed}, {"absorbing_layer", &absorbing_layer}, {"reflection", &reflection}};
+    adaptive_supported = true;
+    advance = true;
+    show_energy = false;
+    start_at_rest = false;
+    damping_layer = -1;
     reset_settings();
+    last_time_step = time_step;
+}
+
+Wave::~Wave() {
+    texture_pool().release(std::move(damping));
+}
+
+/**
+ * @return The Courant number c dt / dx of the current settings
+ */
+float Wave::courant_number() const {
+    return speed * time_step / space_step;
+}
+
+/**
+ * @return The largest stable Courant number, 1 / sqrt(2) on the 5 point stencil and lower on the wider ones, whose fastest
+ * mode oscillates faster
+ */
+float Wave::courant_limit() const {
+    return 1.0f / std::sqrt(2.0f * laplacian_scale());
+}
+
+/**
+ * Sums the energy the leapfrog scheme conserves exactly without an absorbing layer: the kinetic energy of the velocity between
+ * the previous and current levels plus the current level times minus the laplacian of the previous one. Folding the ghost
+ * cells back into the grid the way the shader reads them keeps every stencil symmetric, so the sum is the same either way
+ * round. Reads both levels back.
+ *
+ * @return The discrete energy per unit density
+ */
+float Wave::energy() {
+    std::vector<float> u = read_layer(0);
+    std::vector<float> previous = start_at_rest ? u : read_layer(1);
+    std::vector<float> second = second_difference();
+
+    // Reads a level past the edges like mirror in wave.glsl: Neumann edges mirror the cells inside, Dirichlet edges mirror
+    // them with the opposite sign around the first ghost cell, which is 0
+    auto at = [&](const std::vector<float>& f, int x, int y) {
+        float sign = 1.0f;
+        auto fold = [&](int i, int n) {
+            if (i >= 0 && i < n) return i;
+            if (boundary_condition == 2) return (i % n + n) % n;
+            if (boundary_condition == 1) return std::clamp(i < 0 ? -1 - i : 2 * n - 1 - i, 0, n - 1);
+            sign *= i == -1 || i == n ? 0.0f : -1.0f;
+            return std::clamp(i < 0 ? -2 - i : 2 * n - i, 0, n - 1);
+        };
+        x = fold(x, width);
+        y = fold(y, height);
+        return sign * f[y * width + x];
+    };
+
+    double kinetic = 0.0, potential = 0.0;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            kinetic += std::pow((u[y * width + x] - previous[y * width + x]) / last_time_step, 2.0);
+
+            double laplacian = 2.0 * second[0] * previous[y * width + x];
+            for (int k = 1; k < second.size(); k++)
+                laplacian += second[k] * (at(previous, x - k, y) + at(previous, x + k, y) + at(previous, x, y - k) + at(previous, x, y + k));
+            potential -= u[y * width + x] * laplacian;
+        }
+    }
+    return (float)(0.5 * (kinetic + speed * speed * potential / (space_step * space_step)) * space_step * space_step);
+}
+
+/**
+ * @return The largest stable time step, see courant_limit
+ */
+float Wave::stable_time_step() {
+    limited_by = "the CFL condition";
+    return courant_limit() * space_step / std::abs(speed);
+}
+
+/**
+ * Rebuilds the damping profile of the absorbing layer when the size of the grid or the width of the layer changed, or after an eviction.
+ * Periodic grids have no edges, their profile is 0 everywhere.
+ */
+void Wave::update_damping() {
+    int layer = boundary_condition == 2 ? 0 : std::max(0, (int)std::round(absorbing_layer));
+    if (damping.ID != 0 && damping.width == width && damping.height == height && damping_layer == layer) return;
+    if (damping.ID == 0 || damping.width != width || damping.height != height) {
+        texture_pool().release(std::move(damping));
+        damping = texture_pool().acquire(GL_R32F, width, height);
+    }
+    damping_layer = layer;
+
+    std::vector<float> profile(width * height, 0.0f);
+    for (int y = 0; y < height && layer > 0; y++) {
+        for (int x = 0; x < width; x++) {
+            int distance = std::min({x, width - 1 - x, y, height - 1 - y});
+            if (distance < layer) profile[y * width + x] = std::pow((float)(layer - distance) / layer, 2.0f);
+        }
+    }
+    glTextureSubImage2D(damping.ID, 0, 0, 0, width, height, GL_RED, GL_FLOAT, profile.data());
+}
+
+/**
+ * The reflection off a layer whose damping grows as sigma (d / L)^2 is exp(-2 sigma L dx / (3 c)) for waves hitting it
+ * head on, so the largest damping follows from the reflection it should leave
+ *
+ * @return The damping at the edges
+ */
+float Wave::largest_damping() const {
+    if (damping_layer <= 0) return 0.0f;
+    return 3.0f * std::abs(speed) * std::log(1.0f / reflection) / (2.0f * damping_layer * space_step);
+}
+
+/**
+ * Clears the levels like every grid, except that an initial displacement given without a previous level starts at rest
+ */
+void Wave::clear() {
+    Grid::clear();
+    bool displaced = initial_state.size() > 0 && initial_state[0].size() == width * height;
+    bool moving = initial_state.size() > 1 && !initial_state[1].empty();
+    start_at_rest = displaced && !moving;
 }
 
 /**
- * Dispatch the compute shader which solves the equation
+ * Dispatch the compute shader which solves the equation. The brush first sets the current and previous levels of the
+ * cells it covers, so it adds a displacement at rest, then the step writes the next level and the levels are rotated.
  */
 void Wave::solve() {
+    update_damping();
+    glBindTextureUnit(0, damping.ID);
+    waveCS.set_float("largest_damping", largest_damping());
+
+    if (brush_enabled) {
+        waveCS.set_int("pass", PASS_BRUSH);
+        glDispatchCompute(width, height, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+
+    if (!advance) {
+        waveCS.set_int("pass", PASS_RENDER);
+        glDispatchCompute(width, height, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        return;
+    }
+
+    if (start_at_rest) {
+        waveCS.set_int("pass", PASS_REST);
+        glDispatchCompute(width, height, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        last_time_step = time_step;
+        start_at_rest = false;
+    }
+
+    waveCS.set_int("pass", PASS_STEP);
+    waveCS.set_float("step_ratio", time_step / last_time_step);
     glDispatchCompute(width, height, 1);
     glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    last_time_step = time_step;
+
+    // The next level becomes the current one, the current level the previous one and the previous level is overwritten next
+    std::rotate(layers.begin(), layers.begin() + 2, layers.end());
+    bind();
 }
 
 /**
  * Render the GUI for this specific equation
  */
-void Wave::gui() {}
+void Wave::gui() {
+    ImGui::Text("Wave Speed");
+    ImGui::SliderFloat("##Wave Speed", &speed, 0.1, 20.0);
+    ImGui::Text("Courant Number: %.3f", courant_number());
+    if (courant_number() > courant_limit()) ImGui::TextWrapped("Above the stability limit of %.3f, lower the time step", courant_limit());
+    ImGui::Text("Absorbing Layer (Cells)");
+    ImGui::SliderFloat("##Absorbing Layer", &absorbing_layer, 0.0, 64.0, "%.0f");
+    if (absorbing_layer >= 1.0f) {
+        if (boundary_condition == 2) ImGui::TextWrapped("Periodic grids have no edges to absorb at");
+        ImGui::Text("Reflection");
+        ImGui::SliderFloat("##Reflection", &reflection, 1e-6f, 1e-1f, "%.0e", ImGuiSliderFlags_Logarithmic);
+    }
+    ImGui::Checkbox("Show Energy", &show_energy);
+    if (show_energy) ImGui::Text("Energy: %.6g", energy());
+}
 
 /**
  * Reset all simulation specific settings to default
@@ -33,6 +212,9 @@ void Wave::reset_settings() {
     brush_radius = 3;
     space_step = 0.1f;
     time_step = 0.01f;
+    speed = 5.0f;
+    absorbing_layer = 0.0f;
+    reflection = 1e-3f;
     boundary_condition = 1;
 }
 
@@ -43,17 +225,55 @@ void Wave::reset_settings() {
  * @param paused Is the simulation paused?
  */
 void Wave::set_uniforms(std::string cmap_str, bool paused) {
+    advance = !paused;
     waveCS.bind();
-    waveCS.set_bool("paused", paused);
+    waveCS.set_bool("render_image", render_image);
     waveCS.set_int("width", width);
     waveCS.set_int("height", height);
     waveCS.set_int("boundary_condition", boundary_condition);
     waveCS.set_float("dx", space_step);
     waveCS.set_float("dt", time_step);
+    waveCS.set_float("speed", speed);
 
     waveCS.set_int("brush_enabled", brush_enabled);
     waveCS.set_int("x_pos", x_pos);
     waveCS.set_int("y_pos", y_pos);
     waveCS.set_int("brush_radius", brush_radius);
     apply_cmap(waveCS, cmap_str);
+}
+
+/**
+ * Recompiles the compute shader with the selected stencils
+ */
+void Wave::compile_shaders() {
+    glDeleteProgram(waveCS.ID);
+    waveCS = ComputeShader("shaders/wave.glsl", shader_defines());
+}
+
+/**
+ * Copies another wave grid, along with how its levels were last advanced, so the copy carries on from the same state
+ * 
+ * @param other The grid to copy, must be resident
+ */
+void Wave::copy_from(const Grid& other) {
+    Grid::copy_from(other);
+    const Wave& wave = static_cast<const Wave&>(other);
+    last_time_step = wave.last_time_step;
+    start_at_rest = wave.start_at_rest;
+    show_energy = wave.show_energy;
+}
+
+/**
+ * Evicts the layers and gives the damping profile back to the pool, the next step rebuilds it
+ */
+void Wave::evict() {
+    Grid::evict();
+    texture_pool().release(std::move(damping));
+}
+
+/**
+ * @return The amount of video memory held by the grid's textures and the damping profile
+ */
+size_t Wave::bytes() const {
+    return Grid::bytes() + damping.bytes();
 }
\ No newline at end of file